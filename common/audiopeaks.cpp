@@ -0,0 +1,169 @@
+#include "audiopeaks.h"
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PCM_PEAKS_X86
+#include <immintrin.h>
+#endif
+
+namespace MXF
+{
+
+/** running minimum, maximum and sum of squares of a bucket */
+struct PeakState
+{
+	PeakState() : min(32767), max(-32768), sumSquares(0) {}
+	int min;
+	int max;
+	quint64 sumSquares;
+};
+
+/// vector kernels return the number of samples they handled, the rest is
+/// done by the scalar code
+typedef qint64 (*Peaks16Kernel)(const uchar *pcm, qint64 samples, PeakState *state);
+
+static void peaksScalar(const uchar *pcm, int bytesPerSample, qint64 first, qint64 samples, PeakState *state)
+{
+	// the upper two bytes of a little endian sample
+	const uchar *p = pcm + first * bytesPerSample + bytesPerSample - 2;
+	for (qint64 i = first; i < samples; ++i, p += bytesPerSample)
+	{
+		int v = qint16(p[0] | (p[1] << 8));
+		state->min = qMin(state->min, v);
+		state->max = qMax(state->max, v);
+		state->sumSquares += quint64(qint64(v) * v);
+	}
+}
+
+static qint64 peaks16None(const uchar *, qint64, PeakState *)
+{
+	return 0;
+}
+
+#ifdef PCM_PEAKS_X86
+
+/* 8 samples per register. madd squares and adds pairs of samples; the sum
+ * of two squares fits 32 bit unsigned and is widened to 64 bit before it is
+ * accumulated */
+static qint64 peaks16Sse2(const uchar *pcm, qint64 samples, PeakState *state)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i vmin = _mm_set1_epi16(32767);
+	__m128i vmax = _mm_set1_epi16(-32768);
+	__m128i sum = zero;
+	qint64 i = 0;
+	for (; i + 8 <= samples; i += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i * 2));
+		vmin = _mm_min_epi16(vmin, v);
+		vmax = _mm_max_epi16(vmax, v);
+		__m128i sq = _mm_madd_epi16(v, v);
+		sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(sq, zero));
+		sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(sq, zero));
+	}
+	qint16 mins[8], maxs[8];
+	quint64 sums[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mins), vmin);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), vmax);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(sums), sum);
+	for (int k = 0; k < 8; ++k)
+	{
+		state->min = qMin<int>(state->min, mins[k]);
+		state->max = qMax<int>(state->max, maxs[k]);
+	}
+	state->sumSquares += sums[0] + sums[1];
+	return i;
+}
+
+#if defined(__GNUC__)
+#define PCM_PEAKS_AVX2
+
+/* the same with 16 samples per register, the rest goes to the SSE2 kernel */
+__attribute__((target("avx2")))
+static qint64 peaks16Avx2(const uchar *pcm, qint64 samples, PeakState *state)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i vmin = _mm256_set1_epi16(32767);
+	__m256i vmax = _mm256_set1_epi16(-32768);
+	__m256i sum = zero;
+	qint64 i = 0;
+	for (; i + 16 <= samples; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm + i * 2));
+		vmin = _mm256_min_epi16(vmin, v);
+		vmax = _mm256_max_epi16(vmax, v);
+		__m256i sq = _mm256_madd_epi16(v, v);
+		sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(sq, zero));
+		sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(sq, zero));
+	}
+	qint16 mins[16], maxs[16];
+	quint64 sums[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(mins), vmin);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(maxs), vmax);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(sums), sum);
+	for (int k = 0; k < 16; ++k)
+	{
+		state->min = qMin<int>(state->min, mins[k]);
+		state->max = qMax<int>(state->max, maxs[k]);
+	}
+	state->sumSquares += sums[0] + sums[1] + sums[2] + sums[3];
+	return i + peaks16Sse2(pcm + i * 2, samples - i, state);
+}
+#endif // __GNUC__
+
+#endif // PCM_PEAKS_X86
+
+struct Peaks16
+{
+	Peaks16() : kernel(peaks16None), name("scalar")
+	{
+#ifdef PCM_PEAKS_X86
+		kernel = peaks16Sse2;
+		name = "sse2";
+#ifdef PCM_PEAKS_AVX2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			kernel = peaks16Avx2;
+			name = "avx2";
+		}
+#endif
+#endif
+	}
+	Peaks16Kernel kernel;
+	const char *name;
+};
+
+static const Peaks16 &peaks16()
+{
+	static const Peaks16 k;
+	return k;
+}
+
+void pcmPeaks(const uchar *pcm, int bytesPerSample, qint64 samples,
+              qint64 samplesPerBucket, AudioPeak *out)
+{
+	if ((bytesPerSample < 2) || (samples <= 0) || (samplesPerBucket <= 0))
+		return;
+	for (qint64 first = 0; first < samples; first += samplesPerBucket, ++out)
+	{
+		qint64 count = qMin(samplesPerBucket, samples - first);
+		const uchar *bucket = pcm + first * bytesPerSample;
+		PeakState state;
+		qint64 done = 0;
+		if (bytesPerSample == 2)
+			done = peaks16().kernel(bucket, count, &state);
+		if (done < count)
+			peaksScalar(bucket, bytesPerSample, done, count, &state);
+		out->min = qint16(state.min);
+		out->max = qint16(state.max);
+		out->rms = quint16(qMin(32768.0, sqrt(double(state.sumSquares) / count)));
+	}
+}
+
+const char *pcmPeaksKernel()
+{
+	return peaks16().name;
+}
+
+}
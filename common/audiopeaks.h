@@ -0,0 +1,31 @@
+#ifndef AUDIOPEAKS_H
+#define AUDIOPEAKS_H
+#include <QtGlobal>
+
+namespace MXF {
+
+/** level summary of a run of samples, in 16 bit full scale */
+struct AudioPeak
+{
+	qint16 min;
+	qint16 max;
+	quint16 rms;
+};
+
+/**
+ * Splits samples of mono little endian PCM (signed 16 or 24 bit, as in the
+ * P2 audio essence) into buckets of samplesPerBucket samples and writes the
+ * minimum, maximum and RMS level of each to out, which has to hold
+ * (samples + samplesPerBucket - 1) / samplesPerBucket entries. 24 bit
+ * samples are measured by their upper 16 bits. 16 bit samples use
+ * SSE2/AVX2 kernels.
+ */
+void pcmPeaks(const uchar *pcm, int bytesPerSample, qint64 samples,
+              qint64 samplesPerBucket, AudioPeak *out);
+
+/** name of the kernel used for 16 bit samples, for benchmarks and logs */
+const char *pcmPeaksKernel();
+
+}
+
+#endif // AUDIOPEAKS_H
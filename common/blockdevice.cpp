@@ -0,0 +1,57 @@
+#include "blockdevice.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace MXF
+{
+
+static QString sysfsPath(quint64 id)
+{
+	return QStringLiteral("/sys/dev/block/%1:%2").arg(major(id)).arg(minor(id));
+}
+
+quint64 BlockDevice::idOf(const QString &path)
+{
+	struct stat st;
+	if (stat(QFile::encodeName(path).constData(), &st))
+		return 0;
+	quint64 id = st.st_dev;
+
+	// /sys/dev/block/M:m links to .../block/sdb/sdb1 for a partition
+	QString device = QFileInfo(sysfsPath(id)).canonicalFilePath();
+	if (device.isEmpty() || !QFile::exists(device + "/partition"))
+		return id;
+	QFile disk(QFileInfo(device).path() + "/dev");
+	if (!disk.open(QIODevice::ReadOnly))
+		return id;
+	QList<QByteArray> numbers = disk.readAll().trimmed().split(':');
+	if (numbers.size() != 2)
+		return id;
+	return makedev(numbers[0].toUInt(), numbers[1].toUInt());
+}
+
+QString BlockDevice::name(quint64 id)
+{
+	QString device = QFileInfo(sysfsPath(id)).canonicalFilePath();
+	if (device.isEmpty())
+		return QStringLiteral("%1:%2").arg(major(id)).arg(minor(id));
+	return QFileInfo(device).fileName();
+}
+
+void BlockDevice::prefetch(const QString &fileName, qint64 length)
+{
+	int fd = open(QFile::encodeName(fileName).constData(), O_RDONLY);
+	if (fd < 0)
+		return;
+	// the advice stays with the page cache after the descriptor is closed
+	posix_fadvise(fd, 0, (length < 0) ? 0 : length, POSIX_FADV_WILLNEED);
+	close(fd);
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef BLOCKDEVICE_H
+#define BLOCKDEVICE_H
+#include <QtGlobal>
+#include <QString>
+
+namespace MXF {
+
+/**
+ * Maps files to the disk they are read from, so work can be spread over
+ * several card readers instead of piling up on one of them.
+ */
+class BlockDevice
+{
+public:
+	/** the whole disk a file is stored on (partitions are mapped to their
+	 * disk), 0 if it cannot be determined */
+	static quint64 idOf(const QString &path);
+	/** kernel name of the device, e.g. "sdb", for messages */
+	static QString name(quint64 id);
+
+	/** starts the kernel's read-ahead for the first length bytes of a file
+	 * (the whole file if length is -1) */
+	static void prefetch(const QString &fileName, qint64 length = -1);
+};
+
+}
+
+#endif // BLOCKDEVICE_H
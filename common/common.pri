@@ -0,0 +1,34 @@
+# code shared by the tools in this repository
+# include(../common/common.pri) in a tool's .pro file
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+# FileCopier reads ahead on a QtConcurrent thread
+QT += concurrent
+
+HEADERS += \
+    $$PWD/mxfmeta.h \
+    $$PWD/klvreader.h \
+    $$PWD/blockdevice.h \
+    $$PWD/pcminterleave.h \
+    $$PWD/xxhash64.h \
+    $$PWD/filecopier.h \
+    $$PWD/hashlist.h \
+    $$PWD/p2card.h \
+    $$PWD/shotgraph.h \
+    $$PWD/dvthumbnail.h \
+    $$PWD/audiopeaks.h
+
+SOURCES += \
+    $$PWD/mxfmeta.cpp \
+    $$PWD/klvreader.cpp \
+    $$PWD/blockdevice.cpp \
+    $$PWD/pcminterleave.cpp \
+    $$PWD/xxhash64.cpp \
+    $$PWD/filecopier.cpp \
+    $$PWD/hashlist.cpp \
+    $$PWD/p2card.cpp \
+    $$PWD/shotgraph.cpp \
+    $$PWD/dvthumbnail.cpp \
+    $$PWD/audiopeaks.cpp
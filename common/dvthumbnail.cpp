@@ -0,0 +1,351 @@
+#include "dvthumbnail.h"
+#include <QVector>
+#include <QVarLengthArray>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DV_COLOR_X86
+#include <emmintrin.h>
+#endif
+
+namespace MXF
+{
+
+/// DIF blocks are 80 bytes; a sequence has a header, 2 subcode, 3 VAUX,
+/// 9 audio and 135 video blocks
+static const int difBlockSize = 80;
+static const int videoSegmentsPerSequence = 27;
+
+/// byte offsets of the 6 DCT blocks (Y0-Y3, Cr, Cb) in a video DIF block
+static const int dctBlockStart[6] = { 4, 18, 32, 46, 60, 70 };
+
+enum Sampling {
+	Sampling411,    ///< 32x8 macro blocks, 16x16 in the rightmost column
+	Sampling420,    ///< 16x16 macro blocks
+	Sampling422     ///< 16x8 macro blocks, DCT blocks 1 and 3 are unused
+};
+
+struct Layout
+{
+	qint64 frameSize;
+	int channels;
+	int sequences;      ///< DIF sequences per channel
+	Sampling sampling;
+	int width;          ///< of the DC picture
+	int height;
+};
+
+static const Layout layouts[] = {
+	{ 120000, 1, 10, Sampling411, 90, 60 },    // DV25 / DVCPRO 525/60
+	{ 144000, 1, 12, Sampling411, 90, 72 },    // DVCPRO 625/50
+	{ 144000, 1, 12, Sampling420, 90, 72 },    // IEC 61834 DV 625/50
+	{ 240000, 2, 10, Sampling422, 90, 60 },    // DVCPRO50 525/60
+	{ 288000, 2, 12, Sampling422, 90, 72 }     // DVCPRO50 625/50
+};
+static const int layoutCount = sizeof(layouts) / sizeof(layouts[0]);
+
+/** where the DCT blocks of one video DIF block go in the DC picture */
+struct MacroBlock
+{
+	quint32 offset;     ///< of the DIF block in the frame
+	quint16 pixel;      ///< of the top left DCT block in the DC picture
+	quint8 shape;       ///< Sampling411 row of 4, Sampling420 2x2, Sampling422 row of 2
+};
+
+/* The shuffling of macro blocks over the DIF sequences as given by
+ * IEC 61834-2 and SMPTE 314M. Each video segment holds 5 macro blocks
+ * taken from 5 super blocks spread over the picture; x and y are in units
+ * of 8 pixels */
+static void macroBlockPosition(const Layout &l, int channel, int sequence, int slot, int m,
+                               int *x, int *y, int *shape)
+{
+	static const int offset[] = { 2, 6, 8, 0, 4 };
+	static const int column422[] = { 18, 9, 27, 0, 36 };
+	// the super block column starts 0, 4, 9, 13, 18 in the order 2, 1, 3, 0, 4
+	static const int column411[] = { 9, 4, 13, 0, 18 };
+	static const int serpent3[] = {
+	    0, 1, 2, 2, 1, 0, 0, 1, 2, 2, 1, 0, 0, 1, 2, 2, 1, 0,
+	    0, 1, 2, 2, 1, 0, 0, 1, 2
+	};
+	static const int serpent6[] = {
+	    0, 1, 2, 3, 4, 5, 5, 4, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5,
+	    5, 4, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5
+	};
+
+	int row = (sequence + offset[m]) % l.sequences;
+	switch (l.sampling)
+	{
+	case Sampling422:
+		*x = (column422[m] + slot / 3) * 2;
+		*y = serpent3[slot] + (row * 2 + channel) * 3;
+		*shape = Sampling422;
+		break;
+	case Sampling420:
+		*x = (column422[m] + slot / 3) * 2;
+		*y = (serpent3[slot] + row * 3) * 2;
+		*shape = Sampling420;
+		break;
+	case Sampling411:
+	{
+		// super blocks 1 and 3 start half a column down
+		int k = slot + (((m == 1) || (m == 2)) ? 3 : 0);
+		int column = column411[m] + k / 6;
+		*x = column * 4;
+		*y = serpent6[k] + row * 6;
+		*shape = Sampling411;
+		// the rightmost 16 pixels are cut into 16x16 blocks
+		if (column > 21)
+		{
+			*y = *y * 2 - row * 6;
+			*shape = Sampling420;
+		}
+		break;
+	}
+	}
+}
+
+/** the macro block tables of all layouts, built once */
+struct MacroBlockTables
+{
+	MacroBlockTables()
+	{
+		for (int i = 0; i < layoutCount; ++i)
+		{
+			const Layout &l = layouts[i];
+			QVector<MacroBlock> &blocks = tables[i];
+			int difBlock = 0;
+			for (int c = 0; c < l.channels; ++c)
+			{
+				for (int s = 0; s < l.sequences; ++s)
+				{
+					difBlock += 6;
+					for (int slot = 0; slot < videoSegmentsPerSequence; ++slot)
+					{
+						// an audio block before every third segment
+						if (!(slot % 3))
+							difBlock++;
+						for (int m = 0; m < 5; ++m, ++difBlock)
+						{
+							int x, y, shape;
+							macroBlockPosition(l, c, s, slot, m, &x, &y, &shape);
+							int width = (shape == Sampling411) ? 4 : 2;
+							int height = (shape == Sampling420) ? 2 : 1;
+							if ((x + width > l.width) || (y + height > l.height))
+								continue;
+							MacroBlock mb;
+							mb.offset = difBlock * difBlockSize;
+							mb.pixel = y * l.width + x;
+							mb.shape = shape;
+							blocks.append(mb);
+						}
+					}
+				}
+			}
+		}
+	}
+	QVector<MacroBlock> tables[layoutCount];
+};
+
+static const MacroBlockTables &macroBlocks()
+{
+	static const MacroBlockTables t;
+	return t;
+}
+
+/** index into layouts, -1 if frame is none of them */
+static int layoutOf(const uchar *frame, qint64 size)
+{
+	if (!frame || (size < difBlockSize) || ((frame[0] >> 5) != 0))
+		return -1;
+	bool is625 = frame[3] & 0x80;
+	// APT 0 is IEC 61834 DV, 1 DVCPRO
+	bool iec = (frame[4] & 0x07) == 0;
+	switch (size)
+	{
+	case 120000:
+		return is625 ? -1 : 0;
+	case 144000:
+		return !is625 ? -1 : (iec ? 2 : 1);
+	case 240000:
+		return is625 ? -1 : 3;
+	case 288000:
+		return !is625 ? -1 : 4;
+	}
+	return -1;
+}
+
+/** 9 bit signed DC at the start of a DCT block; the encoder took 128 off
+ * the samples and the DC is 8 times the mean at half the precision */
+static inline uchar dcValue(const uchar *block)
+{
+	int dc = (block[0] << 1) | (block[1] >> 7);
+	if (dc & 0x100)
+		dc -= 0x200;
+	return uchar(128 + (dc >> 1));
+}
+
+/// BT.601 studio range to RGB, 8 bit fixed point
+static inline quint32 rgbPixel(int y, int cb, int cr)
+{
+	int c = 298 * (y - 16) + 128;
+	int d = cb - 128;
+	int e = cr - 128;
+	int r = qBound(0, (c + 409 * e) >> 8, 255);
+	int g = qBound(0, (c - 100 * d - 208 * e) >> 8, 255);
+	int b = qBound(0, (c + 516 * d) >> 8, 255);
+	return 0xff000000u | (quint32(r) << 16) | (quint32(g) << 8) | quint32(b);
+}
+
+/// vector kernels return the number of pixels they handled, the rest is
+/// done by the scalar code
+typedef int (*ColorKernel)(const uchar *y, const uchar *cb, const uchar *cr, quint32 *out, int count);
+
+static int colorNone(const uchar *, const uchar *, const uchar *, quint32 *, int)
+{
+	return 0;
+}
+
+#ifdef DV_COLOR_X86
+
+/* 8 pixels per round: the products are summed up in 32 bit by madd on
+ * (y, cr) and (y, cb) pairs, then packed with saturation to bytes and
+ * interleaved to B, G, R, A */
+static int colorSse2(const uchar *y, const uchar *cb, const uchar *cr, quint32 *out, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias16 = _mm_set1_epi16(16);
+	const __m128i bias128 = _mm_set1_epi16(128);
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i alpha = _mm_set1_epi8(char(0xff));
+	const __m128i kR = _mm_set1_epi32((409 << 16) | 298);
+	const __m128i kG = _mm_set1_epi32(int((quint32(quint16(-100)) << 16) | 298));
+	const __m128i kGr = _mm_set1_epi32(int(quint16(-208)));
+	const __m128i kB = _mm_set1_epi32((516 << 16) | 298);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i c = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)), zero), bias16);
+		__m128i d = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cb + i)), zero), bias128);
+		__m128i e = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cr + i)), zero), bias128);
+
+		__m128i ce[2] = { _mm_unpacklo_epi16(c, e), _mm_unpackhi_epi16(c, e) };
+		__m128i cd[2] = { _mm_unpacklo_epi16(c, d), _mm_unpackhi_epi16(c, d) };
+		__m128i e0[2] = { _mm_unpacklo_epi16(e, zero), _mm_unpackhi_epi16(e, zero) };
+		__m128i r[2], g[2], b[2];
+		for (int h = 0; h < 2; ++h)
+		{
+			r[h] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce[h], kR), round), 8);
+			g[h] = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(cd[h], kG),
+			                                                  _mm_madd_epi16(e0[h], kGr)), round), 8);
+			b[h] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd[h], kB), round), 8);
+		}
+		__m128i r8 = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), zero);
+		__m128i g8 = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), zero);
+		__m128i b8 = _mm_packus_epi16(_mm_packs_epi32(b[0], b[1]), zero);
+		__m128i bg = _mm_unpacklo_epi8(b8, g8);
+		__m128i ra = _mm_unpacklo_epi8(r8, alpha);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(bg, ra));
+	}
+	return i;
+}
+
+#endif // DV_COLOR_X86
+
+struct Color
+{
+	Color() : kernel(colorNone), name("scalar")
+	{
+#ifdef DV_COLOR_X86
+		kernel = colorSse2;
+		name = "sse2";
+#endif
+	}
+	ColorKernel kernel;
+	const char *name;
+};
+
+static const Color &color()
+{
+	static const Color k;
+	return k;
+}
+
+static void convertRow(const uchar *y, const uchar *cb, const uchar *cr, quint32 *out, int count)
+{
+	int done = color().kernel(y, cb, cr, out, count);
+	for (int i = done; i < count; ++i)
+		out[i] = rgbPixel(y[i], cb[i], cr[i]);
+}
+
+QSize dvDcSize(const uchar *frame, qint64 size)
+{
+	int l = layoutOf(frame, size);
+	if (l < 0)
+		return QSize();
+	return QSize(layouts[l].width, layouts[l].height);
+}
+
+bool decodeDvDc(const uchar *frame, qint64 size, uchar *rgb, int bytesPerLine)
+{
+	int index = layoutOf(frame, size);
+	if (index < 0)
+		return false;
+	const Layout &l = layouts[index];
+	const int pixels = l.width * l.height;
+	// mid grey where a DIF block is damaged
+	QVarLengthArray<uchar, 3 * 90 * 72> planes(3 * pixels);
+	memset(planes.data(), 128, planes.size());
+	uchar *luma = planes.data();
+	uchar *cb = luma + pixels;
+	uchar *cr = cb + pixels;
+
+	const int w = l.width;
+	foreach(const MacroBlock &mb, macroBlocks().tables[index])
+	{
+		const uchar *dif = frame + mb.offset;
+		// section type 4: video
+		if ((dif[0] >> 5) != 4)
+			continue;
+		uchar dc[6];
+		for (int b = 0; b < 6; ++b)
+			dc[b] = dcValue(dif + dctBlockStart[b]);
+		const int p = mb.pixel;
+		switch (mb.shape)
+		{
+		case Sampling411:
+			memcpy(luma + p, dc, 4);
+			memset(cr + p, dc[4], 4);
+			memset(cb + p, dc[5], 4);
+			break;
+		case Sampling420:
+			luma[p] = dc[0];
+			luma[p + 1] = dc[1];
+			luma[p + w] = dc[2];
+			luma[p + w + 1] = dc[3];
+			memset(cr + p, dc[4], 2);
+			memset(cr + p + w, dc[4], 2);
+			memset(cb + p, dc[5], 2);
+			memset(cb + p + w, dc[5], 2);
+			break;
+		case Sampling422:
+			luma[p] = dc[0];
+			luma[p + 1] = dc[2];
+			memset(cr + p, dc[4], 2);
+			memset(cb + p, dc[5], 2);
+			break;
+		}
+	}
+
+	for (int row = 0; row < l.height; ++row)
+		convertRow(luma + row * w, cb + row * w, cr + row * w,
+		           reinterpret_cast<quint32*>(rgb + row * bytesPerLine), w);
+	return true;
+}
+
+const char *dvColorKernel()
+{
+	return color().name;
+}
+
+}
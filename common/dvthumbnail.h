@@ -0,0 +1,32 @@
+#ifndef DVTHUMBNAIL_H
+#define DVTHUMBNAIL_H
+#include <QtGlobal>
+#include <QSize>
+
+namespace MXF {
+
+/**
+ * Small pictures straight from DV essence: only the DC coefficient of each
+ * 8x8 DCT block is read, which sits at a fixed place in the DIF block, so
+ * there is no entropy decoding and no IDCT. The result is the picture at
+ * 1/8 scale (90x60 for 525/60, 90x72 for 625/50).
+ *
+ * Handles DV25 (DVCPRO 4:1:1, IEC 61834 4:2:0 for 625/50) and DV50
+ * (DVCPRO50 4:2:2) frames; the layout is told by the frame size and the
+ * DIF header. DVCPRO HD is not supported.
+ */
+
+/** size of the DC picture of frame, empty if frame is no DV25/DV50 frame */
+QSize dvDcSize(const uchar *frame, qint64 size);
+
+/** writes the DC picture of frame as 32 bit 0xffRRGGBB pixels (the layout
+ * of QImage::Format_RGB32), lines bytesPerLine apart. Returns false if
+ * frame is no DV25/DV50 frame; rgb is left alone then */
+bool decodeDvDc(const uchar *frame, qint64 size, uchar *rgb, int bytesPerLine);
+
+/** name of the colour conversion kernel, for benchmarks and logs */
+const char *dvColorKernel();
+
+}
+
+#endif // DVTHUMBNAIL_H
@@ -0,0 +1,332 @@
+#include "filecopier.h"
+#include <QFile>
+#include <QCryptographicHash>
+#include <QtConcurrent>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+namespace MXF
+{
+
+/// O_DIRECT needs buffers, sizes and offsets aligned to the logical block size
+static const qint64 directIoAlignment = 4096;
+
+static QString errnoString()
+{
+	return QString::fromLocal8Bit(strerror(errno));
+}
+
+static void clearDirectIo(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+	if ((flags != -1) && (flags & O_DIRECT))
+		fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+}
+
+/** reads until size bytes or the end of the file. -1 and errno on errors */
+static qint64 readFull(int fd, uchar *buffer, qint64 size)
+{
+	qint64 done = 0;
+	while (done < size)
+	{
+		ssize_t n = read(fd, buffer + done, size - done);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			// an unaligned remainder can't be read directly
+			if ((errno == EINVAL) && (fcntl(fd, F_GETFL) & O_DIRECT))
+			{
+				clearDirectIo(fd);
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+static bool writeFull(int fd, const uchar *buffer, qint64 size)
+{
+	qint64 done = 0;
+	while (done < size)
+	{
+		ssize_t n = write(fd, buffer + done, size - done);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if ((errno == EINVAL) && (fcntl(fd, F_GETFL) & O_DIRECT))
+			{
+				clearDirectIo(fd);
+				continue;
+			}
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+FileCopier::FileCopier() :
+    mBufferSize(8 * 1024 * 1024),
+    mDirectIo(true),
+    mAllocated(0),
+    mHashes(XxHash64Hash | Md5Hash),
+    mProgress(0),
+    mCancel(0),
+    mBytesCopied(0)
+{
+	mBuffers[0] = 0;
+	mBuffers[1] = 0;
+	mReader.setMaxThreadCount(1);
+}
+
+FileCopier::~FileCopier()
+{
+	mReader.waitForDone();
+	free(mBuffers[0]);
+	free(mBuffers[1]);
+}
+
+void FileCopier::setBufferSize(qint64 size)
+{
+	size = qMax(size, directIoAlignment);
+	mBufferSize = (size + directIoAlignment - 1) / directIoAlignment * directIoAlignment;
+}
+
+void FileCopier::setDirectIo(bool enabled)
+{
+	mDirectIo = enabled;
+}
+
+void FileCopier::setHashes(int hashes)
+{
+	mHashes = hashes;
+}
+
+void FileCopier::setProgressCounter(QAtomicInteger<qint64> *counter)
+{
+	mProgress = counter;
+}
+
+void FileCopier::setCancelFlag(const QAtomicInt *cancel)
+{
+	mCancel = cancel;
+}
+
+QString FileCopier::errorString() const
+{
+	return mError;
+}
+
+qint64 FileCopier::bytesCopied() const
+{
+	return mBytesCopied;
+}
+
+QByteArray FileCopier::xxHash64() const
+{
+	return mXxHash64;
+}
+
+QByteArray FileCopier::md5() const
+{
+	return mMd5;
+}
+
+bool FileCopier::fail(const QString &message)
+{
+	mError = message;
+	return false;
+}
+
+bool FileCopier::allocate()
+{
+	if (mAllocated == mBufferSize)
+		return true;
+	for (int i = 0; i < 2; ++i)
+	{
+		free(mBuffers[i]);
+		void *p = 0;
+		if (posix_memalign(&p, directIoAlignment, mBufferSize))
+			p = 0;
+		mBuffers[i] = static_cast<uchar*>(p);
+	}
+	mAllocated = (mBuffers[0] && mBuffers[1]) ? mBufferSize : 0;
+	return mAllocated;
+}
+
+/** opens with O_DIRECT if wanted and possible, *direct tells which it was */
+int FileCopier::openFile(const QString &fileName, int flags, bool *direct)
+{
+	QByteArray name = QFile::encodeName(fileName);
+	*direct = false;
+	if (mDirectIo)
+	{
+		int fd = open(name.constData(), flags | O_DIRECT, 0644);
+		if (fd >= 0)
+		{
+			*direct = true;
+			return fd;
+		}
+		// e.g. tmpfs or some FUSE file systems
+		if (errno != EINVAL)
+			return -1;
+	}
+	return open(name.constData(), flags, 0644);
+}
+
+/** reads in until the end through both buffers, hashing everything and
+ * writing it to out unless out is -1. Returns an error message */
+QString FileCopier::transfer(int in, const QString &source, int out, bool directOut,
+                             const QString &destination)
+{
+	XxHash64 xxh;
+	QCryptographicHash md5(QCryptographicHash::Md5);
+	QString error;
+	int current = 0;
+	QFuture<qint64> pending = QtConcurrent::run(&mReader, readFull, in, mBuffers[0], mBufferSize);
+	while (1)
+	{
+		qint64 n = pending.result();
+		if (n < 0)
+		{
+			error = QStringLiteral("%1: %2").arg(source, errnoString());
+			break;
+		}
+		if (n == 0)
+			break;
+		bool last = (n < mBufferSize);
+		if (mCancel && mCancel->loadAcquire())
+		{
+			error = QStringLiteral("%1: cancelled").arg(source);
+			break;
+		}
+		if (!last)
+			pending = QtConcurrent::run(&mReader, readFull, in, mBuffers[1 - current], mBufferSize);
+
+		const uchar *data = mBuffers[current];
+		if (mHashes & XxHash64Hash)
+			xxh.addData(data, n);
+		if (mHashes & Md5Hash)
+			md5.addData(reinterpret_cast<const char*>(data), int(n));
+		if (out >= 0)
+		{
+			// the tail of a file is not a multiple of the block size
+			if (directOut && (n % directIoAlignment))
+				clearDirectIo(out);
+			if (!writeFull(out, data, n))
+			{
+				error = QStringLiteral("%1: %2").arg(destination, errnoString());
+				if (!last)
+					pending.waitForFinished();
+				break;
+			}
+		}
+		mBytesCopied += n;
+		if (mProgress)
+			mProgress->fetchAndAddRelaxed(n);
+		if (last)
+			break;
+		current = 1 - current;
+	}
+	if (error.isEmpty())
+	{
+		if (mHashes & XxHash64Hash)
+			mXxHash64 = xxh.hexResult();
+		if (mHashes & Md5Hash)
+			mMd5 = md5.result().toHex();
+	}
+	return error;
+}
+
+bool FileCopier::copy(const QString &source, const QString &destination)
+{
+	mBytesCopied = 0;
+	mXxHash64.clear();
+	mMd5.clear();
+	if (!allocate())
+		return fail(QStringLiteral("out of memory"));
+
+	bool directIn, directOut;
+	int in = openFile(source, O_RDONLY, &directIn);
+	if (in < 0)
+		return fail(QStringLiteral("%1: %2").arg(source, errnoString()));
+	struct stat st;
+	if (fstat(in, &st))
+	{
+		close(in);
+		return fail(QStringLiteral("%1: %2").arg(source, errnoString()));
+	}
+	if (!directIn)
+		posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	QString partName = destination + ".part";
+	int out = openFile(partName, O_WRONLY | O_CREAT | O_TRUNC, &directOut);
+	if (out < 0)
+	{
+		close(in);
+		return fail(QStringLiteral("%1: %2").arg(partName, errnoString()));
+	}
+	// one extent where the file system can, failures don't matter
+	if (st.st_size > 0)
+		fallocate(out, 0, 0, st.st_size);
+
+	QString error = transfer(in, source, out, directOut, partName);
+	close(in);
+
+	if (error.isEmpty() && (mBytesCopied != st.st_size))
+		error = QStringLiteral("%1: size changed while copying").arg(source);
+	if (error.isEmpty() && fdatasync(out))
+		error = QStringLiteral("%1: %2").arg(partName, errnoString());
+	if (error.isEmpty())
+	{
+		struct timespec times[2] = { st.st_atim, st.st_mtim };
+		futimens(out, times);
+	}
+	if (close(out) && error.isEmpty())
+		error = QStringLiteral("%1: %2").arg(partName, errnoString());
+	if (error.isEmpty()
+	        && rename(QFile::encodeName(partName).constData(), QFile::encodeName(destination).constData()))
+		error = QStringLiteral("%1: %2").arg(destination, errnoString());
+	if (!error.isEmpty())
+	{
+		unlink(QFile::encodeName(partName).constData());
+		mXxHash64.clear();
+		mMd5.clear();
+		return fail(error);
+	}
+	return true;
+}
+
+bool FileCopier::hash(const QString &source)
+{
+	mBytesCopied = 0;
+	mXxHash64.clear();
+	mMd5.clear();
+	if (!allocate())
+		return fail(QStringLiteral("out of memory"));
+
+	bool direct;
+	int in = openFile(source, O_RDONLY, &direct);
+	if (in < 0)
+		return fail(QStringLiteral("%1: %2").arg(source, errnoString()));
+	if (!direct)
+		posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+	QString error = transfer(in, source, -1, false, QString());
+	close(in);
+	if (!error.isEmpty())
+		return fail(error);
+	return true;
+}
+
+}
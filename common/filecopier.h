@@ -0,0 +1,80 @@
+#ifndef FILECOPIER_H
+#define FILECOPIER_H
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QAtomicInt>
+#include "xxhash64.h"
+
+namespace MXF {
+
+/**
+ * Copies files with two large aligned buffers: while one buffer is hashed
+ * and written, the next one is read by a helper thread. Source and
+ * destination are opened with O_DIRECT where the file systems support it,
+ * so a card offload doesn't push everything else out of the page cache.
+ * xxHash64 and MD5 of the data are computed on the way.
+ */
+class FileCopier
+{
+public:
+	enum Hash
+	{
+		XxHash64Hash = 1,
+		Md5Hash = 2
+	};
+
+	FileCopier();
+	~FileCopier();
+
+	/** size of each of the two buffers, default 8 MB */
+	void setBufferSize(qint64 size);
+	void setDirectIo(bool enabled);
+	/** Hash flags, the hashes to compute (default: both) */
+	void setHashes(int hashes);
+	/** counter that gets every chunk read added, for progress reports
+	 * from other threads. Not owned */
+	void setProgressCounter(QAtomicInteger<qint64> *counter);
+	/** flag set from another thread to stop a copy or hash between two
+	 * buffers. Not owned */
+	void setCancelFlag(const QAtomicInt *cancel);
+
+	/** writes to destination.part and renames it when everything was
+	 * written and synced. The modification time is taken over */
+	bool copy(const QString &source, const QString &destination);
+	/** only reads and hashes source */
+	bool hash(const QString &source);
+	QString errorString() const;
+
+	/** results of the last copy or hash, hashes are hex and empty when not
+	 * computed */
+	qint64 bytesCopied() const;
+	QByteArray xxHash64() const;
+	QByteArray md5() const;
+
+private:
+	bool fail(const QString &message);
+	bool allocate();
+	int openFile(const QString &fileName, int flags, bool *direct);
+	QString transfer(int in, const QString &source, int out, bool directOut,
+	                 const QString &destination);
+
+	qint64 mBufferSize;
+	bool mDirectIo;
+	uchar *mBuffers[2];
+	qint64 mAllocated;
+	int mHashes;
+	QAtomicInteger<qint64> *mProgress;
+	const QAtomicInt *mCancel;
+	QThreadPool mReader;
+	QString mError;
+	qint64 mBytesCopied;
+	QByteArray mXxHash64;
+	QByteArray mMd5;
+};
+
+}
+
+#endif // FILECOPIER_H
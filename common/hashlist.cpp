@@ -0,0 +1,144 @@
+#include "hashlist.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QSysInfo>
+
+namespace MXF
+{
+
+static QString mhlDate(const QDateTime &t)
+{
+	return t.toUTC().toString(QStringLiteral("yyyy-MM-dd'T'HH:mm:ss'Z'"));
+}
+
+static QDateTime parseMhlDate(const QString &s)
+{
+	return QDateTime::fromString(s, Qt::ISODate);
+}
+
+QString HashList::errorString() const
+{
+	return mError;
+}
+
+bool HashList::load(const QString &fileName)
+{
+	entries.clear();
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		mError = QStringLiteral("%1: %2").arg(fileName, file.errorString());
+		return false;
+	}
+	QXmlStreamReader xml(&file);
+	Entry entry;
+	bool inHash = false;
+	while (!xml.atEnd())
+	{
+		xml.readNext();
+		if (xml.isStartElement())
+		{
+			// a copy, readElementText() moves on
+			QString name = xml.name().toString();
+			if (name == QLatin1String("hash"))
+			{
+				entry = Entry();
+				inHash = true;
+			}
+			else if (inHash)
+			{
+				QString text = xml.readElementText();
+				if (name == QLatin1String("file"))
+					entry.file = text;
+				else if (name == QLatin1String("size"))
+					entry.size = text.toLongLong();
+				else if (name == QLatin1String("lastmodificationdate"))
+					entry.modified = parseMhlDate(text);
+				else if (name == QLatin1String("xxhash64be") || name == QLatin1String("xxhash64"))
+					entry.xxHash64 = text.trimmed().toLatin1().toLower();
+				else if (name == QLatin1String("md5"))
+					entry.md5 = text.trimmed().toLatin1().toLower();
+				else if (name == QLatin1String("hashdate"))
+					entry.hashed = parseMhlDate(text);
+			}
+			else if (name == QLatin1String("source"))
+				source = xml.readElementText();
+			else if (name == QLatin1String("tool"))
+				tool = xml.readElementText();
+			else if (name == QLatin1String("startdate"))
+				started = parseMhlDate(xml.readElementText());
+			else if (name == QLatin1String("finishdate"))
+				finished = parseMhlDate(xml.readElementText());
+		}
+		else if (xml.isEndElement() && (xml.name() == QLatin1String("hash")))
+		{
+			inHash = false;
+			if (!entry.file.isEmpty())
+				entries.append(entry);
+		}
+	}
+	if (xml.hasError())
+	{
+		mError = QStringLiteral("%1: %2").arg(fileName, xml.errorString());
+		return false;
+	}
+	return true;
+}
+
+bool HashList::save(const QString &fileName) const
+{
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		mError = QStringLiteral("%1: %2").arg(fileName, file.errorString());
+		return false;
+	}
+	QXmlStreamWriter xml(&file);
+	xml.setAutoFormatting(true);
+	xml.writeStartDocument();
+	xml.writeStartElement("hashlist");
+	xml.writeAttribute("version", "1.1");
+	xml.writeStartElement("creatorinfo");
+	xml.writeTextElement("username", QString::fromLocal8Bit(qgetenv("USER")));
+	xml.writeTextElement("hostname", QSysInfo::machineHostName());
+	xml.writeTextElement("tool", tool);
+	xml.writeTextElement("source", source);
+	xml.writeTextElement("startdate", mhlDate(started));
+	xml.writeTextElement("finishdate", mhlDate(finished));
+	xml.writeEndElement();
+	foreach(const Entry &e, entries)
+	{
+		xml.writeStartElement("hash");
+		xml.writeTextElement("file", e.file);
+		xml.writeTextElement("size", QString::number(e.size));
+		xml.writeTextElement("lastmodificationdate", mhlDate(e.modified));
+		if (!e.xxHash64.isEmpty())
+			xml.writeTextElement("xxhash64be", QString::fromLatin1(e.xxHash64));
+		if (!e.md5.isEmpty())
+			xml.writeTextElement("md5", QString::fromLatin1(e.md5));
+		xml.writeTextElement("hashdate", mhlDate(e.hashed));
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+	xml.writeEndDocument();
+	if (xml.hasError() || !file.commit())
+	{
+		mError = QStringLiteral("%1: %2").arg(fileName, file.errorString());
+		return false;
+	}
+	return true;
+}
+
+QString HashList::find(const QString &folder)
+{
+	QFileInfoList lists = QDir(folder).entryInfoList(QStringList() << "*.mhl" << "*.MHL",
+	                                                 QDir::Files, QDir::Time);
+	if (lists.isEmpty())
+		return QString();
+	return lists.first().absoluteFilePath();
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef HASHLIST_H
+#define HASHLIST_H
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+
+namespace MXF {
+
+/**
+ * ASC MHL 1.1 hash list as written next to the CONTENTS folder of an
+ * offloaded card. File names are relative to the folder of the list.
+ */
+class HashList
+{
+public:
+	struct Entry
+	{
+		Entry() : size(-1) {}
+		QString file;
+		qint64 size;
+		QDateTime modified;
+		QByteArray xxHash64; ///< hex, empty if not listed
+		QByteArray md5;      ///< hex, empty if not listed
+		QDateTime hashed;
+	};
+
+	QString source;
+	QString tool;
+	QDateTime started;
+	QDateTime finished;
+	QList<Entry> entries;
+
+	bool load(const QString &fileName);
+	bool save(const QString &fileName) const;
+	QString errorString() const;
+
+	/** the newest *.mhl file in folder, empty if there is none */
+	static QString find(const QString &folder);
+
+private:
+	mutable QString mError;
+};
+
+}
+
+#endif // HASHLIST_H
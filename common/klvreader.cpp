@@ -0,0 +1,556 @@
+#include "klvreader.h"
+#include <QtEndian>
+#include <QDebug>
+#include <string.h>
+#include <limits>
+
+namespace MXF
+{
+
+/// partition packs, primer and random index pack share these 13 bytes
+static const uchar partitionPrefix[13] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x02, 0x05, 0x01, 0x01,
+	0x0D, 0x01, 0x02, 0x01, 0x01
+};
+
+/// a run-in may precede the header partition, it is limited to 64k
+static const qint64 maxRunIn = 65536;
+
+static bool isPartitionPack(const uchar *key)
+{
+	return !memcmp(key, partitionPrefix, sizeof(partitionPrefix))
+	        && (key[13] >= 0x02) && (key[13] <= 0x04);
+}
+
+static bool isRandomIndexPack(const uchar *key)
+{
+	return !memcmp(key, partitionPrefix, sizeof(partitionPrefix))
+	        && (key[13] == 0x11);
+}
+
+static bool isPrimerPack(const uchar *key)
+{
+	return !memcmp(key, partitionPrefix, sizeof(partitionPrefix))
+	        && (key[13] == 0x05) && (key[14] == 0x01);
+}
+
+static bool isMetadataSet(const uchar *key)
+{
+	// 06.0E.2B.34.02.53.01.01.0D.01.01.01.01.xx.xx.xx
+	static const uchar set[5] = { 0x0D, 0x01, 0x01, 0x01, 0x01 };
+	return !memcmp(key, partitionPrefix, 4)
+	        && (key[4] == 0x02) && (key[5] == 0x53)
+	        && !memcmp(key + 8, set, sizeof(set));
+}
+
+static bool isIndexSegment(const uchar *key)
+{
+	// 06.0E.2B.34.02.53.01.01.0D.01.02.01.01.10.01.00, version byte ignored
+	return !memcmp(key, partitionPrefix, 4)
+	        && (key[4] == 0x02) && (key[5] == 0x53)
+	        && !memcmp(key + 8, partitionPrefix + 8, 5)
+	        && (key[13] == 0x10) && (key[14] == 0x01);
+}
+
+static bool isEssenceElement(const uchar *key)
+{
+	// generic container essence element 06.0E.2B.34.01.02.01.xx.0D.01.03.01
+	static const uchar gc[4] = { 0x0D, 0x01, 0x03, 0x01 };
+	return !memcmp(key, partitionPrefix, 4)
+	        && (key[4] == 0x01) && (key[5] == 0x02) && (key[6] == 0x01)
+	        && !memcmp(key + 8, gc, sizeof(gc));
+}
+
+static QByteArray ul(const uchar *p)
+{
+	return QByteArray(reinterpret_cast<const char*>(p), 16);
+}
+
+static bool parsePartition(const uchar *key, const uchar *v, qint64 length, PartitionPack *pack)
+{
+	if (length < 88)
+		return false;
+	switch (key[13]) {
+	case 0x02:
+		pack->kind = HeaderPartition;
+		break;
+	case 0x03:
+		pack->kind = BodyPartition;
+		break;
+	default:
+		pack->kind = FooterPartition;
+		break;
+	}
+	pack->closed = (key[14] == 0x02) || (key[14] == 0x04);
+	pack->complete = (key[14] == 0x03) || (key[14] == 0x04);
+	pack->majorVersion = qFromBigEndian<quint16>(v);
+	pack->minorVersion = qFromBigEndian<quint16>(v + 2);
+	pack->kagSize = qFromBigEndian<quint32>(v + 4);
+	pack->thisPartition = qFromBigEndian<quint64>(v + 8);
+	pack->previousPartition = qFromBigEndian<quint64>(v + 16);
+	pack->footerPartition = qFromBigEndian<quint64>(v + 24);
+	pack->headerByteCount = qFromBigEndian<quint64>(v + 32);
+	pack->indexByteCount = qFromBigEndian<quint64>(v + 40);
+	pack->indexSID = qFromBigEndian<quint32>(v + 48);
+	pack->bodyOffset = qFromBigEndian<quint64>(v + 52);
+	pack->bodySID = qFromBigEndian<quint32>(v + 60);
+	pack->operationalPattern = ul(v + 64);
+	quint32 count = qFromBigEndian<quint32>(v + 80);
+	quint32 itemSize = qFromBigEndian<quint32>(v + 84);
+	if ((itemSize == 16) && (88 + qint64(count) * 16 <= length))
+	{
+		for (quint32 i = 0; i < count; ++i)
+			pack->essenceContainers.append(ul(v + 88 + i * 16));
+	}
+	return true;
+}
+
+static void parsePrimer(const uchar *v, qint64 length, QMap<quint16, QByteArray> *primer)
+{
+	if (length < 8)
+		return;
+	quint32 count = qFromBigEndian<quint32>(v);
+	quint32 itemSize = qFromBigEndian<quint32>(v + 4);
+	if ((itemSize < 18) || (8 + qint64(count) * itemSize > length))
+		return;
+	for (quint32 i = 0; i < count; ++i)
+	{
+		const uchar *item = v + 8 + qint64(i) * itemSize;
+		primer->insert(qFromBigEndian<quint16>(item), ul(item + 2));
+	}
+}
+
+static bool parseIndexSegment(const uchar *v, qint64 length, IndexTableSegment *segment)
+{
+	qint64 pos = 0;
+	quint8 sliceCount = 0;
+	quint8 posTableCount = 0;
+	while (pos + 4 <= length)
+	{
+		quint16 tag = qFromBigEndian<quint16>(v + pos);
+		quint16 size = qFromBigEndian<quint16>(v + pos + 2);
+		const uchar *item = v + pos + 4;
+		pos += 4 + size;
+		if (pos > length)
+			return false;
+		switch (tag) {
+		case 0x3F0B: // IndexEditRate
+			if (size >= 8)
+			{
+				segment->editRateNumerator = qFromBigEndian<qint32>(item);
+				segment->editRateDenominator = qFromBigEndian<qint32>(item + 4);
+			}
+			break;
+		case 0x3F0C: // IndexStartPosition
+			if (size >= 8)
+				segment->indexStartPosition = qFromBigEndian<qint64>(item);
+			break;
+		case 0x3F0D: // IndexDuration
+			if (size >= 8)
+				segment->indexDuration = qFromBigEndian<qint64>(item);
+			break;
+		case 0x3F05: // EditUnitByteCount
+			if (size >= 4)
+				segment->editUnitByteCount = qFromBigEndian<quint32>(item);
+			break;
+		case 0x3F06: // IndexSID
+			if (size >= 4)
+				segment->indexSID = qFromBigEndian<quint32>(item);
+			break;
+		case 0x3F07: // BodySID
+			if (size >= 4)
+				segment->bodySID = qFromBigEndian<quint32>(item);
+			break;
+		case 0x3F08: // SliceCount
+			if (size >= 1)
+				sliceCount = item[0];
+			break;
+		case 0x3F0E: // PosTableCount
+			if (size >= 1)
+				posTableCount = item[0];
+			break;
+		case 0x3F0A: // IndexEntryArray
+		{
+			if (size < 8)
+				break;
+			quint32 count = qFromBigEndian<quint32>(item);
+			quint32 entrySize = qFromBigEndian<quint32>(item + 4);
+			// the entry size is in the batch header, the counts only matter
+			// for sanity checking here
+			if ((entrySize < 11u + 4u * sliceCount + 8u * posTableCount)
+			        || (8 + qint64(count) * entrySize > size))
+				return false;
+			segment->entries.resize(count);
+			for (quint32 i = 0; i < count; ++i)
+			{
+				const uchar *e = item + 8 + qint64(i) * entrySize;
+				IndexEntry &entry = segment->entries[i];
+				entry.temporalOffset = qint8(e[0]);
+				entry.keyFrameOffset = qint8(e[1]);
+				entry.flags = e[2];
+				entry.streamOffset = qFromBigEndian<quint64>(e + 3);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+Span Span::mid(qint64 offset, qint64 length) const
+{
+	if ((offset < 0) || (offset > size))
+		return Span();
+	if ((length < 0) || (length > size - offset))
+		length = size - offset;
+	return Span(data + offset, length);
+}
+
+QByteArray Span::toByteArray() const
+{
+	// a QByteArray can't hold more, an int cast would wrap
+	if (size > std::numeric_limits<int>::max())
+		return QByteArray();
+	return QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size));
+}
+
+KlvReader::KlvReader() :
+    mData(0), mSize(0)
+{
+}
+
+KlvReader::KlvReader(const QString &fileName) :
+    mData(0), mSize(0)
+{
+	open(fileName);
+}
+
+KlvReader::~KlvReader()
+{
+	close();
+}
+
+bool KlvReader::open(const QString &fileName)
+{
+	close();
+	mFile.setFileName(fileName);
+	if (!mFile.open(QFile::ReadOnly))
+		return fail(mFile.errorString());
+	mSize = mFile.size();
+	mData = mFile.map(0, mSize);
+	if (!mData)
+		return fail(mFile.errorString());
+	if (!parse())
+	{
+		qWarning() << "MXF:" << fileName << mError;
+		return false;
+	}
+	return true;
+}
+
+void KlvReader::close()
+{
+	if (mData)
+		mFile.unmap(const_cast<uchar*>(mData));
+	mFile.close();
+	mData = 0;
+	mSize = 0;
+	mError.clear();
+	mPartitions.clear();
+	mIndexSegments.clear();
+	mEssence.clear();
+	mRuns.clear();
+	mPrimer.clear();
+	mMetadataSets.clear();
+}
+
+bool KlvReader::isOpen() const
+{
+	return mData != 0;
+}
+
+QString KlvReader::fileName() const
+{
+	return mFile.fileName();
+}
+
+QString KlvReader::errorString() const
+{
+	return mError;
+}
+
+qint64 KlvReader::size() const
+{
+	return mSize;
+}
+
+int KlvReader::handle() const
+{
+	return mFile.handle();
+}
+
+QList<PartitionPack> KlvReader::partitions() const
+{
+	return mPartitions;
+}
+
+QList<IndexTableSegment> KlvReader::indexSegments() const
+{
+	return mIndexSegments;
+}
+
+QList<EssenceElement> KlvReader::essenceElements() const
+{
+	return mEssence;
+}
+
+bool KlvReader::isOpAtom() const
+{
+	// 06.0E.2B.34.04.01.01.02.0D.01.02.01.10.xx.00.00
+	if (mPartitions.isEmpty())
+		return false;
+	const QByteArray &op = mPartitions.first().operationalPattern;
+	return (op.size() == 16) && (uchar(op[12]) == 0x10);
+}
+
+QMap<quint16, QByteArray> KlvReader::primer() const
+{
+	return mPrimer;
+}
+
+QList<KlvPacket> KlvReader::metadataSets() const
+{
+	return mMetadataSets;
+}
+
+Span KlvReader::span(qint64 offset, qint64 length) const
+{
+	if ((offset < 0) || (length < 0) || (offset > mSize) || (length > mSize - offset))
+		return Span();
+	return Span(mData + offset, length);
+}
+
+qint64 KlvReader::fileOffset(const Span &span) const
+{
+	return span.data - mData;
+}
+
+Span KlvReader::essence() const
+{
+	if (mEssence.isEmpty())
+		return Span();
+	const KlvPacket &klv = mEssence.first().klv;
+	return span(klv.valueOffset, klv.length);
+}
+
+Span KlvReader::essence(qint64 startByteOffset, qint64 dataSize) const
+{
+	foreach(const EssenceElement &e, mEssence)
+	{
+		if ((startByteOffset >= e.klv.valueOffset)
+		        && (startByteOffset + dataSize <= e.klv.next()))
+			return span(startByteOffset, dataSize);
+	}
+	return Span();
+}
+
+qint64 KlvReader::editUnitCount() const
+{
+	qint64 count = 0;
+	foreach(const IndexTableSegment &s, mIndexSegments)
+	{
+		qint64 duration = s.indexDuration;
+		if (!duration && s.editUnitByteCount && !mRuns.isEmpty())
+			duration = mRuns.last().length / s.editUnitByteCount;
+		count = qMax(count, s.indexStartPosition + duration);
+	}
+	return count;
+}
+
+quint32 KlvReader::editUnitByteCount() const
+{
+	foreach(const IndexTableSegment &s, mIndexSegments)
+	{
+		if (s.editUnitByteCount)
+			return s.editUnitByteCount;
+	}
+	return 0;
+}
+
+qint64 KlvReader::editUnitOffset(qint64 position) const
+{
+	foreach(const IndexTableSegment &s, mIndexSegments)
+	{
+		if (position < s.indexStartPosition)
+			continue;
+		if (s.editUnitByteCount)
+		{
+			if (s.indexDuration && (position >= s.indexStartPosition + s.indexDuration))
+				continue;
+			return streamToFile(quint64(position) * s.editUnitByteCount, s.editUnitByteCount);
+		}
+		qint64 i = position - s.indexStartPosition;
+		if (i < s.entries.size())
+			return streamToFile(s.entries[i].streamOffset, 0);
+	}
+	return -1;
+}
+
+Span KlvReader::editUnits(qint64 position, qint64 count) const
+{
+	quint32 eubc = editUnitByteCount();
+	qint64 start = editUnitOffset(position);
+	if ((start < 0) || (count < 1))
+		return Span();
+	if (eubc)
+		return span(start, count * eubc);
+	qint64 end = editUnitOffset(position + count);
+	if (end < 0)
+	{
+		// last edit unit of the file, runs up to the end of the essence
+		foreach(const EssenceRun &run, mRuns)
+		{
+			if ((start >= run.fileOffset) && (start < run.fileOffset + run.length))
+				end = run.fileOffset + run.length;
+		}
+	}
+	if (end < start)
+		return Span();
+	return span(start, end - start);
+}
+
+bool KlvReader::readKlv(const uchar *data, qint64 size, qint64 offset, KlvPacket *packet)
+{
+	if ((offset < 0) || (offset > size - 17))
+		return false;
+	const uchar *p = data + offset + 16;
+	qint64 length = 0;
+	int lengthSize = 1;
+	if (*p < 0x80)
+	{
+		length = *p;
+	}
+	else
+	{
+		int n = *p & 0x7F;
+		if ((n > 8) || (n > size - offset - 17))
+			return false;
+		for (int i = 1; i <= n; ++i)
+			length = (length << 8) | p[i];
+		lengthSize += n;
+	}
+	// a corrupt length may be close to the qint64 maximum, don't add to it
+	if ((length < 0) || (length > size - offset - 16 - lengthSize))
+		return false;
+	packet->key = data + offset;
+	packet->offset = offset;
+	packet->valueOffset = offset + 16 + lengthSize;
+	packet->length = length;
+	return true;
+}
+
+bool KlvReader::parse()
+{
+	// find the header partition, skipping a possible run-in
+	qint64 pos = 0;
+	qint64 searchEnd = qMin(mSize - 16, maxRunIn);
+	while ((pos <= searchEnd) && !isPartitionPack(mData + pos))
+		pos++;
+	if (pos > searchEnd)
+		return fail(QStringLiteral("no header partition found"));
+
+	KlvPacket klv;
+	quint32 bodySID = 0;
+	quint64 bodyOffset = 0;
+	int runElements = 0;
+	EssenceRun run;
+	while (readKlv(mData, mSize, pos, &klv))
+	{
+		if (isPartitionPack(klv.key) || isRandomIndexPack(klv.key))
+		{
+			if (runElements)
+				mRuns.append(run);
+			runElements = 0;
+			if (isRandomIndexPack(klv.key))
+				break;
+			PartitionPack pack;
+			if (!parsePartition(klv.key, mData + klv.valueOffset, klv.length, &pack))
+				return fail(QStringLiteral("invalid partition pack at %1").arg(klv.offset));
+			pack.fileOffset = klv.offset;
+			bodySID = pack.bodySID;
+			bodyOffset = pack.bodyOffset;
+			mPartitions.append(pack);
+		}
+		else if (mPartitions.size() == 1 && isPrimerPack(klv.key))
+		{
+			parsePrimer(mData + klv.valueOffset, klv.length, &mPrimer);
+		}
+		else if (mPartitions.size() == 1 && isMetadataSet(klv.key))
+		{
+			mMetadataSets.append(klv);
+		}
+		else if (isIndexSegment(klv.key))
+		{
+			IndexTableSegment segment;
+			if (!parseIndexSegment(mData + klv.valueOffset, klv.length, &segment))
+				return fail(QStringLiteral("invalid index table segment at %1").arg(klv.offset));
+			mIndexSegments.append(segment);
+		}
+		else if (isEssenceElement(klv.key))
+		{
+			EssenceElement e;
+			e.trackNumber = qFromBigEndian<quint32>(klv.key + 12);
+			e.bodySID = bodySID;
+			e.klv = klv;
+			mEssence.append(e);
+			if (!runElements)
+			{
+				// a single (clip wrapped) element is indexed from its value,
+				// frame wrapped essence from the first key
+				run.bodySID = bodySID;
+				run.bodyOffset = bodyOffset;
+				run.fileOffset = klv.valueOffset;
+				run.length = klv.length;
+			}
+			else
+			{
+				if (runElements == 1)
+					run.fileOffset = mEssence[mEssence.size() - 2].klv.offset;
+				run.length = klv.next() - run.fileOffset;
+			}
+			runElements++;
+		}
+		pos = klv.next();
+	}
+	if (runElements)
+		mRuns.append(run);
+	if (mPartitions.isEmpty())
+		return fail(QStringLiteral("invalid header partition"));
+	return true;
+}
+
+bool KlvReader::fail(const QString &message)
+{
+	mError = message;
+	if (mData)
+		mFile.unmap(const_cast<uchar*>(mData));
+	mData = 0;
+	mSize = 0;
+	mFile.close();
+	return false;
+}
+
+qint64 KlvReader::streamToFile(quint64 streamOffset, qint64 length) const
+{
+	foreach(const EssenceRun &run, mRuns)
+	{
+		if ((streamOffset >= run.bodyOffset)
+		        && (streamOffset + length <= run.bodyOffset + run.length))
+			return run.fileOffset + qint64(streamOffset - run.bodyOffset);
+	}
+	return -1;
+}
+
+}
@@ -0,0 +1,174 @@
+#ifndef KLVREADER_H
+#define KLVREADER_H
+#include <QtGlobal>
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+namespace MXF {
+
+/** a view into the memory mapped file, valid as long as the reader is open */
+struct Span
+{
+	Span(const uchar *d = 0, qint64 s = 0) : data(d), size(s) {}
+	bool isNull() const { return !data; }
+	Span mid(qint64 offset, qint64 length = -1) const;
+	/** wraps the data without copying it, empty if it is larger than a
+	 * QByteArray can be */
+	QByteArray toByteArray() const;
+
+	const uchar *data;
+	qint64 size;
+};
+
+struct KlvPacket
+{
+	KlvPacket() : key(0), offset(-1), valueOffset(-1), length(0) {}
+	const uchar *key;       ///< 16 bytes, points into the mapping
+	qint64 offset;          ///< file offset of the key
+	qint64 valueOffset;     ///< file offset of the value
+	qint64 length;          ///< length of the value
+	qint64 next() const { return valueOffset + length; }
+};
+
+enum PartitionKind {
+	HeaderPartition,
+	BodyPartition,
+	FooterPartition
+};
+
+struct PartitionPack
+{
+	PartitionKind kind;
+	bool closed;
+	bool complete;
+	quint16 majorVersion;
+	quint16 minorVersion;
+	quint32 kagSize;
+	quint64 thisPartition;
+	quint64 previousPartition;
+	quint64 footerPartition;
+	quint64 headerByteCount;
+	quint64 indexByteCount;
+	quint32 indexSID;
+	quint64 bodyOffset;
+	quint32 bodySID;
+	QByteArray operationalPattern;
+	QList<QByteArray> essenceContainers;
+	qint64 fileOffset;      ///< where the pack was found (may differ if there is a run-in)
+};
+
+struct IndexEntry
+{
+	qint8 temporalOffset;
+	qint8 keyFrameOffset;
+	quint8 flags;
+	quint64 streamOffset;
+};
+
+struct IndexTableSegment
+{
+	IndexTableSegment() :
+	    editRateNumerator(0), editRateDenominator(1),
+	    indexStartPosition(0), indexDuration(0), editUnitByteCount(0),
+	    indexSID(0), bodySID(0) {}
+	qint32 editRateNumerator;
+	qint32 editRateDenominator;
+	qint64 indexStartPosition;
+	qint64 indexDuration;
+	quint32 editUnitByteCount;  ///< 0 if the segment has index entries
+	quint32 indexSID;
+	quint32 bodySID;
+	QVector<IndexEntry> entries;
+};
+
+struct EssenceElement
+{
+	quint32 trackNumber;    ///< last four bytes of the key
+	quint32 bodySID;        ///< of the partition the element was found in
+	KlvPacket klv;
+};
+
+/**
+ * Reads the KLV structure of an MXF file (as found on P2 cards: OP-Atom,
+ * one clip wrapped essence element per file) through a memory mapping.
+ * The essence is handed out as spans into the mapping, nothing is copied.
+ */
+class KlvReader
+{
+public:
+	KlvReader();
+	explicit KlvReader(const QString &fileName);
+	~KlvReader();
+
+	bool open(const QString &fileName);
+	void close();
+	bool isOpen() const;
+	QString fileName() const;
+	QString errorString() const;
+	qint64 size() const;
+	/** file descriptor of the underlying file, e.g. for zero copy transfers */
+	int handle() const;
+
+	QList<PartitionPack> partitions() const;
+	QList<IndexTableSegment> indexSegments() const;
+	QList<EssenceElement> essenceElements() const;
+	bool isOpAtom() const;
+	/** local tag -> UL as given by the primer pack of the header partition */
+	QMap<quint16, QByteArray> primer() const;
+	/** structural metadata sets (local sets) of the header partition */
+	QList<KlvPacket> metadataSets() const;
+
+	/** any range of the file */
+	Span span(qint64 offset, qint64 length) const;
+	/** file offset of a span handed out by this reader */
+	qint64 fileOffset(const Span &span) const;
+	/** the essence of the first essence element */
+	Span essence() const;
+	/** range as given by StartByteOffset/DataSize of the clip xml.
+	 * returns a null span if it does not lie within an essence element */
+	Span essence(qint64 startByteOffset, qint64 dataSize) const;
+
+	/** edit units covered by the index table */
+	qint64 editUnitCount() const;
+	/** constant size of an edit unit or 0 if the essence is VBR */
+	quint32 editUnitByteCount() const;
+	/** file offset of an edit unit's essence data, -1 if unknown */
+	qint64 editUnitOffset(qint64 position) const;
+	/** essence data of count edit units starting at position */
+	Span editUnits(qint64 position, qint64 count = 1) const;
+
+	/** reads key and BER length at offset. returns false if there is no
+	 * complete KLV packet */
+	static bool readKlv(const uchar *data, qint64 size, qint64 offset, KlvPacket *packet);
+
+private:
+	struct EssenceRun
+	{
+		quint32 bodySID;
+		quint64 bodyOffset;     ///< stream offset of the first byte of the run
+		qint64 fileOffset;
+		qint64 length;
+	};
+
+	bool parse();
+	bool fail(const QString &message);
+	qint64 streamToFile(quint64 streamOffset, qint64 length) const;
+
+	QFile mFile;
+	const uchar *mData;
+	qint64 mSize;
+	QString mError;
+	QList<PartitionPack> mPartitions;
+	QList<IndexTableSegment> mIndexSegments;
+	QList<EssenceElement> mEssence;
+	QList<EssenceRun> mRuns;
+	QMap<quint16, QByteArray> mPrimer;
+	QList<KlvPacket> mMetadataSets;
+};
+
+}
+
+#endif // KLVREADER_H
@@ -0,0 +1,999 @@
+#include "mxfmeta.h"
+#include <QVarLengthArray>
+#include <QDebug>
+#include <string.h>
+#include <strings.h>
+
+namespace MXF
+{
+
+/** what a ClipInfo shares between its copies */
+class ClipData : public QSharedData
+{
+public:
+	ClipData() :
+	    duration(0),
+	    isNull(true)
+	{
+		editUnit.numerator = 0;
+		editUnit.denominator = 1;
+		relation.offsetInShot = 0;
+	}
+
+	QString clipName;
+	QString globalClipID;
+	EditUnit editUnit;
+	int duration;
+	ClipRelation relation;
+	VideoInfo videoEssence;
+	QVector<AudioInfo> audioEssences;
+	ClipMetaData metaData;
+	bool isNull;
+};
+
+/**
+ * Single pass P2 clip xml parser working on the raw UTF-8 bytes. The
+ * elements that are read form a fixed tree (tags[] below); the parser state
+ * is the tag of the innermost open element, a start tag moves to the child
+ * with that name and everything else is skipped together with its children.
+ * Strings are only created for the values that are kept.
+ */
+class ClipParser
+{
+public:
+	enum Tag {
+		TagNone = -1,
+		TagDocument,
+		TagP2Main,
+		TagClipContent,
+		TagClipName,
+		TagGlobalClipID,
+		TagDuration,
+		TagEditUnit,
+		TagRelation,
+		TagOffsetInShot,
+		TagGlobalShotID,
+		TagConnection,
+		TagTop,
+		TagTopClipName,
+		TagTopGlobalClipID,
+		TagTopSerialNo,
+		TagPrevious,
+		TagPreviousClipName,
+		TagPreviousGlobalClipID,
+		TagPreviousSerialNo,
+		TagNext,
+		TagNextClipName,
+		TagNextGlobalClipID,
+		TagNextSerialNo,
+		TagEssenceList,
+		TagVideo,
+		TagVideoFormat,
+		TagCodec,
+		TagFrameRate,
+		TagStartTimecode,
+		TagStartBinaryGroup,
+		TagAspectRatio,
+		TagVideoIndex,
+		TagVideoStartByteOffset,
+		TagVideoDataSize,
+		TagAudio,
+		TagAudioFormat,
+		TagSamplingRate,
+		TagBitsPerSample,
+		TagAudioIndex,
+		TagAudioStartByteOffset,
+		TagAudioDataSize,
+		TagClipMetadata,
+		TagUserClipName,
+		TagDataSource,
+		TagAccess,
+		TagCreationDate,
+		TagLastUpdateDate,
+		TagDevice,
+		TagManufacturer,
+		TagSerialNo,
+		TagModelName,
+		TagShoot,
+		TagStartDate,
+		TagEndDate,
+		TagThumbnail,
+		TagFrameOffset,
+		TagThumbnailFormat,
+		TagWidth,
+		TagHeight,
+		TagCount
+	};
+
+	explicit ClipParser(ClipData &clip);
+	bool parse(const char *data, qint64 size);
+	QString errorString() const;
+
+private:
+	struct OpenTag
+	{
+		const char *name;
+		int length;
+		Tag tag;
+	};
+
+	Tag child(Tag parent, const char *name, int length) const;
+	void startElement(Tag tag, const char *attributes, const char *end);
+	void value(Tag tag, const char *begin, const char *end);
+	bool fail(const char *position, const QString &message);
+
+	ClipData &mClip;
+	bool mHasVideo;
+	const char *mData;
+	QString mError;
+};
+
+struct TagName
+{
+	ClipParser::Tag parent;
+	const char *name;
+	int length;
+};
+
+#define TAG(parent, name) { ClipParser::parent, name, int(sizeof(name) - 1) }
+
+/// indexed by ClipParser::Tag
+static const TagName tags[] = {
+	TAG(TagNone, ""),
+	TAG(TagDocument, "P2Main"),
+	TAG(TagP2Main, "ClipContent"),
+	TAG(TagClipContent, "ClipName"),
+	TAG(TagClipContent, "GlobalClipID"),
+	TAG(TagClipContent, "Duration"),
+	TAG(TagClipContent, "EditUnit"),
+	TAG(TagClipContent, "Relation"),
+	TAG(TagRelation, "OffsetInShot"),
+	TAG(TagRelation, "GlobalShotID"),
+	TAG(TagRelation, "Connection"),
+	TAG(TagConnection, "Top"),
+	TAG(TagTop, "ClipName"),
+	TAG(TagTop, "GlobalClipID"),
+	TAG(TagTop, "P2SerialNo."),
+	TAG(TagConnection, "Previous"),
+	TAG(TagPrevious, "ClipName"),
+	TAG(TagPrevious, "GlobalClipID"),
+	TAG(TagPrevious, "P2SerialNo."),
+	TAG(TagConnection, "Next"),
+	TAG(TagNext, "ClipName"),
+	TAG(TagNext, "GlobalClipID"),
+	TAG(TagNext, "P2SerialNo."),
+	TAG(TagClipContent, "EssenceList"),
+	TAG(TagEssenceList, "Video"),
+	TAG(TagVideo, "VideoFormat"),
+	TAG(TagVideo, "Codec"),
+	TAG(TagVideo, "FrameRate"),
+	TAG(TagVideo, "StartTimecode"),
+	TAG(TagVideo, "StartBinaryGroup"),
+	TAG(TagVideo, "AspectRatio"),
+	TAG(TagVideo, "VideoIndex"),
+	TAG(TagVideoIndex, "StartByteOffset"),
+	TAG(TagVideoIndex, "DataSize"),
+	TAG(TagEssenceList, "Audio"),
+	TAG(TagAudio, "AudioFormat"),
+	TAG(TagAudio, "SamplingRate"),
+	TAG(TagAudio, "BitsPerSample"),
+	TAG(TagAudio, "AudioIndex"),
+	TAG(TagAudioIndex, "StartByteOffset"),
+	TAG(TagAudioIndex, "DataSize"),
+	TAG(TagClipContent, "ClipMetadata"),
+	TAG(TagClipMetadata, "UserClipName"),
+	TAG(TagClipMetadata, "DataSource"),
+	TAG(TagClipMetadata, "Access"),
+	TAG(TagAccess, "CreationDate"),
+	TAG(TagAccess, "LastUpdateDate"),
+	TAG(TagClipMetadata, "Device"),
+	TAG(TagDevice, "Manufacturer"),
+	TAG(TagDevice, "SerialNo."),
+	TAG(TagDevice, "ModelName"),
+	TAG(TagClipMetadata, "Shoot"),
+	TAG(TagShoot, "StartDate"),
+	TAG(TagShoot, "EndDate"),
+	TAG(TagClipMetadata, "Thumbnail"),
+	TAG(TagThumbnail, "FrameOffset"),
+	TAG(TagThumbnail, "ThumbnailFormat"),
+	TAG(TagThumbnail, "Width"),
+	TAG(TagThumbnail, "Height")
+};
+
+#undef TAG
+
+Q_STATIC_ASSERT(sizeof(tags) / sizeof(tags[0]) == ClipParser::TagCount);
+
+static inline bool isSpace(char c)
+{
+	return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+}
+
+static inline bool isDigit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+static void trim(const char *&begin, const char *&end)
+{
+	while ((begin < end) && isSpace(*begin))
+		++begin;
+	while ((end > begin) && isSpace(end[-1]))
+		--end;
+}
+
+/** decimal number at the start of [begin, end), 0 if there is none */
+static qint64 toNumber(const char *begin, const char *end)
+{
+	bool negative = (begin < end) && (*begin == '-');
+	if (negative || ((begin < end) && (*begin == '+')))
+		++begin;
+	qint64 n = 0;
+	for (; (begin < end) && isDigit(*begin); ++begin)
+		n = n * 10 + (*begin - '0');
+	return negative ? -n : n;
+}
+
+/** reads count digits at p, false if there are less */
+static bool digits(const char *&p, const char *end, int count, int *out)
+{
+	if (end - p < count)
+		return false;
+	int n = 0;
+	for (int i = 0; i < count; ++i, ++p)
+	{
+		if (!isDigit(*p))
+			return false;
+		n = n * 10 + (*p - '0');
+	}
+	*out = n;
+	return true;
+}
+
+static bool expect(const char *&p, const char *end, char c)
+{
+	if ((p >= end) || (*p != c))
+		return false;
+	++p;
+	return true;
+}
+
+/** UTF-8 text with the predefined and numeric entities resolved */
+static QString toText(const char *begin, const char *end)
+{
+	if (!memchr(begin, '&', end - begin))
+		return QString::fromUtf8(begin, int(end - begin));
+	QByteArray decoded;
+	decoded.reserve(int(end - begin));
+	while (begin < end)
+	{
+		const char *amp = static_cast<const char*>(memchr(begin, '&', end - begin));
+		if (!amp)
+			amp = end;
+		decoded.append(begin, int(amp - begin));
+		if (amp == end)
+			break;
+		const char *semicolon = static_cast<const char*>(memchr(amp, ';', end - amp));
+		if (!semicolon)
+		{
+			decoded.append(amp, int(end - amp));
+			break;
+		}
+		QByteArray entity(amp + 1, int(semicolon - amp - 1));
+		if (entity == "lt")
+			decoded.append('<');
+		else if (entity == "gt")
+			decoded.append('>');
+		else if (entity == "amp")
+			decoded.append('&');
+		else if (entity == "quot")
+			decoded.append('"');
+		else if (entity == "apos")
+			decoded.append('\'');
+		else if (entity.startsWith('#'))
+		{
+			bool ok;
+			uint code = entity.startsWith("#x") ? entity.mid(2).toUInt(&ok, 16) : entity.mid(1).toUInt(&ok);
+			if (ok)
+				decoded.append(QString(QChar(code)).toUtf8());
+		}
+		else
+			decoded.append(amp, int(semicolon + 1 - amp));
+		begin = semicolon + 1;
+	}
+	return QString::fromUtf8(decoded);
+}
+
+/** hh:mm:ss:ff, ';' or '.' separate the frames of drop frame timecodes */
+static timeCode toTimecode(const char *begin, const char *end)
+{
+	int values[4];
+	bool dropFrame = false;
+	const char *p = begin;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i && ((p >= end) || ((*p != ':') && (*p != ';') && (*p != '.'))))
+			return timeCode();
+		if (i == 3)
+			dropFrame = *p != ':';
+		if (i)
+			++p;
+		const char *start = p;
+		while ((p < end) && isDigit(*p))
+			++p;
+		if (p == start)
+			return timeCode();
+		values[i] = int(toNumber(start, p));
+	}
+	if (p != end)
+		return timeCode();
+	return timeCode(values[0], values[1], values[2], values[3], dropFrame);
+}
+
+/** YYYY-MM-DDThh:mm:ss[.fff][Z|+hh:mm|-hh:mm], as written by the cameras.
+ * Anything else goes through QDateTime's own ISO parser */
+static QDateTime toDateTime(const char *begin, const char *end)
+{
+	const char *p = begin;
+	int year, month, day, hour, minute, second, msec = 0;
+	bool ok = digits(p, end, 4, &year) && expect(p, end, '-')
+	        && digits(p, end, 2, &month) && expect(p, end, '-')
+	        && digits(p, end, 2, &day) && expect(p, end, 'T')
+	        && digits(p, end, 2, &hour) && expect(p, end, ':')
+	        && digits(p, end, 2, &minute) && expect(p, end, ':')
+	        && digits(p, end, 2, &second);
+	if (ok && (p < end) && (*p == '.'))
+	{
+		++p;
+		int scale = 100;
+		for (; (p < end) && isDigit(*p); ++p, scale /= 10)
+			msec += (*p - '0') * scale;
+	}
+	if (!ok)
+		return QDateTime::fromString(toText(begin, end), Qt::ISODate);
+
+	QDate date(year, month, day);
+	QTime time(hour, minute, second, msec);
+	if (p == end)
+		return QDateTime(date, time, Qt::LocalTime);
+	if ((*p == 'Z') && (p + 1 == end))
+		return QDateTime(date, time, Qt::UTC);
+	int sign = (*p == '-') ? -1 : 1;
+	int offsetHours, offsetMinutes = 0;
+	if (((*p != '+') && (*p != '-')) || !digits(++p, end, 2, &offsetHours))
+		return QDateTime::fromString(toText(begin, end), Qt::ISODate);
+	if ((p < end) && (*p == ':'))
+		++p;
+	if ((p < end) && !digits(p, end, 2, &offsetMinutes))
+		return QDateTime::fromString(toText(begin, end), Qt::ISODate);
+	return QDateTime(date, time, Qt::OffsetFromUTC, sign * (offsetHours * 3600 + offsetMinutes * 60));
+}
+
+ClipParser::ClipParser(ClipData &clip) :
+    mClip(clip),
+    mHasVideo(false),
+    mData(0)
+{
+}
+
+QString ClipParser::errorString() const
+{
+	return mError;
+}
+
+bool ClipParser::fail(const char *position, const QString &message)
+{
+	int line = 1;
+	const char *lineStart = mData;
+	for (const char *p = mData; p < position; ++p)
+	{
+		if (*p == '\n')
+		{
+			line++;
+			lineStart = p + 1;
+		}
+	}
+	mError = QStringLiteral("%1 in %2:%3").arg(message).arg(line).arg(position - lineStart + 1);
+	return false;
+}
+
+ClipParser::Tag ClipParser::child(Tag parent, const char *name, int length) const
+{
+	if (parent == TagNone)
+		return TagNone;
+	for (int t = parent + 1; t < TagCount; ++t)
+	{
+		if ((tags[t].parent == parent) && (tags[t].length == length)
+		        && !memcmp(tags[t].name, name, length))
+			return Tag(t);
+	}
+	return TagNone;
+}
+
+bool ClipParser::parse(const char *data, qint64 size)
+{
+	mData = data;
+	const char *p = data;
+	const char *end = data + size;
+	// UTF-8 byte order mark
+	if ((size >= 3) && !memcmp(p, "\xEF\xBB\xBF", 3))
+		p += 3;
+
+	QVarLengthArray<OpenTag, 16> open;
+	bool hasRoot = false;
+	// text of the innermost element, usually one piece between two tags
+	const char *textBegin = 0;
+	const char *textEnd = 0;
+	QByteArray textPieces;
+	while (p < end)
+	{
+		const char *lt = static_cast<const char*>(memchr(p, '<', end - p));
+		if (!lt)
+			lt = end;
+		Tag current = open.isEmpty() ? TagDocument : open.last().tag;
+		if ((lt > p) && (current != TagNone) && !open.isEmpty())
+		{
+			if (!textBegin)
+			{
+				textBegin = p;
+				textEnd = lt;
+			}
+			else
+			{
+				if (textPieces.isEmpty())
+					textPieces.append(textBegin, int(textEnd - textBegin));
+				textPieces.append(p, int(lt - p));
+			}
+		}
+		if (lt == end)
+			break;
+		p = lt + 1;
+		if (p >= end)
+			return fail(lt, QStringLiteral("Unexpected end of document"));
+
+		if (*p == '/')
+		{
+			const char *name = ++p;
+			while ((p < end) && (*p != '>') && !isSpace(*p))
+				++p;
+			const char *nameEnd = p;
+			p = static_cast<const char*>(memchr(p, '>', end - p));
+			if (!p)
+				return fail(lt, QStringLiteral("Unterminated end tag"));
+			++p;
+			if (open.isEmpty() || (open.last().length != nameEnd - name)
+			        || memcmp(open.last().name, name, nameEnd - name))
+				return fail(lt, QStringLiteral("Opening and ending tag mismatch"));
+			Tag tag = open.last().tag;
+			if ((tag != TagNone) && textBegin)
+			{
+				if (textPieces.isEmpty())
+					value(tag, textBegin, textEnd);
+				else
+					value(tag, textPieces.constData(), textPieces.constData() + textPieces.size());
+			}
+			open.removeLast();
+			textBegin = textEnd = 0;
+			textPieces.clear();
+			continue;
+		}
+		if (*p == '?')
+		{
+			const char *close = p + 1;
+			for (; close + 1 < end; ++close)
+			{
+				if ((close[0] == '?') && (close[1] == '>'))
+					break;
+			}
+			if (close + 1 >= end)
+				return fail(lt, QStringLiteral("Unterminated processing instruction"));
+			p = close + 2;
+			continue;
+		}
+		if (*p == '!')
+		{
+			if ((end - p >= 3) && !memcmp(p, "!--", 3))
+			{
+				const char *close = p + 3;
+				for (; close + 2 < end; ++close)
+				{
+					if (!memcmp(close, "-->", 3))
+						break;
+				}
+				if (close + 2 >= end)
+					return fail(lt, QStringLiteral("Unterminated comment"));
+				p = close + 3;
+				continue;
+			}
+			if ((end - p >= 8) && !memcmp(p, "![CDATA[", 8))
+			{
+				const char *begin = p + 8;
+				const char *close = begin;
+				for (; close + 2 < end; ++close)
+				{
+					if (!memcmp(close, "]]>", 3))
+						break;
+				}
+				if (close + 2 >= end)
+					return fail(lt, QStringLiteral("Unterminated CDATA section"));
+				if (!open.isEmpty() && (open.last().tag != TagNone))
+				{
+					if (textBegin && textPieces.isEmpty())
+						textPieces.append(textBegin, int(textEnd - textBegin));
+					if (textBegin)
+						textPieces.append(begin, int(close - begin));
+					else
+					{
+						textBegin = begin;
+						textEnd = close;
+					}
+				}
+				p = close + 3;
+				continue;
+			}
+			// DOCTYPE without internal subset
+			p = static_cast<const char*>(memchr(p, '>', end - p));
+			if (!p)
+				return fail(lt, QStringLiteral("Unterminated declaration"));
+			++p;
+			continue;
+		}
+
+		// start tag, attribute values may contain '>'
+		const char *name = p;
+		while ((p < end) && (*p != '>') && (*p != '/') && !isSpace(*p))
+			++p;
+		int length = int(p - name);
+		const char *attributes = p;
+		char quote = 0;
+		for (; p < end; ++p)
+		{
+			if (quote)
+			{
+				if (*p == quote)
+					quote = 0;
+			}
+			else if ((*p == '"') || (*p == '\''))
+				quote = *p;
+			else if (*p == '>')
+				break;
+		}
+		if ((p >= end) || !length)
+			return fail(lt, QStringLiteral("Unterminated start tag"));
+		bool empty = (p[-1] == '/');
+		const char *attributesEnd = empty ? p - 1 : p;
+		++p;
+		if (open.isEmpty())
+		{
+			if (hasRoot)
+				return fail(lt, QStringLiteral("Extra content at the end of the document"));
+			hasRoot = true;
+		}
+		Tag tag = child(current, name, length);
+		// only the first video essence is read
+		if ((tag == TagVideo) && mHasVideo)
+			tag = TagNone;
+		startElement(tag, attributes, attributesEnd);
+		textBegin = textEnd = 0;
+		textPieces.clear();
+		if (empty)
+			continue;
+		OpenTag o;
+		o.name = name;
+		o.length = length;
+		o.tag = tag;
+		open.append(o);
+	}
+	if (!open.isEmpty())
+		return fail(end, QStringLiteral("Premature end of document"));
+	if (!hasRoot)
+		return fail(end, QStringLiteral("No root element"));
+	return true;
+}
+
+void ClipParser::startElement(Tag tag, const char *attributes, const char *end)
+{
+	switch (tag)
+	{
+	case TagClipContent:
+		mClip.isNull = false;
+		break;
+	case TagVideo:
+	{
+		mHasVideo = true;
+		VideoInfo &video = mClip.videoEssence;
+		video.mIsNull = false;
+		video.mValidAudio = true;
+		static const char flag[] = "ValidAudioFlag";
+		const char *p = attributes;
+		while (p < end)
+		{
+			const char *found = static_cast<const char*>(memmem(p, end - p, flag, sizeof(flag) - 1));
+			if (!found)
+				break;
+			p = found + sizeof(flag) - 1;
+			while ((p < end) && isSpace(*p))
+				++p;
+			if ((p >= end) || (*p != '='))
+				continue;
+			++p;
+			while ((p < end) && isSpace(*p))
+				++p;
+			if ((p >= end) || ((*p != '"') && (*p != '\'')))
+				continue;
+			const char *valueEnd = static_cast<const char*>(memchr(p + 1, *p, end - p - 1));
+			if (!valueEnd)
+				break;
+			video.mValidAudio = (valueEnd - p - 1 == 4) && !strncasecmp(p + 1, "true", 4);
+			break;
+		}
+		break;
+	}
+	case TagAudio:
+		mClip.audioEssences.append(AudioInfo());
+		break;
+	case TagClipMetadata:
+		// what the DOM parser used when there is no Access element
+		mClip.metaData.mCreationDate = mClip.metaData.mLastUpdate = QDateTime::currentDateTime();
+		break;
+	case TagAccess:
+		mClip.metaData.mCreationDate = mClip.metaData.mLastUpdate = QDateTime();
+		break;
+	default:
+		break;
+	}
+}
+
+void ClipParser::value(Tag tag, const char *begin, const char *end)
+{
+	trim(begin, end);
+	ClipRelation &relation = mClip.relation;
+	VideoInfo &video = mClip.videoEssence;
+	AudioInfo *audio = mClip.audioEssences.isEmpty() ? 0 : &mClip.audioEssences.last();
+	ClipMetaData &meta = mClip.metaData;
+	switch (tag)
+	{
+	case TagClipName:
+		mClip.clipName = toText(begin, end);
+		break;
+	case TagGlobalClipID:
+		mClip.globalClipID = toText(begin, end);
+		break;
+	case TagDuration:
+		mClip.duration = int(toNumber(begin, end));
+		break;
+	case TagEditUnit:
+	{
+		const char *slash = static_cast<const char*>(memchr(begin, '/', end - begin));
+		mClip.editUnit.numerator = float(toNumber(begin, slash ? slash : end));
+		mClip.editUnit.denominator = slash ? float(toNumber(slash + 1, end)) : 1;
+		break;
+	}
+	case TagOffsetInShot:
+		relation.offsetInShot = int(toNumber(begin, end));
+		break;
+	case TagGlobalShotID:
+		relation.globalShotId = toText(begin, end);
+		break;
+	case TagTopClipName:
+		relation.connectionTop.clipName = toText(begin, end);
+		break;
+	case TagTopGlobalClipID:
+		relation.connectionTop.globalClipId = toText(begin, end);
+		break;
+	case TagTopSerialNo:
+		relation.connectionTop.p2SerialNo = toText(begin, end);
+		break;
+	case TagPreviousClipName:
+		relation.connectionPrevious.clipName = toText(begin, end);
+		break;
+	case TagPreviousGlobalClipID:
+		relation.connectionPrevious.globalClipId = toText(begin, end);
+		break;
+	case TagPreviousSerialNo:
+		relation.connectionPrevious.p2SerialNo = toText(begin, end);
+		break;
+	case TagNextClipName:
+		relation.connectionNext.clipName = toText(begin, end);
+		break;
+	case TagNextGlobalClipID:
+		relation.connectionNext.globalClipId = toText(begin, end);
+		break;
+	case TagNextSerialNo:
+		relation.connectionNext.p2SerialNo = toText(begin, end);
+		break;
+	case TagVideoFormat:
+		video.mVideoFormat = toText(begin, end);
+		break;
+	case TagCodec:
+		video.mCodec = toText(begin, end);
+		break;
+	case TagFrameRate:
+		video.mFrameRate = toText(begin, end);
+		break;
+	case TagStartTimecode:
+		video.mStartTimecode = toTimecode(begin, end);
+		break;
+	case TagStartBinaryGroup:
+		video.mStartBinaryGroup = toText(begin, end);
+		break;
+	case TagAspectRatio:
+		video.mAspectRatio = toText(begin, end);
+		break;
+	case TagVideoStartByteOffset:
+		video.mVideoIndex.startByteOffset = size_t(toNumber(begin, end));
+		break;
+	case TagVideoDataSize:
+		video.mVideoIndex.dataSize = size_t(toNumber(begin, end));
+		break;
+	case TagAudioFormat:
+		audio->mAudioFormat = toText(begin, end);
+		break;
+	case TagSamplingRate:
+		audio->mSamplingRate = int(toNumber(begin, end));
+		break;
+	case TagBitsPerSample:
+		audio->mBitsPerSample = int(toNumber(begin, end));
+		break;
+	case TagAudioStartByteOffset:
+		audio->mAudioIndex.startByteOffset = size_t(toNumber(begin, end));
+		break;
+	case TagAudioDataSize:
+		audio->mAudioIndex.dataSize = size_t(toNumber(begin, end));
+		break;
+	case TagUserClipName:
+		meta.mUserClipName = toText(begin, end);
+		break;
+	case TagDataSource:
+		meta.mDataSource = toText(begin, end);
+		break;
+	case TagCreationDate:
+		meta.mCreationDate = toDateTime(begin, end);
+		break;
+	case TagLastUpdateDate:
+		meta.mLastUpdate = toDateTime(begin, end);
+		break;
+	case TagManufacturer:
+		meta.mDevice.manufacturer = toText(begin, end);
+		break;
+	case TagSerialNo:
+		meta.mDevice.serialNo = toText(begin, end);
+		break;
+	case TagModelName:
+		meta.mDevice.modelName = toText(begin, end);
+		break;
+	case TagStartDate:
+		meta.mShootStart = toDateTime(begin, end);
+		break;
+	case TagEndDate:
+		meta.mShootEnd = toDateTime(begin, end);
+		break;
+	case TagFrameOffset:
+		meta.mThumbnail.frameOffset = int(toNumber(begin, end));
+		break;
+	case TagThumbnailFormat:
+		meta.mThumbnail.format = toText(begin, end);
+		break;
+	case TagWidth:
+		meta.mThumbnail.size.setWidth(int(toNumber(begin, end)));
+		break;
+	case TagHeight:
+		meta.mThumbnail.size.setHeight(int(toNumber(begin, end)));
+		break;
+	default:
+		break;
+	}
+}
+
+//video entry in essence list
+
+VideoInfo::VideoInfo() :
+    mValidAudio(true),
+    mIsNull(true)
+{
+	mVideoIndex.startByteOffset = 0;
+	mVideoIndex.dataSize = 0;
+}
+
+bool VideoInfo::validAudioFlag() const
+{
+	return mValidAudio;
+}
+
+const QString &VideoInfo::videoFormat() const
+{
+    return mVideoFormat;
+}
+
+const QString &VideoInfo::frameRate() const
+{
+    return mFrameRate;
+}
+
+const QString &VideoInfo::codec() const
+{
+    return mCodec;
+}
+
+timeCode VideoInfo::startTimecode() const
+{
+    return mStartTimecode;
+}
+
+bool VideoInfo::isNull() const
+{
+	return mIsNull;
+}
+
+MediaIndex VideoInfo::VideoIndex() const
+{
+	return mVideoIndex;
+}
+
+const QString &VideoInfo::aspectRatio() const
+{
+	return mAspectRatio;
+}
+
+
+//audio entry in essence list
+AudioInfo::AudioInfo() :
+    mSamplingRate(0), mBitsPerSample(0)
+{
+	mAudioIndex.startByteOffset = 0;
+	mAudioIndex.dataSize = 0;
+}
+
+const QString &AudioInfo::audioFormat() const
+{
+	return mAudioFormat;
+}
+int AudioInfo::samplingRate() const
+{
+	return mSamplingRate;
+}
+int AudioInfo::bitsPerSample() const
+{
+	return mBitsPerSample;
+}
+MediaIndex AudioInfo::audioIndex() const
+{
+	return mAudioIndex;
+}
+
+ClipInfo::ClipInfo(const QByteArray &xmlData) :
+    ClipInfo(xmlData.constData(), xmlData.size())
+{
+}
+
+ClipInfo::ClipInfo(const char *xmlData, qint64 size) :
+    d(new ClipData)
+{
+	if (!size)
+		return;
+	ClipParser parser(*d);
+	if (!parser.parse(xmlData, size))
+	{
+		qCritical() << "Failed reading XML file:" << parser.errorString();
+		d = new ClipData;
+	}
+}
+
+ClipInfo::ClipInfo(const ClipInfo &other) :
+    d(other.d)
+{
+}
+
+ClipInfo::ClipInfo(ClipInfo &&other) Q_DECL_NOTHROW :
+    d(std::move(other.d))
+{
+}
+
+ClipInfo &ClipInfo::operator=(const ClipInfo &other)
+{
+	d = other.d;
+	return *this;
+}
+
+ClipInfo &ClipInfo::operator=(ClipInfo &&other) Q_DECL_NOTHROW
+{
+	d.swap(other.d);
+	return *this;
+}
+
+ClipInfo::~ClipInfo()
+{
+}
+
+const QString &ClipInfo::clipName() const
+{
+	return d->clipName;
+}
+
+const QString &ClipInfo::globalClipID() const
+{
+	return d->globalClipID;
+}
+
+int ClipInfo::duration() const
+{
+	return d->duration;
+}
+
+const ClipRelation &ClipInfo::relation() const
+{
+	return d->relation;
+}
+
+const VideoInfo &ClipInfo::videoEssence() const
+{
+	return d->videoEssence;
+}
+
+const QVector<AudioInfo> &ClipInfo::audioEssences() const
+{
+	return d->audioEssences;
+}
+
+const ClipMetaData &ClipInfo::metaData() const
+{
+	return d->metaData;
+}
+
+bool ClipInfo::isNull() const
+{
+	return d->isNull;
+}
+
+EditUnit ClipInfo::editUnit() const
+{
+	return d->editUnit;
+}
+
+ClipMetaData::ClipMetaData()
+{
+	mThumbnail.frameOffset = 0;
+}
+
+const QString &ClipMetaData::userClipName() const
+{
+	return mUserClipName;
+}
+
+
+const QString &ClipMetaData::dataSource() const
+{
+	return mDataSource;
+}
+
+const QDateTime &ClipMetaData::creationDate() const
+{
+	return mCreationDate;
+}
+
+const DeviceInfo &ClipMetaData::device() const
+{
+	return mDevice;
+}
+
+const QDateTime &ClipMetaData::shootStart() const
+{
+	return mShootStart;
+}
+
+const QDateTime &ClipMetaData::shootEnd() const
+{
+	return mShootEnd;
+}
+
+const ThumbNailInfo &ClipMetaData::thumbnail() const
+{
+	return mThumbnail;
+}
+
+const QDateTime &ClipMetaData::lastUpdate() const
+{
+	return mLastUpdate;
+}
+
+}
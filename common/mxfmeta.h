@@ -0,0 +1,197 @@
+#ifndef MXFMETA_H
+#define MXFMETA_H
+#include <QtGlobal>
+#include <QDateTime>
+#include <QSize>
+#include <QVector>
+#include <QSharedDataPointer>
+namespace MXF {
+
+class ClipParser;
+class ClipData;
+
+struct timeCode {
+	timeCode(int h=0, int m=0, int s=0, int f=0, bool df=false) :
+	    hours(h), minutes(m), seconds(s), frames(f), dropFrame(df) {}
+	QString toString() const
+	{
+		return QString().sprintf(dropFrame ? "%d:%02d:%02d;%02d" : "%d:%02d:%02d:%02d",
+		                         hours,
+		                         minutes,
+		                         seconds,
+		                         frames);
+	}
+	/** frames since 0:00:00:00 at timecodeBase frames per second (e.g. 30
+	 * for 29.97). Drop frame timecodes skip the first 2 (4 at 60) frame
+	 * numbers of every minute but every tenth */
+	qint64 frameCount(int timecodeBase) const
+	{
+		qint64 totalMinutes = hours * 60 + minutes;
+		qint64 count = (totalMinutes * 60 + seconds) * timecodeBase + frames;
+		if (dropFrame && !(timecodeBase % 30))
+			count -= (timecodeBase / 15) * (totalMinutes - totalMinutes / 10);
+		return count;
+	}
+	int hours;
+	int minutes;
+	int seconds;
+	int frames;
+	bool dropFrame;     ///< written with ';' or '.' before the frames
+};
+
+struct MediaIndex {
+	size_t startByteOffset;
+	size_t dataSize;
+};
+
+struct EditUnit {
+	float numerator;
+	float denominator;
+};
+
+struct ClipConnection
+{
+	bool isSet() const {
+		return !clipName.isNull();
+	}
+	QString clipName;
+	QString globalClipId;
+	QString p2SerialNo;
+};
+
+struct ClipRelation
+{
+	int offsetInShot;
+	QString globalShotId;
+	ClipConnection connectionTop;
+	ClipConnection connectionPrevious;
+	ClipConnection connectionNext;
+};
+
+class VideoInfo
+{
+public:
+	VideoInfo();
+	bool validAudioFlag() const;
+	const QString &videoFormat() const;
+	const QString &frameRate() const;
+	const QString &codec() const;
+	timeCode startTimecode() const;
+	bool isNull() const;
+	MediaIndex VideoIndex() const;
+
+	const QString &aspectRatio() const;
+
+private:
+	QString mVideoFormat;
+	QString mFrameRate;
+	QString mCodec;
+	QString mAspectRatio;
+	timeCode mStartTimecode;
+	QString mStartBinaryGroup;
+	MediaIndex mVideoIndex;
+	bool mValidAudio;
+	bool mIsNull;
+
+	friend class ClipParser;
+};
+
+struct AudioInfo {
+public:
+	AudioInfo();
+	const QString &audioFormat() const;
+	int samplingRate() const;
+	int bitsPerSample() const;
+	MediaIndex audioIndex() const;
+
+private:
+	QString mAudioFormat;
+	int mSamplingRate;
+	int mBitsPerSample;
+	MediaIndex mAudioIndex;
+
+	friend class ClipParser;
+};
+
+struct DeviceInfo
+{
+	QString manufacturer;
+	QString serialNo;
+	QString modelName;
+};
+struct ThumbNailInfo
+{
+	int frameOffset;
+	QString format;
+	QSize size;
+};
+
+class ClipMetaData
+{
+public:
+	ClipMetaData();
+
+	const QString &userClipName() const;
+	const QString &dataSource() const;
+	const QDateTime &creationDate() const;
+	const QDateTime &lastUpdate() const;
+	const DeviceInfo &device() const;
+	const QDateTime &shootStart() const;
+	const QDateTime &shootEnd() const;
+	const ThumbNailInfo &thumbnail() const;
+
+private:
+	QString mUserClipName;
+	QString mDataSource;
+	QDateTime mCreationDate;
+	QDateTime mLastUpdate;
+	DeviceInfo mDevice;
+	QDateTime mShootStart;
+	QDateTime mShootEnd;
+
+	ThumbNailInfo mThumbnail;
+
+	friend class ClipParser;
+};
+
+/**
+ * A clip as described by its P2 clip xml (CONTENTS/CLIP/<clip>.XML). The
+ * xml is parsed in one pass over the raw bytes, without a DOM.
+ * Copies are implicitly shared and all accessors return references into
+ * the shared data, so passing clips around and sorting them allocates
+ * nothing; the references stay valid as long as the ClipInfo does.
+ */
+class ClipInfo {
+public:
+	ClipInfo(const QByteArray & xmlData = QByteArray());
+	ClipInfo(const char *xmlData, qint64 size);
+	ClipInfo(const ClipInfo &other);
+	ClipInfo(ClipInfo &&other) Q_DECL_NOTHROW;
+	ClipInfo &operator=(const ClipInfo &other);
+	ClipInfo &operator=(ClipInfo &&other) Q_DECL_NOTHROW;
+	~ClipInfo();
+	void swap(ClipInfo &other) Q_DECL_NOTHROW { d.swap(other.d); }
+
+	const QString &clipName() const;
+	const QString &globalClipID() const;
+	int duration() const;
+	EditUnit editUnit() const;
+	const ClipRelation &relation() const;
+	const VideoInfo &videoEssence() const;
+	const QVector<AudioInfo> &audioEssences() const;
+
+	const ClipMetaData &metaData() const;
+
+	bool isNull() const;
+
+private:
+	QSharedDataPointer<ClipData> d;
+};
+
+}
+
+
+Q_DECLARE_TYPEINFO(MXF::AudioInfo, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(MXF::ClipInfo, Q_MOVABLE_TYPE);
+
+#endif // MXFMETA_H
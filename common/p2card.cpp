@@ -0,0 +1,160 @@
+#include "p2card.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+
+namespace MXF
+{
+
+QString cardRoot(const QString &path)
+{
+	QDir dir(path);
+	if (!QFileInfo(dir.absoluteFilePath("CONTENTS")).isDir())
+		dir.cd("..");
+	if (!QFileInfo(dir.absoluteFilePath("CONTENTS")).isDir())
+		return QString();
+	return dir.absolutePath();
+}
+
+QString cardId(const QString &path)
+{
+	return cardRoot(path).split("/").last();
+}
+
+QString Card::contents() const
+{
+	return root + "/CONTENTS/";
+}
+
+const CardFile *Card::find(const QVector<CardFile> &files, const QString &name)
+{
+	for (int i = 0; i < files.size(); ++i)
+		if (files[i].name == name)
+			return &files[i];
+	return 0;
+}
+
+static bool fileNameLessThan(const CardFile &a, const CardFile &b)
+{
+	return a.name < b.name;
+}
+
+static bool cardLessThan(const Card &a, const Card &b)
+{
+	return a.root < b.root;
+}
+
+/** one pass over the entries of folder (relative to parent). Sizes come
+ * from fstatat() on the directory's fd, so nothing resolves a full path
+ * again. Hidden files and everything that is not a regular file are left out */
+static QVector<CardFile> listFiles(int parent, const char *folder, const char *suffix = 0)
+{
+	QVector<CardFile> files;
+	int fd = openat(parent, folder, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return files;
+	DIR *dir = fdopendir(fd);
+	if (!dir)
+	{
+		close(fd);
+		return files;
+	}
+	size_t suffixLength = suffix ? strlen(suffix) : 0;
+	while (struct dirent *e = readdir(dir))
+	{
+		if (e->d_name[0] == '.')
+			continue;
+		if (e->d_type != DT_REG && e->d_type != DT_LNK && e->d_type != DT_UNKNOWN)
+			continue;
+		size_t length = strlen(e->d_name);
+		if (suffixLength && (length < suffixLength
+		                     || strcasecmp(e->d_name + length - suffixLength, suffix) != 0))
+			continue;
+		struct stat st;
+		if (fstatat(dirfd(dir), e->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		CardFile file;
+		file.name = QString::fromLocal8Bit(e->d_name, int(length));
+		file.size = st.st_size;
+		file.modified = qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+		files.append(file);
+	}
+	closedir(dir);
+	std::sort(files.begin(), files.end(), fileNameLessThan);
+	return files;
+}
+
+Card scanCard(const QString &cardRoot)
+{
+	Card card;
+	QByteArray root = QFile::encodeName(QDir(cardRoot).absolutePath());
+	int fd = open(root.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return card;
+	int contents = openat(fd, "CONTENTS", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	close(fd);
+	if (contents < 0)
+		return card;
+	card.root = QFile::decodeName(root);
+	card.id = QFileInfo(card.root).fileName();
+	card.clips = listFiles(contents, "CLIP", ".xml");
+	card.video = listFiles(contents, "VIDEO");
+	card.audio = listFiles(contents, "AUDIO");
+	card.icons = listFiles(contents, "ICON");
+	close(contents);
+	return card;
+}
+
+QList<Card> findCards(const QString &path, int threads)
+{
+	QList<Card> cards;
+	QString root = cardRoot(path);
+	if (!root.isEmpty())
+	{
+		cards.append(scanCard(root));
+		return cards;
+	}
+
+	// list the folder once, then probe every subfolder in parallel
+	QStringList candidates;
+	QString base = QDir(path).absolutePath();
+	DIR *dir = opendir(QFile::encodeName(base).constData());
+	if (!dir)
+		return cards;
+	while (struct dirent *e = readdir(dir))
+	{
+		if (e->d_name[0] == '.')
+			continue;
+		if (e->d_type != DT_DIR && e->d_type != DT_LNK && e->d_type != DT_UNKNOWN)
+			continue;
+		candidates.append(base + "/" + QFile::decodeName(e->d_name));
+	}
+	closedir(dir);
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(qMax(1, threads));
+	QList<QFuture<Card> > scans;
+	foreach(const QString &candidate, candidates)
+		scans.append(QtConcurrent::run(&pool, scanCard, candidate));
+	foreach(const QFuture<Card> &scan, scans)
+	{
+		Card card = scan.result();
+		if (!card.root.isEmpty())
+			cards.append(card);
+	}
+	std::sort(cards.begin(), cards.end(), cardLessThan);
+	return cards;
+}
+
+}
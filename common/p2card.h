@@ -0,0 +1,51 @@
+#ifndef P2CARD_H
+#define P2CARD_H
+#include <QString>
+#include <QVector>
+#include <QList>
+
+namespace MXF {
+
+/** the card folder (the one holding CONTENTS) for path, which may be the
+ * card folder itself or its CONTENTS folder. Empty if path is no card */
+QString cardRoot(const QString &path);
+
+/** name of the card folder, empty if path is no card */
+QString cardId(const QString &path);
+
+struct CardFile
+{
+	QString name;       ///< file name inside its CONTENTS subfolder
+	qint64 size;
+	qint64 modified;    ///< msecs since epoch
+};
+
+/** a card and the files of its CONTENTS subfolders, sorted by name */
+struct Card
+{
+	QString root;       ///< absolute path of the card folder
+	QString id;         ///< name of the card folder
+	QVector<CardFile> clips;  ///< CLIP/*.XML
+	QVector<CardFile> video;  ///< VIDEO
+	QVector<CardFile> audio;  ///< AUDIO
+	QVector<CardFile> icons;  ///< ICON
+
+	/** CONTENTS folder, with trailing '/' */
+	QString contents() const;
+	/** the entry called name in one of the lists above, 0 if there is none */
+	static const CardFile *find(const QVector<CardFile> &files, const QString &name);
+};
+
+/** path is read as a card if it is one (see cardRoot()), otherwise its
+ * direct subfolders that are cards are returned. Each directory is listed
+ * once, candidate folders are probed and scanned on `threads` threads since
+ * on network storage the round trips dominate, not the bandwidth.
+ * Cards come sorted by root. */
+QList<Card> findCards(const QString &path, int threads = 8);
+
+/** scans a single card folder; an empty root in the result means it is none */
+Card scanCard(const QString &cardRoot);
+
+}
+
+#endif // P2CARD_H
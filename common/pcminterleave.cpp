@@ -0,0 +1,233 @@
+#include "pcminterleave.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PCM_INTERLEAVE_X86
+#include <immintrin.h>
+#endif
+
+namespace MXF
+{
+
+/// vector kernels return the number of samples they handled, the rest is
+/// done by the scalar code
+typedef qint64 (*Interleave16Kernel)(const uchar *const *channels, int channelCount,
+                                     qint64 samples, uchar *out);
+
+static void interleaveScalar(const uchar *const *channels, int channelCount,
+                             int bytesPerSample, qint64 first, qint64 samples, uchar *out)
+{
+	const int frameSize = channelCount * bytesPerSample;
+	out += first * frameSize;
+	for (int c = 0; c < channelCount; ++c)
+	{
+		const uchar *in = channels[c] + first * bytesPerSample;
+		uchar *o = out + c * bytesPerSample;
+		switch (bytesPerSample)
+		{
+		case 2:
+			for (qint64 i = first; i < samples; ++i, in += 2, o += frameSize)
+				memcpy(o, in, 2);
+			break;
+		case 3:
+			for (qint64 i = first; i < samples; ++i, in += 3, o += frameSize)
+			{
+				o[0] = in[0];
+				o[1] = in[1];
+				o[2] = in[2];
+			}
+			break;
+		default:
+			for (qint64 i = first; i < samples; ++i, in += bytesPerSample, o += frameSize)
+				memcpy(o, in, bytesPerSample);
+			break;
+		}
+	}
+}
+
+static qint64 interleave16None(const uchar *const *, int, qint64, uchar *)
+{
+	return 0;
+}
+
+#ifdef PCM_INTERLEAVE_X86
+
+/* 8 samples per channel and register. The unpack tree turns the channel
+ * registers into frames: 2 channels give 2 registers of 4 frames, 4 channels
+ * 4 registers of 2 frames, 8 channels 8 registers of 1 frame, in order. */
+static inline void tree16Sse2(const __m128i *v, int channelCount, __m128i *r)
+{
+	__m128i p[8];
+	for (int c = 0; c < channelCount; c += 2)
+	{
+		p[c] = _mm_unpacklo_epi16(v[c], v[c + 1]);
+		p[c + 1] = _mm_unpackhi_epi16(v[c], v[c + 1]);
+	}
+	if (channelCount == 2)
+	{
+		r[0] = p[0];
+		r[1] = p[1];
+		return;
+	}
+	__m128i q[8];
+	for (int c = 0; c < channelCount; c += 4)
+	{
+		q[c] = _mm_unpacklo_epi32(p[c], p[c + 2]);
+		q[c + 1] = _mm_unpackhi_epi32(p[c], p[c + 2]);
+		q[c + 2] = _mm_unpacklo_epi32(p[c + 1], p[c + 3]);
+		q[c + 3] = _mm_unpackhi_epi32(p[c + 1], p[c + 3]);
+	}
+	if (channelCount == 4)
+	{
+		for (int i = 0; i < 4; ++i)
+			r[i] = q[i];
+		return;
+	}
+	for (int i = 0; i < 4; ++i)
+	{
+		r[2 * i] = _mm_unpacklo_epi64(q[i], q[i + 4]);
+		r[2 * i + 1] = _mm_unpackhi_epi64(q[i], q[i + 4]);
+	}
+}
+
+static qint64 interleave16Sse2(const uchar *const *channels, int channelCount,
+                               qint64 samples, uchar *out)
+{
+	if ((channelCount != 2) && (channelCount != 4) && (channelCount != 8))
+		return 0;
+	qint64 i = 0;
+	__m128i v[8];
+	__m128i r[8];
+	for (; i + 8 <= samples; i += 8)
+	{
+		for (int c = 0; c < channelCount; ++c)
+			v[c] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[c] + i * 2));
+		tree16Sse2(v, channelCount, r);
+		for (int k = 0; k < channelCount; ++k, out += 16)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), r[k]);
+	}
+	return i;
+}
+
+#if defined(__GNUC__)
+#define PCM_INTERLEAVE_AVX2
+
+/* the same tree on both 128 bit lanes: lane 0 holds samples 0-7, lane 1
+ * samples 8-15. The lanes are put in order when storing */
+__attribute__((target("avx2")))
+static inline void tree16Avx2(const __m256i *v, int channelCount, __m256i *r)
+{
+	__m256i p[8];
+	for (int c = 0; c < channelCount; c += 2)
+	{
+		p[c] = _mm256_unpacklo_epi16(v[c], v[c + 1]);
+		p[c + 1] = _mm256_unpackhi_epi16(v[c], v[c + 1]);
+	}
+	if (channelCount == 2)
+	{
+		r[0] = p[0];
+		r[1] = p[1];
+		return;
+	}
+	__m256i q[8];
+	for (int c = 0; c < channelCount; c += 4)
+	{
+		q[c] = _mm256_unpacklo_epi32(p[c], p[c + 2]);
+		q[c + 1] = _mm256_unpackhi_epi32(p[c], p[c + 2]);
+		q[c + 2] = _mm256_unpacklo_epi32(p[c + 1], p[c + 3]);
+		q[c + 3] = _mm256_unpackhi_epi32(p[c + 1], p[c + 3]);
+	}
+	if (channelCount == 4)
+	{
+		for (int i = 0; i < 4; ++i)
+			r[i] = q[i];
+		return;
+	}
+	for (int i = 0; i < 4; ++i)
+	{
+		r[2 * i] = _mm256_unpacklo_epi64(q[i], q[i + 4]);
+		r[2 * i + 1] = _mm256_unpackhi_epi64(q[i], q[i + 4]);
+	}
+}
+
+__attribute__((target("avx2")))
+static qint64 interleave16Avx2(const uchar *const *channels, int channelCount,
+                               qint64 samples, uchar *out)
+{
+	if ((channelCount != 2) && (channelCount != 4) && (channelCount != 8))
+		return 0;
+	qint64 i = 0;
+	__m256i v[8];
+	__m256i r[8];
+	for (; i + 16 <= samples; i += 16)
+	{
+		for (int c = 0; c < channelCount; ++c)
+			v[c] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channels[c] + i * 2));
+		tree16Avx2(v, channelCount, r);
+		for (int k = 0; k < channelCount; k += 2, out += 32)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+			                    _mm256_permute2x128_si256(r[k], r[k + 1], 0x20));
+		for (int k = 0; k < channelCount; k += 2, out += 32)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+			                    _mm256_permute2x128_si256(r[k], r[k + 1], 0x31));
+	}
+	// the SSE2 kernel takes another 8 of the up to 15 remaining samples
+	const uchar *rest[8];
+	for (int c = 0; c < channelCount; ++c)
+		rest[c] = channels[c] + i * 2;
+	return i + interleave16Sse2(rest, channelCount, samples - i, out);
+}
+#endif // __GNUC__
+
+#endif // PCM_INTERLEAVE_X86
+
+struct Interleave16
+{
+	Interleave16() : kernel(interleave16None), name("scalar")
+	{
+#ifdef PCM_INTERLEAVE_X86
+		kernel = interleave16Sse2;
+		name = "sse2";
+#ifdef PCM_INTERLEAVE_AVX2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			kernel = interleave16Avx2;
+			name = "avx2";
+		}
+#endif
+#endif
+	}
+	Interleave16Kernel kernel;
+	const char *name;
+};
+
+static const Interleave16 &interleave16()
+{
+	static const Interleave16 k;
+	return k;
+}
+
+void interleavePcm(const uchar *const *channels, int channelCount,
+                   int bytesPerSample, qint64 samples, uchar *out)
+{
+	if ((channelCount <= 0) || (bytesPerSample <= 0) || (samples <= 0))
+		return;
+	if (channelCount == 1)
+	{
+		memcpy(out, channels[0], samples * bytesPerSample);
+		return;
+	}
+	qint64 done = 0;
+	if ((bytesPerSample == 2) && (channelCount <= 8))
+		done = interleave16().kernel(channels, channelCount, samples, out);
+	if (done < samples)
+		interleaveScalar(channels, channelCount, bytesPerSample, done, samples, out);
+}
+
+const char *pcmInterleaveKernel()
+{
+	return interleave16().name;
+}
+
+}
@@ -0,0 +1,24 @@
+#ifndef PCMINTERLEAVE_H
+#define PCMINTERLEAVE_H
+#include <QtGlobal>
+
+namespace MXF {
+
+/**
+ * Interleaves the samples of channelCount mono PCM streams into one
+ * multichannel stream: out receives sample 0 of every channel, then sample 1
+ * and so on. Works for any sample size; 16 bit samples with 2, 4 or 8
+ * channels (the layouts found on P2 cards) use SSE2/AVX2 kernels.
+ *
+ * out has to hold channelCount * bytesPerSample * samples bytes and must not
+ * overlap the input.
+ */
+void interleavePcm(const uchar *const *channels, int channelCount,
+                   int bytesPerSample, qint64 samples, uchar *out);
+
+/** name of the kernel used for 16 bit samples, for benchmarks and logs */
+const char *pcmInterleaveKernel();
+
+}
+
+#endif // PCMINTERLEAVE_H
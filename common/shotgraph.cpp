@@ -0,0 +1,252 @@
+#include "shotgraph.h"
+#include "mxfmeta.h"
+#include "xxhash64.h"
+#include <string.h>
+
+namespace MXF
+{
+
+ClipId::ClipId()
+{
+	memset(words, 0, sizeof(words));
+}
+
+static int hexValue(ushort c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+ClipId ClipId::fromString(const QString &id)
+{
+	ClipId result;
+	if (id.isEmpty())
+		return result;
+	uchar *bytes = reinterpret_cast<uchar *>(result.words);
+	if (id.size() == 64)
+	{
+		int i = 0;
+		for (; i < 32; ++i)
+		{
+			int high = hexValue(id.at(2 * i).unicode());
+			int low = hexValue(id.at(2 * i + 1).unicode());
+			if (high < 0 || low < 0)
+				break;
+			bytes[i] = uchar(high << 4 | low);
+		}
+		if (i == 32)
+			return result;
+	}
+	// not a UMID, still give it a stable 32 byte key
+	QByteArray text = id.toUtf8();
+	for (int i = 0; i < 4; ++i)
+		result.words[i] = XxHash64::hash(reinterpret_cast<const uchar *>(text.constData()), text.size(), i);
+	return result;
+}
+
+QString ClipId::toString() const
+{
+	return QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(words), sizeof(words)).toHex().toUpper());
+}
+
+bool ClipId::isNull() const
+{
+	return !(words[0] | words[1] | words[2] | words[3]);
+}
+
+bool ClipId::operator==(const ClipId &other) const
+{
+	return words[0] == other.words[0] && words[1] == other.words[1]
+	        && words[2] == other.words[2] && words[3] == other.words[3];
+}
+
+quint64 ClipId::hash() const
+{
+	// the UMID label at the start is constant, all that differs sits in
+	// the trailing bytes, so every bit has to reach the low end
+	return XxHash64::hash(reinterpret_cast<const uchar *>(words), sizeof(words));
+}
+
+ClipIdIndex::ClipIdIndex(int expected) :
+    mMask(0),
+    mSize(0)
+{
+	reserve(expected);
+}
+
+void ClipIdIndex::reserve(int expected)
+{
+	// keep the load below one half, probe runs stay short
+	int capacity = 16;
+	while (capacity < expected * 2)
+		capacity *= 2;
+	if (capacity <= mKeys.size())
+		return;
+	QVector<ClipId> keys = mKeys;
+	QVector<int> values = mValues;
+	mKeys = QVector<ClipId>(capacity);
+	mValues = QVector<int>(capacity, -1);
+	mMask = capacity - 1;
+	mSize = 0;
+	for (int i = 0; i < keys.size(); ++i)
+		if (values[i] >= 0)
+			insert(keys[i], values[i]);
+}
+
+int ClipIdIndex::slot(const ClipId &id) const
+{
+	int i = int(id.hash() & quint64(mMask));
+	while (mValues[i] >= 0 && mKeys[i] != id)
+		i = (i + 1) & mMask;
+	return i;
+}
+
+int ClipIdIndex::insert(const ClipId &id, int value)
+{
+	if ((mSize + 1) * 2 > mKeys.size())
+		reserve(mSize + 1);
+	int i = slot(id);
+	if (mValues[i] >= 0)
+		return mValues[i];
+	mKeys[i] = id;
+	mValues[i] = value;
+	mSize++;
+	return -1;
+}
+
+int ClipIdIndex::value(const ClipId &id) const
+{
+	if (mKeys.isEmpty())
+		return -1;
+	return mValues[slot(id)];
+}
+
+int ClipIdIndex::size() const
+{
+	return mSize;
+}
+
+ShotGraph::Links ShotGraph::links(const ClipInfo &clip)
+{
+	Links l;
+	const ClipRelation &relation = clip.relation();
+	l.id = ClipId::fromString(clip.globalClipID());
+	l.top = ClipId::fromString(relation.connectionTop.globalClipId);
+	l.previous = ClipId::fromString(relation.connectionPrevious.globalClipId);
+	l.next = ClipId::fromString(relation.connectionNext.globalClipId);
+	return l;
+}
+
+ShotGraph::ShotGraph(const QVector<Links> &clips) :
+    mIndex(clips.size())
+{
+	const int n = clips.size();
+	QVector<bool> duplicate(n, false);
+	for (int i = 0; i < n; ++i)
+	{
+		if (mIndex.insert(clips[i].id, i) >= 0)
+		{
+			duplicate[i] = true;
+			Problem p = { Problem::Duplicate, i, clips[i].id };
+			mProblems.append(p);
+		}
+	}
+
+	// next[i] is the input index following clip i, -1 at a shot's end
+	QVector<int> next(n, -1);
+	QVector<bool> missingNext(n, false);
+	QVector<int> predecessor(n, -1);
+	for (int i = 0; i < n; ++i)
+	{
+		if (duplicate[i] || clips[i].next.isNull())
+			continue;
+		int j = mIndex.value(clips[i].next);
+		if (j < 0)
+		{
+			missingNext[i] = true;
+			Problem p = { Problem::MissingNext, i, clips[i].next };
+			mProblems.append(p);
+			continue;
+		}
+		if (predecessor[j] >= 0)
+		{
+			// its continuation belongs to another shot, this one ends short
+			missingNext[i] = true;
+			Problem p = { Problem::Fork, j, clips[i].id };
+			mProblems.append(p);
+			continue;
+		}
+		predecessor[j] = i;
+		next[i] = j;
+	}
+
+	QVector<bool> visited(n, false);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			if (duplicate[i] || visited[i])
+				continue;
+			// first pass starts at chain heads, the second picks up loops
+			if (pass == 0 && predecessor[i] >= 0)
+				continue;
+
+			Shot shot;
+			shot.missingStart = false;
+			shot.missingEnd = false;
+			shot.loop = false;
+			const Links &first = clips[i];
+			if (pass == 0)
+			{
+				// a head that expects something before it lost its start
+				ClipId before = !first.previous.isNull() ? first.previous
+				              : (!first.top.isNull() && first.top != first.id) ? first.top : ClipId();
+				if (!before.isNull())
+				{
+					shot.missingStart = true;
+					Problem p = { Problem::MissingPrevious, i, before };
+					mProblems.append(p);
+				}
+			}
+			int c = i;
+			while (c >= 0)
+			{
+				if (visited[c])
+				{
+					shot.loop = true;
+					Problem p = { Problem::Loop, shot.clips.last(), clips[c].id };
+					mProblems.append(p);
+					break;
+				}
+				visited[c] = true;
+				shot.clips.append(c);
+				if (missingNext[c])
+					shot.missingEnd = true;
+				c = next[c];
+			}
+			mShots.append(shot);
+		}
+	}
+}
+
+const QVector<ShotGraph::Shot> &ShotGraph::shots() const
+{
+	return mShots;
+}
+
+const QVector<ShotGraph::Problem> &ShotGraph::problems() const
+{
+	return mProblems;
+}
+
+int ShotGraph::indexOf(const ClipId &id) const
+{
+	return mIndex.value(id);
+}
+
+}
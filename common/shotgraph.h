@@ -0,0 +1,111 @@
+#ifndef SHOTGRAPH_H
+#define SHOTGRAPH_H
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+namespace MXF {
+
+class ClipInfo;
+
+/** a GlobalClipID (a UMID, 64 hex digits in the xml) as 32 raw bytes */
+struct ClipId
+{
+	ClipId();
+	/** ids that are no 64 digit hex string are hashed into the 32 bytes */
+	static ClipId fromString(const QString &id);
+	QString toString() const;
+	bool isNull() const;
+	bool operator==(const ClipId &other) const;
+	bool operator!=(const ClipId &other) const { return !(*this == other); }
+	quint64 hash() const;
+
+	quint64 words[4];
+};
+
+/**
+ * ClipId -> int map with open addressing and linear probing. Keys and
+ * values live in two flat arrays, a lookup is one hash and a few 32 byte
+ * compares. Nothing is ever removed.
+ */
+class ClipIdIndex
+{
+public:
+	explicit ClipIdIndex(int expected = 0);
+	void reserve(int expected);
+	/** stores value for id unless id is known already. returns the value
+	 * stored before, -1 if id was new */
+	int insert(const ClipId &id, int value);
+	/** -1 if id is unknown */
+	int value(const ClipId &id) const;
+	bool contains(const ClipId &id) const { return value(id) >= 0; }
+	int size() const;
+
+private:
+	int slot(const ClipId &id) const;
+
+	QVector<ClipId> mKeys;
+	QVector<int> mValues;   ///< -1 marks an empty slot
+	int mMask;
+	int mSize;
+};
+
+/**
+ * Clips chained into shots by their Top/Previous/Next connections. The
+ * graph is built in one pass over the clips: index all ids, link each
+ * clip to its next, then walk the chains from the clips nobody points to.
+ * Clips still unvisited after that can only sit on a loop.
+ */
+class ShotGraph
+{
+public:
+	struct Shot
+	{
+		QVector<int> clips;     ///< indexes into the input, in playback order
+		bool missingStart;      ///< the first clip has a Previous/Top that is not in the input
+		bool missingEnd;        ///< the last clip has a Next that is not in the input, or is taken by another clip
+		bool loop;              ///< the chain runs into itself
+		bool isComplete() const { return !missingStart && !missingEnd && !loop; }
+	};
+
+	struct Problem
+	{
+		enum Kind {
+			MissingNext,        ///< clip's Next is not in the input
+			MissingPrevious,    ///< clip's Previous (or Top) is not in the input
+			Loop,               ///< clip's Next leads back into its own chain
+			Duplicate,          ///< the same GlobalClipID appears twice, the later one is ignored
+			Fork                ///< two clips name this clip as their Next
+		};
+		Kind kind;
+		int clip;               ///< index into the input
+		ClipId link;            ///< the id that could not be followed
+	};
+
+	/** the ids a clip is known and connected by */
+	struct Links
+	{
+		ClipId id;
+		ClipId top;
+		ClipId previous;
+		ClipId next;
+	};
+	static Links links(const ClipInfo &clip);
+
+	/** builds the graph, shots come in order of their first clip */
+	explicit ShotGraph(const QVector<Links> &clips);
+
+	const QVector<Shot> &shots() const;
+	const QVector<Problem> &problems() const;
+	/** input index of id, -1 if it is not among the clips */
+	int indexOf(const ClipId &id) const;
+
+private:
+	QVector<Shot> mShots;
+	QVector<Problem> mProblems;
+	ClipIdIndex mIndex;
+};
+
+}
+
+#endif // SHOTGRAPH_H
@@ -0,0 +1,150 @@
+#include "xxhash64.h"
+#include <string.h>
+
+namespace MXF
+{
+
+static const quint64 prime1 = 11400714785074694791ULL;
+static const quint64 prime2 = 14029467366897019727ULL;
+static const quint64 prime3 = 1609587929392839161ULL;
+static const quint64 prime4 = 9650029242287828579ULL;
+static const quint64 prime5 = 2870177450012600261ULL;
+
+static inline quint64 rotl(quint64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+// the algorithm is defined on little endian words
+static inline quint64 read64(const uchar *p)
+{
+	quint64 v;
+	memcpy(&v, p, 8);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline quint32 read32(const uchar *p)
+{
+	quint32 v;
+	memcpy(&v, p, 4);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline quint64 accumulate(quint64 acc, quint64 input)
+{
+	acc += input * prime2;
+	acc = rotl(acc, 31);
+	return acc * prime1;
+}
+
+static inline quint64 mergeRound(quint64 acc, quint64 v)
+{
+	acc ^= accumulate(0, v);
+	return acc * prime1 + prime4;
+}
+
+XxHash64::XxHash64(quint64 seed)
+{
+	reset(seed);
+}
+
+void XxHash64::reset(quint64 seed)
+{
+	mSeed = seed;
+	mV[0] = seed + prime1 + prime2;
+	mV[1] = seed + prime2;
+	mV[2] = seed;
+	mV[3] = seed - prime1;
+	mTotal = 0;
+	mBuffered = 0;
+}
+
+void XxHash64::addData(const uchar *data, qint64 size)
+{
+	mTotal += size;
+	if (mBuffered + size < 32)
+	{
+		memcpy(mBuffer + mBuffered, data, size);
+		mBuffered += int(size);
+		return;
+	}
+	const uchar *end = data + size;
+	if (mBuffered)
+	{
+		int fill = 32 - mBuffered;
+		memcpy(mBuffer + mBuffered, data, fill);
+		for (int i = 0; i < 4; ++i)
+			mV[i] = accumulate(mV[i], read64(mBuffer + i * 8));
+		data += fill;
+		mBuffered = 0;
+	}
+	quint64 v0 = mV[0], v1 = mV[1], v2 = mV[2], v3 = mV[3];
+	for (; data + 32 <= end; data += 32)
+	{
+		v0 = accumulate(v0, read64(data));
+		v1 = accumulate(v1, read64(data + 8));
+		v2 = accumulate(v2, read64(data + 16));
+		v3 = accumulate(v3, read64(data + 24));
+	}
+	mV[0] = v0;
+	mV[1] = v1;
+	mV[2] = v2;
+	mV[3] = v3;
+	mBuffered = int(end - data);
+	memcpy(mBuffer, data, mBuffered);
+}
+
+quint64 XxHash64::result() const
+{
+	quint64 h;
+	if (mTotal >= 32)
+	{
+		h = rotl(mV[0], 1) + rotl(mV[1], 7) + rotl(mV[2], 12) + rotl(mV[3], 18);
+		for (int i = 0; i < 4; ++i)
+			h = mergeRound(h, mV[i]);
+	}
+	else
+	{
+		h = mSeed + prime5;
+	}
+	h += mTotal;
+
+	const uchar *p = mBuffer;
+	const uchar *end = mBuffer + mBuffered;
+	for (; p + 8 <= end; p += 8)
+		h = rotl(h ^ accumulate(0, read64(p)), 27) * prime1 + prime4;
+	if (p + 4 <= end)
+	{
+		h = rotl(h ^ (quint64(read32(p)) * prime1), 23) * prime2 + prime3;
+		p += 4;
+	}
+	for (; p < end; ++p)
+		h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+QByteArray XxHash64::hexResult() const
+{
+	return QByteArray::number(result(), 16).rightJustified(16, '0');
+}
+
+quint64 XxHash64::hash(const uchar *data, qint64 size, quint64 seed)
+{
+	XxHash64 h(seed);
+	h.addData(data, size);
+	return h.result();
+}
+
+}
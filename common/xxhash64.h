@@ -0,0 +1,34 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+#include <QtGlobal>
+#include <QByteArray>
+
+namespace MXF {
+
+/**
+ * Streaming XXH64 (as used by MHL files as "xxhash64be"). Fast enough to
+ * run next to a copy at disk speed.
+ */
+class XxHash64
+{
+public:
+	explicit XxHash64(quint64 seed = 0);
+	void reset(quint64 seed = 0);
+	void addData(const uchar *data, qint64 size);
+	quint64 result() const;
+	/** 16 hex digits, most significant first */
+	QByteArray hexResult() const;
+
+	static quint64 hash(const uchar *data, qint64 size, quint64 seed = 0);
+
+private:
+	quint64 mV[4];
+	quint64 mSeed;
+	quint64 mTotal;
+	uchar mBuffer[32];
+	int mBuffered;
+};
+
+}
+
+#endif // XXHASH64_H
@@ -0,0 +1,100 @@
+#include "cardoffload.h"
+#include "filecopier.h"
+#include "hashlist.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QDebug>
+
+OffloadTask::OffloadTask(const QString &cardRoot, const QString &stagingRoot) :
+    mCardRoot(QDir(cardRoot).absolutePath()),
+    mTotalSize(0),
+    mBytesDone(0)
+{
+	// cards of the same name, in different readers, must not share a folder
+	QString id = QFileInfo(mCardRoot).fileName();
+	QByteArray hash = QCryptographicHash::hash(mCardRoot.toUtf8(), QCryptographicHash::Md5).toHex().left(8);
+	mStagedCard = QDir(stagingRoot).absoluteFilePath(id + "_" + QString::fromLatin1(hash) + "/" + id);
+	QDir root(mCardRoot);
+	QDirIterator it(mCardRoot + "/CONTENTS", QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+	while (it.hasNext())
+	{
+		it.next();
+		mFiles.append(root.relativeFilePath(it.filePath()));
+		mTotalSize += it.fileInfo().size();
+	}
+	mFiles.sort();
+}
+
+QString OffloadTask::stagedCard() const
+{
+	return mStagedCard;
+}
+
+QStringList OffloadTask::files() const
+{
+	return mFiles;
+}
+
+qint64 OffloadTask::totalSize() const
+{
+	return mTotalSize;
+}
+
+qint64 OffloadTask::bytesDone() const
+{
+	return mBytesDone.load();
+}
+
+QString OffloadTask::errorString() const
+{
+	return mError;
+}
+
+bool OffloadTask::run()
+{
+	QDateTime start = QDateTime::currentDateTimeUtc();
+	MXF::FileCopier copier;
+	copier.setProgressCounter(&mBytesDone);
+	copier.setCancelFlag(&mCancelled);
+	MXF::HashList list;
+	list.tool = QStringLiteral("mergeMXF");
+	list.source = mCardRoot;
+	list.started = start;
+	foreach(const QString &file, mFiles)
+	{
+		QString source = mCardRoot + "/" + file;
+		QString destination = mStagedCard + "/" + file;
+		if (!QDir().mkpath(QFileInfo(destination).path()))
+		{
+			mError = QStringLiteral("%1: cannot create folder").arg(QFileInfo(destination).path());
+			return false;
+		}
+		if (!copier.copy(source, destination))
+		{
+			mError = copier.errorString();
+			return false;
+		}
+		MXF::HashList::Entry e;
+		e.file = file;
+		e.size = copier.bytesCopied();
+		e.modified = QFileInfo(source).lastModified();
+		e.xxHash64 = copier.xxHash64();
+		e.md5 = copier.md5();
+		e.hashed = QDateTime::currentDateTimeUtc();
+		list.entries.append(e);
+	}
+	list.finished = QDateTime::currentDateTimeUtc();
+
+	// the list lives next to CONTENTS, paths are relative to the card folder
+	QString fileName = QStringLiteral("%1/%2_%3.mhl")
+	        .arg(mStagedCard, QFileInfo(mCardRoot).fileName(),
+	             start.toString(QStringLiteral("yyyy-MM-dd_HHmmss")));
+	if (!list.save(fileName))
+	{
+		mError = list.errorString();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,39 @@
+#ifndef CARDOFFLOAD_H
+#define CARDOFFLOAD_H
+
+#include <QString>
+#include <QStringList>
+#include <QAtomicInteger>
+#include "jobscheduler.h"
+
+/**
+ * Copies the CONTENTS tree of a P2 card into stagingRoot/<card id>_<hash>/<card id>,
+ * the hash taken from the card's path, and writes an MHL file next to it
+ * listing the xxHash64 and MD5 of every file.
+ * Each file is read only once; the hashes are computed while copying.
+ */
+class OffloadTask : public NativeTask
+{
+public:
+	OffloadTask(const QString &cardRoot, const QString &stagingRoot);
+
+	/** where the card ends up */
+	QString stagedCard() const;
+	/** files below CONTENTS, relative to the card root */
+	QStringList files() const;
+	qint64 totalSize() const;
+
+	bool run();
+	QString errorString() const;
+	qint64 bytesDone() const;
+
+private:
+	QString mCardRoot;
+	QString mStagedCard;
+	QStringList mFiles;
+	qint64 mTotalSize;
+	QAtomicInteger<qint64> mBytesDone;
+	QString mError;
+};
+
+#endif // CARDOFFLOAD_H
@@ -0,0 +1,233 @@
+#include "cardverify.h"
+#include "filecopier.h"
+#include "p2card.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QDebug>
+
+/// per worker, two of them. Smaller than for copying, there are more workers
+static const qint64 hashBufferSize = 4 * 1024 * 1024;
+
+static const char *statusName(CardVerifier::Status status)
+{
+	switch (status)
+	{
+	case CardVerifier::Ok:
+		return "OK";
+	case CardVerifier::Mismatch:
+		return "MISMATCH";
+	case CardVerifier::Missing:
+		return "MISSING";
+	case CardVerifier::Unreadable:
+		return "UNREADABLE";
+	case CardVerifier::Extra:
+		return "EXTRA";
+	}
+	return "";
+}
+
+CardVerifier::CardVerifier(const QString &cardRoot) :
+    mCardRoot(MXF::cardRoot(cardRoot)),
+    mWorkers(QThread::idealThreadCount()),
+    mMsecs(0)
+{
+	if (!mCardRoot.isEmpty())
+		mHashListFile = MXF::HashList::find(mCardRoot);
+}
+
+void CardVerifier::setWorkerCount(int count)
+{
+	mWorkers = qMax(1, count);
+}
+
+QString CardVerifier::errorString() const
+{
+	return mError;
+}
+
+QString CardVerifier::cardRoot() const
+{
+	return mCardRoot;
+}
+
+QString CardVerifier::hashListFile() const
+{
+	return mHashListFile;
+}
+
+QList<CardVerifier::FileResult> CardVerifier::results() const
+{
+	return mResults.toList() + mExtra;
+}
+
+int CardVerifier::failures() const
+{
+	int failed = mExtra.size();
+	foreach(const FileResult &r, mResults)
+	{
+		if (r.status != Ok)
+			failed++;
+	}
+	return failed;
+}
+
+qint64 CardVerifier::bytesRead() const
+{
+	qint64 bytes = 0;
+	foreach(const FileResult &r, mResults)
+		bytes += r.size;
+	return bytes;
+}
+
+qint64 CardVerifier::msecs() const
+{
+	return mMsecs;
+}
+
+bool CardVerifier::run()
+{
+	mResults.clear();
+	mExtra.clear();
+	if (mCardRoot.isEmpty())
+	{
+		mError = QStringLiteral("not a card folder");
+		return false;
+	}
+	if (mHashListFile.isEmpty())
+	{
+		mError = QStringLiteral("%1: no hash list (.mhl) found").arg(mCardRoot);
+		return false;
+	}
+	if (!mList.load(mHashListFile))
+	{
+		mError = mList.errorString();
+		return false;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	mResults.resize(mList.entries.size());
+	// the workers take the next unclaimed entry until the list is done, so a
+	// few large files don't leave the other workers idle
+	QThreadPool pool;
+	int workers = qMin(mWorkers, mList.entries.size());
+	pool.setMaxThreadCount(workers);
+	QAtomicInt next(0);
+	for (int i = 0; i < workers; ++i)
+		QtConcurrent::run(&pool, this, &CardVerifier::verifyFiles, &next);
+	pool.waitForDone();
+	mMsecs = timer.elapsed();
+
+	QSet<QString> listed;
+	foreach(const MXF::HashList::Entry &e, mList.entries)
+		listed.insert(QDir::cleanPath(e.file));
+	QDir root(mCardRoot);
+	QStringList extra;
+	QDirIterator it(mCardRoot + "/CONTENTS", QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+	while (it.hasNext())
+	{
+		QString file = root.relativeFilePath(it.next());
+		if (!listed.contains(file))
+			extra.append(file);
+	}
+	extra.sort();
+	foreach(const QString &file, extra)
+	{
+		FileResult r;
+		r.file = file;
+		r.status = Extra;
+		r.detail = QStringLiteral("not in the hash list");
+		mExtra.append(r);
+	}
+	return true;
+}
+
+/** runs on a pool thread */
+void CardVerifier::verifyFiles(QAtomicInt *next)
+{
+	MXF::FileCopier hasher;
+	hasher.setBufferSize(hashBufferSize);
+	FileResult *results = mResults.data();
+	int i;
+	while ((i = next->fetchAndAddRelaxed(1)) < mList.entries.size())
+		results[i] = verifyFile(hasher, mList.entries.at(i));
+}
+
+CardVerifier::FileResult CardVerifier::verifyFile(MXF::FileCopier &hasher,
+                                                  const MXF::HashList::Entry &entry) const
+{
+	FileResult r;
+	r.file = entry.file;
+	QString fileName = mCardRoot + "/" + entry.file;
+	QFileInfo info(fileName);
+	if (!info.isFile())
+	{
+		r.status = Missing;
+		return r;
+	}
+	if ((entry.size >= 0) && (info.size() != entry.size))
+	{
+		r.status = Mismatch;
+		r.detail = QStringLiteral("size %1, listed %2").arg(info.size()).arg(entry.size);
+		return r;
+	}
+	// one hash is enough, xxHash64 is the cheaper one
+	bool xxh = !entry.xxHash64.isEmpty();
+	if (!xxh && entry.md5.isEmpty())
+	{
+		r.status = Unreadable;
+		r.detail = QStringLiteral("no xxHash64 or MD5 listed");
+		return r;
+	}
+	hasher.setHashes(xxh ? MXF::FileCopier::XxHash64Hash : MXF::FileCopier::Md5Hash);
+	bool ok = hasher.hash(fileName);
+	r.size = hasher.bytesCopied();
+	if (!ok)
+	{
+		r.status = Unreadable;
+		r.detail = hasher.errorString();
+		return r;
+	}
+	QByteArray expected = xxh ? entry.xxHash64 : entry.md5;
+	QByteArray actual = xxh ? hasher.xxHash64() : hasher.md5();
+	if (actual != expected)
+	{
+		r.status = Mismatch;
+		r.detail = QStringLiteral("%1 %2, listed %3").arg(xxh ? "xxHash64" : "MD5",
+		                                                  QString::fromLatin1(actual),
+		                                                  QString::fromLatin1(expected));
+	}
+	return r;
+}
+
+void CardVerifier::printReport() const
+{
+	int counts[Extra + 1] = { 0 };
+	foreach(const FileResult &r, results())
+	{
+		counts[r.status]++;
+		if (r.status != Ok)
+			qWarning().noquote() << QStringLiteral("%1: %2").arg(statusName(r.status), r.file)
+			                     << (r.detail.isEmpty() ? QString() : "- " + r.detail);
+	}
+	double seconds = mMsecs / 1000.0;
+	double mb = bytesRead() / (1024.0 * 1024.0);
+	qInfo().noquote() << QStringLiteral("%1: %2 files OK, %3 mismatched, %4 missing, %5 unreadable, %6 extra")
+	                     .arg(MXF::cardId(mCardRoot))
+	                     .arg(counts[Ok])
+	                     .arg(counts[Mismatch])
+	                     .arg(counts[Missing])
+	                     .arg(counts[Unreadable])
+	                     .arg(counts[Extra]);
+	qInfo().noquote() << QStringLiteral("  %1 MB in %2 s (%3 MB/s) on %4 workers")
+	                     .arg(mb, 0, 'f', 0)
+	                     .arg(seconds, 0, 'f', 1)
+	                     .arg(seconds > 0 ? mb / seconds : 0.0, 0, 'f', 1)
+	                     .arg(mWorkers);
+}
@@ -0,0 +1,71 @@
+#ifndef CARDVERIFY_H
+#define CARDVERIFY_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QAtomicInt>
+#include "hashlist.h"
+
+namespace MXF { class FileCopier; }
+
+/**
+ * Checks an offloaded card against the newest MHL file in its card folder.
+ * The listed files are hashed again on a pool of workers (xxHash64 where the
+ * list has it, MD5 otherwise), files below CONTENTS that are not listed are
+ * reported as extra.
+ */
+class CardVerifier
+{
+public:
+	enum Status
+	{
+		Ok,
+		Mismatch,
+		Missing,
+		Unreadable,
+		Extra
+	};
+
+	struct FileResult
+	{
+		FileResult() : status(Ok), size(0) {}
+		QString file;
+		Status status;
+		qint64 size;     ///< bytes hashed
+		QString detail;
+	};
+
+	explicit CardVerifier(const QString &cardRoot);
+
+	void setWorkerCount(int count);
+
+	/** false if there is no card or hash list, see errorString() */
+	bool run();
+	QString errorString() const;
+
+	QString cardRoot() const;
+	QString hashListFile() const;
+	QList<FileResult> results() const;
+	/** files that are not Ok */
+	int failures() const;
+	qint64 bytesRead() const;
+	qint64 msecs() const;
+
+	void printReport() const;
+
+private:
+	void verifyFiles(QAtomicInt *next);
+	FileResult verifyFile(MXF::FileCopier &hasher, const MXF::HashList::Entry &entry) const;
+
+	QString mCardRoot;
+	QString mHashListFile;
+	int mWorkers;
+	MXF::HashList mList;
+	QVector<FileResult> mResults;
+	QList<FileResult> mExtra;
+	qint64 mMsecs;
+	QString mError;
+};
+
+#endif // CARDVERIFY_H
@@ -0,0 +1,160 @@
+#include "cardwatcher.h"
+#include "xxhash64.h"
+#include <QSet>
+#include <QDebug>
+
+/// events come in bursts while a card is mounted or copied
+static const int debounceMsecs = 200;
+
+CardWatcher::CardWatcher(const QString &mountRoot, QObject *parent) :
+    QObject(parent),
+    mRoot(mountRoot)
+{
+	mDebounce.setSingleShot(true);
+	mDebounce.setInterval(debounceMsecs);
+	mSettle.setSingleShot(true);
+	mSettle.setInterval(2000);
+	mPoll.setInterval(10000);
+	connect(&mWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(pathChanged()));
+	connect(&mDebounce, SIGNAL(timeout()), this, SLOT(rescan()));
+	connect(&mSettle, SIGNAL(timeout()), this, SLOT(rescan()));
+	connect(&mPoll, SIGNAL(timeout()), this, SLOT(rescan()));
+}
+
+void CardWatcher::setSettleTime(int msecs)
+{
+	mSettle.setInterval(qMax(0, msecs));
+}
+
+void CardWatcher::setPollInterval(int msecs)
+{
+	mPoll.setInterval(qMax(0, msecs));
+	if (!msecs)
+		mPoll.stop();
+	else if (mPoll.isActive())
+		mPoll.start();
+}
+
+void CardWatcher::start()
+{
+	// what is mounted already has settled
+	foreach(const MXF::Card &card, MXF::findCards(mRoot))
+	{
+		mCards.insert(card.root, card);
+		qInfo().noquote() << "Card found:" << card.id << "(" + card.root + ")";
+		emit cardArrived(card);
+	}
+	updateWatches();
+	if (mPoll.interval())
+		mPoll.start();
+}
+
+QList<MXF::Card> CardWatcher::cards() const
+{
+	return mCards.values();
+}
+
+void CardWatcher::pathChanged()
+{
+	mDebounce.start();
+}
+
+void CardWatcher::rescan()
+{
+	QSet<QString> present;
+	foreach(const MXF::Card &card, MXF::findCards(mRoot))
+	{
+		present.insert(card.root);
+		if (mCards.contains(card.root))
+		{
+			mCards[card.root] = card;
+			continue;
+		}
+		quint64 sig = signature(card);
+		QMap<QString, Pending>::iterator it = mPending.find(card.root);
+		if (it == mPending.end())
+		{
+			Pending p;
+			p.card = card;
+			p.signature = sig;
+			p.since.start();
+			mPending.insert(card.root, p);
+			qInfo().noquote() << "Card mounted:" << card.id << "(" + card.root + "), waiting for it to settle";
+		}
+		else if (it->signature != sig)
+		{
+			it->card = card;
+			it->signature = sig;
+			it->since.start();
+		}
+		else if (it->since.elapsed() >= mSettle.interval())
+		{
+			mPending.erase(it);
+			mCards.insert(card.root, card);
+			qInfo().noquote() << "Card arrived:" << card.id << card.clips.size() << "clips";
+			emit cardArrived(card);
+		}
+	}
+
+	foreach(const QString &root, mPending.keys())
+	{
+		if (!present.contains(root))
+			mPending.remove(root);
+	}
+	foreach(const QString &root, mCards.keys())
+	{
+		if (present.contains(root))
+			continue;
+		MXF::Card card = mCards.take(root);
+		qInfo().noquote() << "Card removed:" << card.id << "(" + root + ")";
+		emit cardRemoved(card);
+	}
+
+	if (!mPending.isEmpty() && !mSettle.isActive())
+		mSettle.start();
+	updateWatches();
+}
+
+/** changes whenever a file is added, grows or is touched */
+quint64 CardWatcher::signature(const MXF::Card &card)
+{
+	MXF::XxHash64 hash;
+	const QVector<MXF::CardFile> *lists[] = { &card.clips, &card.video, &card.audio };
+	for (int i = 0; i < 3; ++i)
+	{
+		foreach(const MXF::CardFile &file, *lists[i])
+		{
+			hash.addData(reinterpret_cast<const uchar *>(file.name.utf16()), file.name.size() * 2);
+			hash.addData(reinterpret_cast<const uchar *>(&file.size), sizeof(file.size));
+			hash.addData(reinterpret_cast<const uchar *>(&file.modified), sizeof(file.modified));
+		}
+	}
+	return hash.result();
+}
+
+/** the root for cards coming and going, each card's root and CLIP folder
+ * for cards being copied or removed */
+void CardWatcher::updateWatches()
+{
+	QSet<QString> wanted;
+	wanted.insert(mRoot);
+	QList<MXF::Card> cards = mCards.values();
+	foreach(const Pending &p, mPending)
+		cards.append(p.card);
+	foreach(const MXF::Card &card, cards)
+	{
+		wanted.insert(card.root);
+		wanted.insert(card.contents() + "CLIP");
+	}
+
+	QStringList obsolete;
+	foreach(const QString &path, mWatcher.directories())
+	{
+		if (!wanted.remove(path))
+			obsolete.append(path);
+	}
+	if (!obsolete.isEmpty())
+		mWatcher.removePaths(obsolete);
+	if (!wanted.isEmpty())
+		mWatcher.addPaths(wanted.toList());
+}
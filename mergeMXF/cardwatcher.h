@@ -0,0 +1,63 @@
+#ifndef CARDWATCHER_H
+#define CARDWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMap>
+#include "p2card.h"
+
+/**
+ * Watches a mount root (e.g. /media/<user>) for P2 cards coming and going.
+ * Changes are picked up through QFileSystemWatcher (inotify on Linux) on
+ * the root and the CONTENTS/CLIP folder of each card, with a slow poll as
+ * fallback for mounts onto existing folders, which inotify does not see.
+ * A new card is reported once two scans in a row find the same files, so
+ * a card that is still being copied into the root is not ingested half way.
+ */
+class CardWatcher : public QObject
+{
+	Q_OBJECT
+public:
+	explicit CardWatcher(const QString &mountRoot, QObject *parent = 0);
+
+	/** time the files of a new card must stay unchanged, default 2 s */
+	void setSettleTime(int msecs);
+	/** interval of the fallback scan, default 10 s, 0 to disable */
+	void setPollInterval(int msecs);
+
+	/** reports the cards present right away and starts watching */
+	void start();
+	/** the cards reported and not removed since */
+	QList<MXF::Card> cards() const;
+
+signals:
+	void cardArrived(const MXF::Card &card);
+	void cardRemoved(const MXF::Card &card);
+
+private slots:
+	void pathChanged();
+	void rescan();
+
+private:
+	struct Pending
+	{
+		MXF::Card card;
+		quint64 signature;
+		QElapsedTimer since;   ///< last change of signature
+	};
+
+	static quint64 signature(const MXF::Card &card);
+	void updateWatches();
+
+	QString mRoot;
+	QFileSystemWatcher mWatcher;
+	QTimer mDebounce;
+	QTimer mSettle;
+	QTimer mPoll;
+	QMap<QString, MXF::Card> mCards;   ///< root -> reported card
+	QMap<QString, Pending> mPending;   ///< root -> card seen, not yet settled
+};
+
+#endif // CARDWATCHER_H
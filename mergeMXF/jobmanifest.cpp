@@ -0,0 +1,138 @@
+#include "jobmanifest.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QDebug>
+
+static const int manifestVersion = 1;
+
+JobManifest::JobManifest(const QString &fileName, QObject *parent) :
+    QObject(parent),
+    mFileName(fileName)
+{
+}
+
+bool JobManifest::load()
+{
+	mJobs = QJsonObject();
+	QFile file(mFileName);
+	if (!file.exists())
+		return true;
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		mError = file.errorString();
+		return false;
+	}
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+	if (error.error != QJsonParseError::NoError)
+	{
+		mError = error.errorString();
+		return false;
+	}
+	if (doc.object().value("version").toInt() != manifestVersion)
+	{
+		mError = QStringLiteral("unknown manifest version");
+		return false;
+	}
+	mJobs = doc.object().value("jobs").toObject();
+	return true;
+}
+
+bool JobManifest::save()
+{
+	QJsonObject root;
+	root.insert("version", manifestVersion);
+	root.insert("jobs", mJobs);
+
+	// written to a temporary file and renamed, an interruption never leaves
+	// a truncated manifest behind
+	QSaveFile file(mFileName);
+	if (!file.open(QIODevice::WriteOnly)
+	        || (file.write(QJsonDocument(root).toJson()) < 0)
+	        || !file.commit())
+	{
+		mError = file.errorString();
+		qWarning().noquote() << mFileName << ":" << mError;
+		return false;
+	}
+	return true;
+}
+
+QString JobManifest::fileName() const
+{
+	return mFileName;
+}
+
+QString JobManifest::errorString() const
+{
+	return mError;
+}
+
+QJsonArray JobManifest::sourceStates(const QStringList &files)
+{
+	QJsonArray sources;
+	foreach(const QString &f, files)
+	{
+		QFileInfo info(f);
+		QJsonObject source;
+		source.insert("file", f);
+		source.insert("size", double(info.size()));
+		source.insert("modified", double(info.lastModified().toMSecsSinceEpoch()));
+		sources.append(source);
+	}
+	return sources;
+}
+
+bool JobManifest::isDone(const ConvertJob &job) const
+{
+	QJsonObject entry = mJobs.value(job.id).toObject();
+	if (entry.value("state").toString() != "done")
+		return false;
+	if (entry.value("output").toString() != job.output)
+		return false;
+	QFileInfo output(job.output);
+	if (!output.exists() || (double(output.size()) != entry.value("outputSize").toDouble()))
+		return false;
+	return entry.value("sources").toArray() == sourceStates(job.sources);
+}
+
+bool JobManifest::discardPartial(const ConvertJob &job)
+{
+	QJsonObject entry = mJobs.value(job.id).toObject();
+	if (entry.isEmpty() || (entry.value("state").toString() == "done"))
+		return true;
+	QString output = entry.value("output").toString();
+	if (output.isEmpty() || !QFile::exists(output))
+		return true;
+	qInfo().noquote() << "Removing partial output" << output;
+	return QFile::remove(output);
+}
+
+void JobManifest::jobStarted(const ConvertJob &job)
+{
+	if (job.id.isEmpty())
+		return;
+	QJsonObject entry;
+	entry.insert("name", job.name);
+	entry.insert("output", job.output);
+	entry.insert("state", QStringLiteral("running"));
+	entry.insert("sources", sourceStates(job.sources));
+	mJobs.insert(job.id, entry);
+	save();
+}
+
+void JobManifest::jobFinished(const JobResult &result)
+{
+	if (result.job.id.isEmpty())
+		return;
+	QJsonObject entry = mJobs.value(result.job.id).toObject();
+	entry.insert("state", result.succeeded() ? QStringLiteral("done") : QStringLiteral("failed"));
+	entry.insert("outputSize", double(QFileInfo(result.job.output).size()));
+	entry.insert("finished", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+	mJobs.insert(result.job.id, entry);
+	save();
+}
@@ -0,0 +1,45 @@
+#ifndef JOBMANIFEST_H
+#define JOBMANIFEST_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QJsonArray>
+#include "jobscheduler.h"
+
+/**
+ * Keeps track of the jobs of an ingest in a JSON file in the output folder,
+ * keyed by ConvertJob::id. A rerun uses it to skip clips that were finished
+ * before and to throw away outputs an interrupted run left behind.
+ */
+class JobManifest : public QObject
+{
+	Q_OBJECT
+public:
+	explicit JobManifest(const QString &fileName, QObject *parent = 0);
+
+	/** a missing file is an empty manifest */
+	bool load();
+	bool save();
+	QString fileName() const;
+	QString errorString() const;
+
+	/** true if the job finished in an earlier run and neither its sources
+	 * nor its output changed since */
+	bool isDone(const ConvertJob &job) const;
+	/** removes the output of a job that was started but did not finish.
+	 * returns false if the output could not be removed */
+	bool discardPartial(const ConvertJob &job);
+
+public slots:
+	void jobStarted(const ConvertJob &job);
+	void jobFinished(const JobResult &result);
+
+private:
+	static QJsonArray sourceStates(const QStringList &files);
+
+	QString mFileName;
+	QString mError;
+	QJsonObject mJobs;
+};
+
+#endif // JOBMANIFEST_H
@@ -0,0 +1,469 @@
+#include "jobscheduler.h"
+#include "blockdevice.h"
+#include <QEventLoop>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QSet>
+
+/// keep only the tail of a job's output, ffmpeg can be very chatty
+static const int maxLogSize = 64 * 1024;
+/// read-ahead started for each source of an external job
+static const qint64 prefetchSize = 32 * 1024 * 1024;
+
+static bool runTask(QSharedPointer<NativeTask> task)
+{
+	return task->run();
+}
+
+static QString exitDescription(const JobResult &r)
+{
+	if (!r.started)
+		return QStringLiteral("failed to start (error %1)").arg(r.error);
+	if (r.exitStatus == QProcess::CrashExit)
+		return QStringLiteral("crashed");
+	return QStringLiteral("exit code %1").arg(r.exitCode);
+}
+
+JobScheduler::JobScheduler(QObject *parent) :
+    QObject(parent),
+    mWorkers(qMax(1, QThread::idealThreadCount())),
+    mOrder(InputOrder),
+    mStreamsPerDevice(2),
+    mTotalMsecs(0),
+    mContinuous(false)
+{
+	mPool.setMaxThreadCount(mWorkers);
+}
+
+void JobScheduler::setWorkerCount(int workers)
+{
+	mWorkers = qMax(1, workers);
+	mPool.setMaxThreadCount(mWorkers);
+}
+
+int JobScheduler::workerCount() const
+{
+	return mWorkers;
+}
+
+void JobScheduler::setOrder(JobScheduler::Order order)
+{
+	mOrder = order;
+}
+
+JobScheduler::Order JobScheduler::order() const
+{
+	return mOrder;
+}
+
+void JobScheduler::setStreamsPerDevice(int streams)
+{
+	mStreamsPerDevice = qMax(0, streams);
+}
+
+int JobScheduler::streamsPerDevice() const
+{
+	return mStreamsPerDevice;
+}
+
+void JobScheduler::addJob(const ConvertJob &job)
+{
+	mQueue.append(job);
+	if (!job.sources.isEmpty())
+		mQueue.last().device = MXF::BlockDevice::idOf(job.sources.first());
+	if (mContinuous)
+		QMetaObject::invokeMethod(this, "startNext", Qt::QueuedConnection);
+}
+
+void JobScheduler::addJobs(const QList<ConvertJob> &jobs)
+{
+	foreach(const ConvertJob &job, jobs)
+		addJob(job);
+}
+
+int JobScheduler::run()
+{
+	if (mQueue.isEmpty())
+		return 0;
+
+	QMap<quint64, int> jobsPerDevice;
+	foreach(const ConvertJob &job, mQueue)
+		jobsPerDevice[job.device]++;
+	qInfo() << "Running" << mQueue.size() << "jobs on" << mWorkers << "workers";
+	for (QMap<quint64, int>::const_iterator it = jobsPerDevice.constBegin(); it != jobsPerDevice.constEnd(); ++it)
+	{
+		if (it.key())
+			qInfo().noquote() << QStringLiteral("  %1: %2 jobs")
+			                     .arg(MXF::BlockDevice::name(it.key())).arg(it.value());
+	}
+	mTotalTime.start();
+
+	QEventLoop loop;
+	connect(this, SIGNAL(allFinished()), &loop, SLOT(quit()));
+	startNext();
+	if (runningCount() || !mQueue.isEmpty())
+		loop.exec();
+	mTotalMsecs = mTotalTime.elapsed();
+
+	int failed = 0;
+	foreach(const JobResult &r, mResults)
+	{
+		if (!r.succeeded())
+			failed++;
+	}
+	return failed;
+}
+
+void JobScheduler::start()
+{
+	mContinuous = true;
+	if (!mTotalTime.isValid())
+		mTotalTime.start();
+	startNext();
+}
+
+int JobScheduler::cancelCard(const QString &card)
+{
+	int cancelled = 0;
+	for (int i = mQueue.size() - 1; i >= 0; --i)
+	{
+		if (mQueue[i].card == card)
+		{
+			mQueue.removeAt(i);
+			cancelled++;
+		}
+	}
+	// finished() follows the kill and reports the job as crashed
+	foreach(QProcess *process, mRunning.keys())
+	{
+		if (mResults[mRunning.value(process)].job.card == card)
+		{
+			process->kill();
+			cancelled++;
+		}
+	}
+	// taskFinished() follows once the task has seen the flag
+	foreach(QFutureWatcher<bool> *watcher, mRunningTasks.keys())
+	{
+		const ConvertJob &job = mResults[mRunningTasks.value(watcher)].job;
+		if (job.card == card)
+		{
+			job.task->cancel();
+			cancelled++;
+		}
+	}
+	return cancelled;
+}
+
+QList<JobResult> JobScheduler::results() const
+{
+	return mResults;
+}
+
+void JobScheduler::printSummary() const
+{
+	int failed = 0;
+	qint64 bytes = 0;
+	foreach(const JobResult &r, mResults)
+	{
+		if (!r.succeeded())
+			failed++;
+		else
+			bytes += r.job.dataSize;
+	}
+	qInfo().noquote() << QStringLiteral("%1 jobs, %2 succeeded, %3 failed in %4 s (%5 MB essence)")
+	                     .arg(mResults.size())
+	                     .arg(mResults.size() - failed)
+	                     .arg(failed)
+	                     .arg(mTotalMsecs / 1000.0, 0, 'f', 1)
+	                     .arg(bytes / (1024 * 1024));
+	foreach(const JobResult &r, mResults)
+	{
+		if (r.succeeded())
+			continue;
+		qWarning().noquote() << "FAILED:" << r.job.name << "-" << exitDescription(r);
+		if (!r.job.task)
+			qWarning().noquote() << " " << r.job.program << r.job.arguments.join(" ");
+		QList<QByteArray> lines = r.log.trimmed().split('\n');
+		for (int i = qMax(0, lines.size() - 5); i < lines.size(); ++i)
+			qWarning().noquote() << "  |" << QString::fromLocal8Bit(lines[i]);
+	}
+}
+
+QList<JobProgress> JobScheduler::progress() const
+{
+	QList<JobProgress> jobs;
+	foreach(const JobResult &r, mResults)
+	{
+		JobProgress p;
+		p.name = r.job.name;
+		p.card = r.job.card;
+		p.dataSize = r.job.dataSize;
+		p.state = r.succeeded() ? JobProgress::Succeeded : JobProgress::Failed;
+		p.bytesDone = r.succeeded() ? r.job.dataSize : 0;
+		p.msecs = r.msecs;
+		jobs.append(p);
+	}
+	for (QMap<QProcess*, int>::const_iterator it = mRunning.constBegin(); it != mRunning.constEnd(); ++it)
+	{
+		JobProgress &p = jobs[it.value()];
+		p.state = JobProgress::Running;
+		p.bytesDone = mProcessBytes.value(it.key(), -1);
+		p.msecs = mTimers.value(it.key()).elapsed();
+	}
+	for (QMap<QFutureWatcher<bool>*, int>::const_iterator it = mRunningTasks.constBegin();
+	     it != mRunningTasks.constEnd(); ++it)
+	{
+		JobProgress &p = jobs[it.value()];
+		p.state = JobProgress::Running;
+		p.bytesDone = mResults[it.value()].job.task->bytesDone();
+		p.msecs = mTaskTimers.value(it.key()).elapsed();
+	}
+	jobs += mFinished;
+	for (int i = 0; i < jobs.size(); ++i)
+	{
+		if ((jobs[i].dataSize > 0) && (jobs[i].bytesDone > jobs[i].dataSize))
+			jobs[i].bytesDone = jobs[i].dataSize;
+	}
+	foreach(const ConvertJob &job, mQueue)
+	{
+		JobProgress p;
+		p.name = job.name;
+		p.card = job.card;
+		p.dataSize = job.dataSize;
+		p.bytesDone = 0;
+		jobs.append(p);
+	}
+	return jobs;
+}
+
+qint64 JobScheduler::elapsed() const
+{
+	return mTotalTime.isValid() ? mTotalTime.elapsed() : 0;
+}
+
+void JobScheduler::startNext()
+{
+	while (runningCount() < mWorkers)
+	{
+		int next = nextJob();
+		if (next < 0)
+			break;
+		JobResult result;
+		result.job = mQueue.takeAt(next);
+		mResults.append(result);
+		mDeviceStreams[result.job.device]++;
+
+		if (result.job.task)
+		{
+			QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+			connect(watcher, SIGNAL(finished()), this, SLOT(taskFinished()));
+			mRunningTasks.insert(watcher, mResults.size() - 1);
+			mTaskTimers[watcher].start();
+			qDebug() << result.job.name << "(native)";
+			emit jobStarted(result.job);
+			watcher->setFuture(QtConcurrent::run(&mPool, runTask, result.job.task));
+			continue;
+		}
+
+		// stdout carries the -progress lines, stderr the log
+		QProcess *process = new QProcess(this);
+		process->setProcessChannelMode(QProcess::SeparateChannels);
+		connect(process, SIGNAL(finished(int,QProcess::ExitStatus)),
+		        this, SLOT(processFinished(int,QProcess::ExitStatus)));
+		connect(process, SIGNAL(errorOccurred(QProcess::ProcessError)),
+		        this, SLOT(processError(QProcess::ProcessError)));
+		connect(process, SIGNAL(readyReadStandardError()), this, SLOT(processOutput()));
+		connect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(processProgress()));
+		mRunning.insert(process, mResults.size() - 1);
+		mTimers[process].start();
+
+		// the native tasks advise the kernel themselves
+		foreach(const QString &source, result.job.sources)
+			MXF::BlockDevice::prefetch(source, prefetchSize);
+		qDebug() << result.job.program << result.job.arguments;
+		emit jobStarted(result.job);
+		process->start(result.job.program, result.job.arguments);
+	}
+	if (!runningCount() && mQueue.isEmpty())
+	{
+		if (mContinuous)
+			mTotalMsecs = mTotalTime.elapsed();
+		emit allFinished();
+	}
+}
+
+void JobScheduler::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+	QProcess *process = qobject_cast<QProcess*>(sender());
+	if (!process || !mRunning.contains(process))
+		return;
+	JobResult &r = mResults[mRunning.value(process)];
+	r.started = true;
+	r.exitCode = exitCode;
+	r.exitStatus = exitStatus;
+	finishJob(process);
+}
+
+void JobScheduler::processError(QProcess::ProcessError error)
+{
+	QProcess *process = qobject_cast<QProcess*>(sender());
+	if (!process || !mRunning.contains(process))
+		return;
+	mResults[mRunning.value(process)].error = error;
+	// everything but a failed start is followed by finished()
+	if (error == QProcess::FailedToStart)
+		finishJob(process);
+}
+
+void JobScheduler::processOutput()
+{
+	QProcess *process = qobject_cast<QProcess*>(sender());
+	if (!process || !mRunning.contains(process))
+		return;
+	QByteArray &log = mResults[mRunning.value(process)].log;
+	log.append(process->readAllStandardError());
+	if (log.size() > maxLogSize)
+		log.remove(0, log.size() - maxLogSize);
+}
+
+/** ffmpeg -progress pipe:1 writes blocks of key=value lines. total_size is
+ * the output size so far, close enough to the essence read for a stream
+ * copy */
+void JobScheduler::processProgress()
+{
+	QProcess *process = qobject_cast<QProcess*>(sender());
+	if (!process || !mRunning.contains(process))
+		return;
+	process->setReadChannel(QProcess::StandardOutput);
+	while (process->canReadLine())
+	{
+		QByteArray line = process->readLine().trimmed();
+		if (!line.startsWith("total_size="))
+			continue;
+		bool ok;
+		qint64 bytes = line.mid(11).toLongLong(&ok);
+		if (ok)
+			mProcessBytes[process] = bytes;
+	}
+}
+
+void JobScheduler::taskFinished()
+{
+	QFutureWatcher<bool> *watcher = static_cast<QFutureWatcher<bool>*>(sender());
+	if (!watcher || !mRunningTasks.contains(watcher))
+		return;
+	int index = mRunningTasks.take(watcher);
+	JobResult &r = mResults[index];
+	r.started = true;
+	r.exitCode = watcher->result() ? 0 : 1;
+	if (r.exitCode)
+		r.log = r.job.task->errorString().toLocal8Bit();
+	watcher->deleteLater();
+	finishJob(index, mTaskTimers.take(watcher).elapsed());
+}
+
+void JobScheduler::finishJob(QProcess *process)
+{
+	int index = mRunning.take(process);
+	mResults[index].log.append(process->readAllStandardError());
+	qint64 msecs = mTimers.take(process).elapsed();
+	mProcessBytes.remove(process);
+	process->deleteLater();
+	finishJob(index, msecs);
+}
+
+void JobScheduler::finishJob(int index, qint64 msecs)
+{
+	JobResult &r = mResults[index];
+	r.msecs = msecs;
+	if (--mDeviceStreams[r.job.device] <= 0)
+		mDeviceStreams.remove(r.job.device);
+	if (r.succeeded())
+		qInfo().noquote() << QStringLiteral("[ok]     %1 (%2 s)")
+		                     .arg(r.job.name).arg(r.msecs / 1000.0, 0, 'f', 1);
+	else
+		qWarning().noquote() << QStringLiteral("[FAILED] %1 (%2)")
+		                        .arg(r.job.name).arg(exitDescription(r));
+	emit jobFinished(r);
+	if (mContinuous)
+		retire(index);
+
+	// don't start the next process from within the signal of the old one
+	QMetaObject::invokeMethod(this, "startNext", Qt::QueuedConnection);
+}
+
+/** a continuous run doesn't keep the results, with their logs, of the jobs
+ * it has finished; a compact entry stays for progress() while the card
+ * has jobs left */
+void JobScheduler::retire(int index)
+{
+	const JobResult &r = mResults.at(index);
+	JobProgress p;
+	p.name = r.job.name;
+	p.card = r.job.card;
+	p.dataSize = r.job.dataSize;
+	p.state = r.succeeded() ? JobProgress::Succeeded : JobProgress::Failed;
+	p.bytesDone = r.succeeded() ? r.job.dataSize : 0;
+	p.msecs = r.msecs;
+	mFinished.append(p);
+	mResults.removeAt(index);
+	for (QMap<QProcess*, int>::iterator it = mRunning.begin(); it != mRunning.end(); ++it)
+	{
+		if (it.value() > index)
+			--it.value();
+	}
+	for (QMap<QFutureWatcher<bool>*, int>::iterator it = mRunningTasks.begin(); it != mRunningTasks.end(); ++it)
+	{
+		if (it.value() > index)
+			--it.value();
+	}
+
+	QSet<QString> busy;
+	foreach(const ConvertJob &job, mQueue)
+		busy.insert(job.card);
+	foreach(const JobResult &result, mResults)
+		busy.insert(result.job.card);
+	for (int i = mFinished.size() - 1; i >= 0; --i)
+	{
+		if (!busy.contains(mFinished.at(i).card))
+			mFinished.removeAt(i);
+	}
+}
+
+int JobScheduler::runningCount() const
+{
+	return mRunning.size() + mRunningTasks.size();
+}
+
+/** index of the queued job to start next, -1 if every device with queued
+ * jobs is busy. Among the devices below the limit the least busy one wins,
+ * between jobs as busy the largest (with LargestFirst) or else the first
+ * in the queue. The queue is ordered here, so jobs added to a running
+ * scheduler are ordered too */
+int JobScheduler::nextJob() const
+{
+	int best = -1;
+	int bestStreams = 0;
+	for (int i = 0; i < mQueue.size(); ++i)
+	{
+		quint64 device = mQueue[i].device;
+		int streams = mDeviceStreams.value(device);
+		// sources that could not be mapped to a disk are not limited
+		if (device && mStreamsPerDevice && (streams >= mStreamsPerDevice))
+			continue;
+		if (!device)
+			streams = 0;
+		if ((best < 0) || (streams < bestStreams)
+		        || ((streams == bestStreams) && (mOrder == LargestFirst)
+		            && (mQueue[i].dataSize > mQueue[best].dataSize)))
+		{
+			best = i;
+			bestStreams = streams;
+		}
+		if (!streams && (mOrder == InputOrder))
+			break;
+	}
+	return best;
+}
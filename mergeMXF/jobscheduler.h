@@ -0,0 +1,170 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QThreadPool>
+
+/** work done in-process instead of by an external program.
+ * run() is called from a pool thread */
+class NativeTask
+{
+public:
+	NativeTask() : mCancelled(0) {}
+	virtual ~NativeTask() {}
+	virtual bool run() = 0;
+	virtual QString errorString() const = 0;
+	/** bytes of the job's dataSize done so far, -1 if unknown.
+	 * Called from the scheduler's thread while run() is going */
+	virtual qint64 bytesDone() const { return -1; }
+	/** asks run() to fail at the next block it reads, from any thread */
+	void cancel() { mCancelled.storeRelease(1); }
+
+protected:
+	QAtomicInt mCancelled;
+};
+
+/** a single external command (or native task) created from one clip */
+struct ConvertJob
+{
+	ConvertJob() : dataSize(0), device(0) {}
+	QString id;          ///< GlobalClipID (GlobalShotID for a merged shot)
+	QString name;        ///< cardId_clipName, used for reporting
+	QString card;        ///< card id, progress is summed up per card
+	QString program;
+	QStringList arguments;
+	QString output;
+	qint64 dataSize;     ///< video + audio essence bytes as given in the clip xml
+	QStringList sources; ///< essence files read by the job
+	quint64 device;      ///< disk the sources are read from, set by JobScheduler
+	QSharedPointer<NativeTask> task;   ///< if set, run instead of program
+};
+
+struct JobResult
+{
+	JobResult() : started(false), exitCode(-1),
+	    exitStatus(QProcess::NormalExit), error(QProcess::UnknownError), msecs(0) {}
+	bool succeeded() const
+	{
+		return started && (exitStatus == QProcess::NormalExit) && (exitCode == 0);
+	}
+	ConvertJob job;
+	bool started;
+	int exitCode;
+	QProcess::ExitStatus exitStatus;
+	QProcess::ProcessError error;
+	qint64 msecs;
+	QByteArray log;      ///< stderr of the process
+};
+
+/** state of a job while the scheduler runs, see JobScheduler::progress() */
+struct JobProgress
+{
+	enum State {
+		Queued,
+		Running,
+		Succeeded,
+		Failed
+	};
+	JobProgress() : state(Queued), dataSize(0), bytesDone(-1), msecs(0) {}
+	QString name;
+	QString card;
+	State state;
+	qint64 dataSize;
+	qint64 bytesDone;    ///< -1 if the job can't tell
+	qint64 msecs;        ///< running time so far
+};
+
+/** runs ConvertJobs through a limited number of concurrent QProcesses
+ * or pool threads. Jobs reading from the same disk are limited separately,
+ * so one card reader isn't kept seeking between several streams while
+ * another one is idle */
+class JobScheduler : public QObject
+{
+	Q_OBJECT
+public:
+	enum Order {
+		InputOrder,     ///< run jobs in the order they were added
+		LargestFirst    ///< start the jobs with the largest dataSize first
+	};
+
+	explicit JobScheduler(QObject *parent = 0);
+
+	void setWorkerCount(int workers);
+	int workerCount() const;
+	void setOrder(Order order);
+	Order order() const;
+	/** concurrent jobs per source disk, 0 for no limit */
+	void setStreamsPerDevice(int streams);
+	int streamsPerDevice() const;
+
+	void addJob(const ConvertJob &job);
+	void addJobs(const QList<ConvertJob> &jobs);
+
+	/** runs all queued jobs and blocks until they are done.
+	 * returns the number of failed jobs */
+	int run();
+	/** starts the queued jobs without blocking. Jobs added later are
+	 * started as workers become free, allFinished() is emitted each time
+	 * the queue runs dry */
+	void start();
+	/** drops the queued jobs of card, kills its running processes and
+	 * cancels its native tasks. Returns the number of jobs dropped, killed
+	 * or cancelled */
+	int cancelCard(const QString &card);
+
+	QList<JobResult> results() const;
+	void printSummary() const;
+	/** all jobs of the current run: finished, running and queued. After
+	 * start(), finished jobs are only listed while their card has jobs
+	 * left */
+	QList<JobProgress> progress() const;
+	/** time since run() was called */
+	qint64 elapsed() const;
+
+signals:
+	void jobStarted(const ConvertJob &job);
+	void jobFinished(const JobResult &result);
+	void allFinished();
+
+private slots:
+	void processFinished(int exitCode, QProcess::ExitStatus exitStatus);
+	void processError(QProcess::ProcessError error);
+	void processOutput();
+	void processProgress();
+	void taskFinished();
+	void startNext();
+
+private:
+	void finishJob(QProcess *process);
+	void finishJob(int index, qint64 msecs);
+	void retire(int index);
+	int runningCount() const;
+	int nextJob() const;
+
+	int mWorkers;
+	Order mOrder;
+	int mStreamsPerDevice;
+	QMap<quint64, int> mDeviceStreams;  ///< device -> running jobs
+	QList<ConvertJob> mQueue;
+	QList<JobResult> mResults;        ///< after start() only those not finished yet
+	QList<JobProgress> mFinished;     ///< after start(): finished jobs of busy cards
+	QMap<QProcess*, int> mRunning;     ///< process -> index in mResults
+	QMap<QProcess*, QElapsedTimer> mTimers;
+	QMap<QProcess*, qint64> mProcessBytes;  ///< from ffmpeg's -progress output
+	QMap<QFutureWatcher<bool>*, int> mRunningTasks;
+	QMap<QFutureWatcher<bool>*, QElapsedTimer> mTaskTimers;
+	QThreadPool mPool;                 ///< native tasks, sized to mWorkers
+	QElapsedTimer mTotalTime;
+	qint64 mTotalMsecs;
+	bool mContinuous;
+};
+
+#endif // JOBSCHEDULER_H
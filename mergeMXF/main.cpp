@@ -1,151 +1,291 @@
 #include "wndmain.h"
-#include <QApplication>
-#include <QXmlStreamReader>
+#include "jobscheduler.h"
+#include "op1awriter.h"
+#include "jobmanifest.h"
+#include "cardoffload.h"
+#include "cardverify.h"
+#include "progressreporter.h"
+#include "p2card.h"
+#include "mxfmeta.h"
+#include "shotgraph.h"
+#include "cardwatcher.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
 #include <QFile>
 #include <QDebug>
 #include <QDir>
 #include <QProcess>
+#include <QSet>
+#include <QThread>
+#include <cstdio>
 namespace MXF {
 
-struct VideoInfo
-{
-	QString Filename;
-	QString VideoFormat;
-	QString FrameRate;
-	QString StartTimecode;
-};
-
-struct AudioInfo {
-	QString AudioFormat;
-};
-
+/** a clip of a card: its clip xml and the essence files it refers to */
 struct Info {
-	QString clipName;
-	QString GlobalClipID;
-	int duration;
-	struct {
-		float numerator;
-		float denominator;
-	} EditUnit;
-	VideoInfo Video;
-	QVector<QString> AudioChannel;
-	QString ThumbnailFile;
+	QString CardId;
+	QString FileRoot;       ///< CONTENTS folder of the card, with trailing '/'
+	ClipInfo clip;
+	QString videoFile;      ///< in FileRoot/VIDEO
+	QStringList audioFiles; ///< in FileRoot/AUDIO, one per channel
 };
 
 }
 
-bool parseMeta(QByteArray data, MXF::Info & mxf) {
-	int audioTrack = 0;
-	QXmlStreamReader xml;
-	xml.addData(data);
-	int depth=0;
-	QStringList path;
-	path.append("");
-	while((!xml.atEnd())&&(!xml.error())) {
-		xml.readNext();
-		QString xpath;
-		if (xml.error()) {
-			//qDebug()<< trUtf8("XML error: %1").arg(xml.errorString());
-			break;
-		}
-		if (xml.isStartElement()) {
-			path.append(xml.name().toString());
-			depth++;
-			continue;
-		}
-		if (xml.isEndElement()) {
-			path.removeLast();
-			depth--;
-			continue;
-		}
-		xpath = path.join("/");
-		if (xpath == "/P2Main/ClipContent/ClipName")
-			mxf.clipName = xml.text().toString();
-		if (xpath == "/P2Main/ClipContent/GlobalClipId")
-			mxf.GlobalClipID = xml.text().toString();
-		if (xpath == "/P2Main/ClipContent/Duration")
-			mxf.duration = xml.text().toString().toInt();
-		if (xpath == "/P2Main/ClipContent/EditUnit")
-		{
-			QString eu = xml.text().toString();
-			QStringList units = eu.split('/');
-			mxf.EditUnit.numerator = units.first().toFloat();
-			mxf.EditUnit.denominator = (units.count()>1)?units.last().toFloat():1;
-		}
+/** frames per second as counted by the timecode, e.g. 30 for 29.97 */
+int timecodeBase(const MXF::ClipInfo &clip)
+{
+	int rateNumerator = qRound(clip.editUnit().denominator);
+	int rateDenominator = qRound(clip.editUnit().numerator);
+	return (rateDenominator > 0) ? (rateNumerator + rateDenominator - 1) / rateDenominator : 0;
+}
 
-		//skip relation for now except media serial
-		//<P2SerialNo.>ABD06C0058</P2SerialNo.>
+/** native rewrap of one or more consecutive clips into one OP1a file.
+ * timecode, name and package id are taken from the first clip.
+ * firstFrame and frameCount cut a range out of the joined clips; the frames
+ * are found by their index entries, so only the range is read */
+ConvertJob rewrapJob(const QList<MXF::Info> &clips, const QString &output, bool multichannelAudio,
+                     qint64 firstFrame = 0, qint64 frameCount = -1)
+{
+	const MXF::ClipInfo &first = clips.first().clip;
+	// EditUnit is the duration of a frame, e.g. 1001/30000
+	int rateNumerator = qRound(first.editUnit().denominator);
+	int rateDenominator = qRound(first.editUnit().numerator);
+	QSharedPointer<RewrapTask> task(new RewrapTask(output));
+	Op1aWriter &writer = task->writer();
+	writer.setEditRate(rateNumerator, rateDenominator);
+	if (rateDenominator > 0)
+	{
+		MXF::timeCode start = first.videoEssence().startTimecode();
+		writer.setStartTimecode(start.frameCount(timecodeBase(first)) + firstFrame, start.dropFrame);
+	}
+	QString packageId = (clips.size() > 1) ? first.relation().globalShotId : first.globalClipID();
+	writer.setSourcePackageId(QByteArray::fromHex(packageId.toLatin1()));
+	writer.setName(first.clipName());
+	writer.setInterleavedAudio(multichannelAudio);
 
-		if (xpath == "/P2Main/ClipContent/EssenceList/Video/VideoFormat")
-			mxf.Video.Filename = xml.text().toString();
+	ConvertJob job;
+	job.id = packageId;
+	job.name = clips.first().CardId + "_" + first.clipName();
+	job.card = clips.first().CardId;
+	job.program = QCoreApplication::applicationName();
+	job.arguments << "--rewrap";
+	if (firstFrame || (frameCount >= 0))
+	{
+		// a subclip is a job of its own for the manifest
+		job.id += QStringLiteral(":%1+%2").arg(firstFrame).arg(frameCount);
+		job.name += QStringLiteral(" [%1+%2]").arg(firstFrame).arg(frameCount);
+		job.arguments << "--in" << QString::number(firstFrame);
+		if (frameCount >= 0)
+			job.arguments << "--out" << QString::number(firstFrame + frameCount);
+	}
+	qint64 clipStart = 0;
+	qint64 end = (frameCount >= 0) ? firstFrame + frameCount : -1;
+	foreach(const MXF::Info &info, clips)
+	{
+		qint64 duration = info.clip.duration();
+		qint64 from = qMax<qint64>(0, firstFrame - clipStart);
+		qint64 to = (end >= 0) ? qMin(duration, end - clipStart) : duration;
+		clipStart += duration;
+		if ((to <= from) && (duration > 0))
+			continue;
 
-		if (xpath == "/P2Main/ClipContent/EssenceList/Audio/AudioFormat")
-		{
-			QString audioName;
-			audioName.sprintf("%02x.", audioTrack++);
-			audioName += xml.text().toString();
-			mxf.AudioChannel.append(audioName);
-		}
+		RewrapSegment segment;
+		segment.videoFile = info.FileRoot + "VIDEO/" + info.videoFile;
+		foreach(const QString &channel, info.audioFiles)
+			segment.audioFiles.append(info.FileRoot + "AUDIO/" + channel);
+		segment.firstFrame = from;
+		if (to < duration)
+			segment.frameCount = to - from;
+		writer.addSegment(segment);
+		job.arguments << segment.videoFile << segment.audioFiles;
+		job.sources << segment.videoFile << segment.audioFiles;
 
-		if (xpath =="/P2Main/ClipContent/ClipMetadata/Thumbnail/ThumbnailFormat")
-			mxf.ThumbnailFile = xml.text().toString();
+		qint64 bytes = info.clip.videoEssence().VideoIndex().dataSize;
+		foreach(const MXF::AudioInfo &audio, info.clip.audioEssences())
+			bytes += audio.audioIndex().dataSize;
+		// the essence is about the same size per frame
+		job.dataSize += (duration > 0) ? bytes * (to - from) / duration : bytes;
+	}
+	job.output = output;
+	job.task = task;
+	return job;
+}
 
-		//qDebug()<<path.join("/")<<xml.text();
+/** an in or out point given on the command line: a timecode or a frame
+ * number counted from the start of the clip */
+struct FramePosition
+{
+	FramePosition() : frame(-1), isTimecode(false) {}
+	bool isNull() const { return !isTimecode && (frame < 0); }
+	/** frame within clips starting at startTimecode */
+	qint64 frameIn(const MXF::ClipInfo &clip) const
+	{
+		if (!isTimecode)
+			return frame;
+		int base = timecodeBase(clip);
+		MXF::timeCode start = clip.videoEssence().startTimecode();
+		// counted like the clip's own timecode
+		MXF::timeCode position = timecode;
+		position.dropFrame = position.dropFrame || start.dropFrame;
+		return position.frameCount(base) - start.frameCount(base);
 	}
-	if (xml.error()) {
-		//QDebug()<< trUtf8("XML parser error: %1").arg(xml.errorString());
+
+	qint64 frame;
+	MXF::timeCode timecode;
+	bool isTimecode;
+};
+
+/** "hh:mm:ss:ff" or a frame number. Timecodes of drop frame clips, whose
+ * start timecode has ';' before the frames, count with drop either way;
+ * ';' makes a timecode drop frame for any clip */
+bool parsePosition(const QString &text, FramePosition *position)
+{
+	bool ok;
+	position->frame = text.toLongLong(&ok);
+	if (ok)
+		return position->frame >= 0;
+	bool dropFrame = text.contains(';');
+	QStringList parts = QString(text).replace(';', ':').split(':');
+	if (parts.size() != 4)
 		return false;
-	}else{
-		mxf.Video.Filename.prepend(mxf.clipName+".");
-		mxf.ThumbnailFile.prepend(mxf.clipName+".");
-		for (int i=0;i<audioTrack;++i)
-			mxf.AudioChannel[i].prepend(mxf.clipName);
-		return true;
+	int values[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		values[i] = parts[i].toInt(&ok);
+		if (!ok || (values[i] < 0))
+			return false;
+	}
+	position->timecode = MXF::timeCode(values[0], values[1], values[2], values[3], dropFrame);
+	position->isTimecode = true;
+	return true;
+}
+
+/** one subclip job per clip or shot that has frames between in and out
+ * (out is exclusive, a null position is the start or end of the clip) */
+QList<ConvertJob> subclipCmds(const QList<QList<MXF::Info> > &shots, const QString &outputPath,
+                              const FramePosition &in, const FramePosition &out, bool multichannelAudio)
+{
+	QList<ConvertJob> cmdList;
+	foreach(const QList<MXF::Info> &shot, shots)
+	{
+		const MXF::Info &first = shot.first();
+		qint64 duration = 0;
+		foreach(const MXF::Info &info, shot)
+			duration += info.clip.duration();
+		qint64 from = in.isNull() ? 0 : qMax<qint64>(0, in.frameIn(first.clip));
+		qint64 to = out.isNull() ? duration : qMin(duration, out.frameIn(first.clip));
+		if (to <= from)
+			continue;
+		QString output = QStringLiteral("%1%2_%3_%4-%5.mxf").arg(outputPath, first.CardId, first.clip.clipName())
+		                 .arg(from).arg(to);
+		cmdList.append(rewrapJob(shot, output, multichannelAudio, from, to - from));
 	}
+	return cmdList;
+}
 
+/** copies the cards to stagingPath through offloader and replaces them by
+ * the staged copies. returns false if an offload failed */
+bool offloadCards(QList<MXF::Card> &cards, const QString &stagingPath, JobScheduler &offloader)
+{
+	QStringList staged;
+	foreach(const MXF::Card &card, cards)
+	{
+		QSharedPointer<OffloadTask> task(new OffloadTask(card.root, stagingPath));
+		ConvertJob job;
+		job.name = card.id + " (offload)";
+		job.card = card.id;
+		job.program = QCoreApplication::applicationName();
+		job.arguments << "--offload" << stagingPath << card.root;
+		job.output = task->stagedCard();
+		foreach(const QString &file, task->files())
+			job.sources.append(card.root + "/" + file);
+		job.dataSize = task->totalSize();
+		job.task = task;
+		offloader.addJob(job);
+		staged.append(task->stagedCard());
+	}
+	int failed = offloader.run();
+	offloader.printSummary();
+	cards.clear();
+	foreach(const QString &card, staged)
+		cards.append(MXF::scanCard(card));
+	return failed == 0;
 }
 
-QStringList convertFolderCmds(QString cardRoot, QString outputPath, int maxAudio = 1)
+/** reads the clip xml files of a card */
+QList<MXF::Info> readClips(const MXF::Card &card)
 {
-	QDir dir(cardRoot);
-	QStringList cmdList;
-	if (!dir.entryList().contains("CONTENTS"))
-		dir.cd("..");
-	cardRoot = dir.absolutePath();
-	if (!dir.entryList().contains("CONTENTS"))
-		return QStringList();
-	QString cardId = dir.absolutePath().split("/").last();
-	QString fileRoot = cardRoot + "/CONTENTS/";
-	dir.setPath(cardRoot+"/CONTENTS/CLIP");
-	dir.setNameFilters(QStringList()<<"*.xml"<<"*.XML");
-	qDebug()<<dir.absolutePath()<<dir;
-	foreach(QFileInfo file, dir.entryInfoList())
-	{
-		QString fileName = file.filePath();
+	QList<MXF::Info> clips;
+	QString fileRoot = card.contents();
+	qDebug() << card.root << card.clips.size() << "clips";
+	foreach(const MXF::CardFile &file, card.clips)
+	{
+		QString fileName = fileRoot + "CLIP/" + file.name;
 		QFile mxf(fileName);
 		if (!mxf.open(QFile::ReadOnly))
 			continue;
 
-		QByteArray xmlData = mxf.readAll();
 		MXF::Info info;
-		parseMeta(xmlData, info);
+		info.clip = MXF::ClipInfo(mxf.readAll());
+		if (info.clip.isNull())
+			qWarning() << fileName << "could not be parsed";
+		info.CardId = card.id;
+		info.FileRoot = fileRoot;
+		// the essence files are named after the clip
+		QString clipName = info.clip.clipName();
+		info.videoFile = clipName + "." + info.clip.videoEssence().videoFormat();
+		const QVector<MXF::AudioInfo> &audio = info.clip.audioEssences();
+		for (int i = 0; i < audio.size(); ++i)
+			info.audioFiles.append(clipName + QString().sprintf("%02x.", i) + audio[i].audioFormat());
+		if (!MXF::Card::find(card.video, info.videoFile))
+			qWarning() << fileName << ": no" << info.videoFile << "in VIDEO";
+		clips.append(info);
+	}
+	return clips;
+}
+
+QList<ConvertJob> convertFolderCmds(const QList<MXF::Info> &clips, QString outputPath,
+                                    bool rewrap = false, bool multichannelAudio = false, int maxAudio = 0)
+{
+	QList<ConvertJob> cmdList;
+	foreach(const MXF::Info &info, clips)
+	{
+		QString output = outputPath + info.CardId + "_" + info.clip.clipName();
+		//qDebug() << info.videoFile << info.audioFiles;
+		if (rewrap)
+		{
+			cmdList.append(rewrapJob(QList<MXF::Info>() << info, output + ".mxf", multichannelAudio));
+			continue;
+		}
+		QString fileRoot = info.FileRoot;
 
-		//qDebug() << info.Video.Filename << info.AudioChannel;
+		ConvertJob job;
 		QStringList arguments;
 		//arguments.append("ffmpeg");
+		//never wait for an answer on stdin, several jobs may be running
+		arguments.append("-nostdin");
+		//the manifest decides what is redone, leftovers are overwritten
+		arguments.append("-y");
+		//machine readable progress on stdout, the scheduler parses it
+		arguments.append("-progress");
+		arguments.append("pipe:1");
+		arguments.append("-nostats");
 		arguments.append("-i");
 
-		arguments.append(fileRoot + "VIDEO/" + info.Video.Filename);
+		arguments.append(fileRoot + "VIDEO/" + info.videoFile);
+		job.sources.append(fileRoot + "VIDEO/" + info.videoFile);
 
 		//audio mapping
 		int nAudioChans = (maxAudio>0)?
-						 qMin(info.AudioChannel.count(),maxAudio)
-						:info.AudioChannel.count();
+						 qMin(info.audioFiles.count(),maxAudio)
+						:info.audioFiles.count();
 
 		for (int chan = 0; chan < nAudioChans; ++chan)
 		{
 			arguments.append("-i");
-			arguments.append(fileRoot + "AUDIO/" + info.AudioChannel[chan]);
+			arguments.append(fileRoot + "AUDIO/" + info.audioFiles[chan]);
+			job.sources.append(fileRoot + "AUDIO/" + info.audioFiles[chan]);
 		}
 
 		//codec
@@ -159,71 +299,625 @@ QStringList convertFolderCmds(QString cardRoot, QString outputPath, int maxAudio
 		arguments.append("0:v");
 		for (int audioId=0; audioId < nAudioChans; ++audioId)
 		{
+			//every channel is a separate mono input after the video
 			QString mapping;
-			mapping.sprintf("1:a");//, audioId+1, audioId);
+			mapping.sprintf("%d:a", audioId+1);
 			arguments.append("-map");
 			arguments.append(mapping);
 		}
-		QString output = outputPath + cardId+"_"+info.clipName + ".avi";
+		output += ".avi";
 		arguments.append(output);
 
-		//mapping
-		cmdList.append(arguments.join(" "));
+		job.id = info.clip.globalClipID();
+		job.name = info.CardId + "_" + info.clip.clipName();
+		job.card = info.CardId;
+		job.program = "ffmpeg";
+		job.arguments = arguments;
+		job.output = output;
+		job.dataSize = info.clip.videoEssence().VideoIndex().dataSize;
+		const QVector<MXF::AudioInfo> &audio = info.clip.audioEssences();
+		for (int chan = 0; chan < qMin(nAudioChans, audio.count()); ++chan)
+			job.dataSize += audio[chan].audioIndex().dataSize;
+		cmdList.append(job);
 
 	}
 
 	return cmdList;
 }
 
+static QString describeClip(const MXF::ClipConnection &c)
+{
+	if (c.p2SerialNo.isEmpty())
+		return c.clipName;
+	return QStringLiteral("%1 (card %2)").arg(c.clipName, c.p2SerialNo);
+}
+
+/**
+ * Groups clips into shots by following the Top/Previous/Next connections,
+ * in the order of the clips' cards. A clip spanned over several cards only
+ * shows up once all of its cards are given, missing links are appended to
+ * errors and the shot is left out.
+ */
+QList<QList<MXF::Info> > resolveShots(const QList<MXF::Info> &clips, QStringList *errors)
+{
+	QVector<MXF::ShotGraph::Links> links;
+	links.reserve(clips.size());
+	foreach(const MXF::Info &info, clips)
+		links.append(MXF::ShotGraph::links(info.clip));
+	MXF::ShotGraph graph(links);
+
+	foreach(const MXF::ShotGraph::Problem &p, graph.problems())
+	{
+		const MXF::ClipInfo &clip = clips.at(p.clip).clip;
+		const MXF::ClipRelation &relation = clip.relation();
+		switch (p.kind)
+		{
+		case MXF::ShotGraph::Problem::MissingNext:
+			errors->append(QStringLiteral("%1: the following clip %2 is missing")
+			               .arg(clip.clipName(), describeClip(relation.connectionNext)));
+			break;
+		case MXF::ShotGraph::Problem::MissingPrevious:
+			errors->append(QStringLiteral("%1: the preceding clip %2 is missing")
+			               .arg(clip.clipName(), describeClip(relation.connectionPrevious.isSet()
+			                                                  ? relation.connectionPrevious
+			                                                  : relation.connectionTop)));
+			break;
+		case MXF::ShotGraph::Problem::Loop:
+			errors->append(QStringLiteral("%1: connection loop back to clip %2")
+			               .arg(clip.clipName(), clips.at(graph.indexOf(p.link)).clip.clipName()));
+			break;
+		case MXF::ShotGraph::Problem::Duplicate:
+			errors->append(QStringLiteral("%1: clip id %2 is given twice (card %3)")
+			               .arg(clip.clipName(), clip.globalClipID(), clips.at(p.clip).CardId));
+			break;
+		case MXF::ShotGraph::Problem::Fork:
+			errors->append(QStringLiteral("%1: named as next clip by more than one clip")
+			               .arg(clip.clipName()));
+			break;
+		}
+	}
+
+	QList<QList<MXF::Info> > shots;
+	foreach(const MXF::ShotGraph::Shot &shot, graph.shots())
+	{
+		if (!shot.isComplete())
+			continue;
+		QList<MXF::Info> infos;
+		foreach(int i, shot.clips)
+			infos.append(clips.at(i));
+		shots.append(infos);
+	}
+	return shots;
+}
+
+/** what --watch does with each card */
+struct WatchOptions
+{
+	QString outPath;
+	QString stagingPath;   ///< offload first if set
+	QString cuesheet;      ///< p2_cuesheet binary, empty for no cue sheet
+	bool offloadOnly;      ///< stop after the offload
+	bool shots;
+	bool rewrap;
+	bool multichannelAudio;
+	bool restart;
+	FramePosition inPoint;  ///< subclips if either is set
+	FramePosition outPoint;
+	QStringList clipNames;  ///< only these clips (or shots), all if empty
+};
+
+/**
+ * Runs until killed: every card showing up below root is queued on the
+ * running scheduler right away, so one card is read while the jobs of the
+ * one before are still writing. With --shots a shot is queued as soon as
+ * all of its cards have been seen. If a card is pulled, its queued jobs are
+ * dropped, its processes killed and the outputs of the failed jobs removed;
+ * the card is ingested again when it comes back.
+ */
+int watchCards(const QString &root, const WatchOptions &options,
+               JobScheduler &scheduler, JobManifest &manifest)
+{
+	CardWatcher watcher(root);
+	QList<MXF::Info> shotClips;      ///< clips of all cards seen, for --shots
+	QSet<QString> queuedShots;
+	QMap<QString, QString> offloads; ///< staged copy -> card root, while the offload runs
+
+	auto queueJobs = [&](const QList<ConvertJob> &jobs) {
+		int skipped = 0;
+		foreach(const ConvertJob &job, jobs)
+		{
+			if (!options.restart && manifest.isDone(job))
+			{
+				skipped++;
+				continue;
+			}
+			if (!manifest.discardPartial(job))
+			{
+				qWarning().noquote() << "Cannot remove partial output of" << job.name << ", left out";
+				continue;
+			}
+			scheduler.addJob(job);
+		}
+		if (skipped)
+			qInfo() << "Skipping" << skipped << "jobs finished by an earlier run";
+	};
+
+	const bool subclip = !options.inPoint.isNull() || !options.outPoint.isNull();
+	auto convert = [&](const MXF::Card &card) {
+		QList<MXF::Info> clips = readClips(card);
+		QList<QList<MXF::Info> > shotList;
+		QStringList errors;
+		if (options.shots)
+		{
+			shotClips.append(clips);
+			shotList = resolveShots(shotClips, &errors);
+		}
+		else
+		{
+			foreach(const MXF::Info &info, clips)
+				shotList.append(QList<MXF::Info>() << info);
+		}
+		for (int i = shotList.size() - 1; i >= 0; --i)
+		{
+			if (!options.clipNames.isEmpty()
+			        && !options.clipNames.contains(shotList[i].first().clip.clipName(), Qt::CaseInsensitive))
+				shotList.removeAt(i);
+		}
+
+		QList<ConvertJob> jobs;
+		if (subclip)
+			jobs = subclipCmds(shotList, options.outPath, options.inPoint, options.outPoint, options.multichannelAudio);
+		else if (options.shots)
+		{
+			foreach(const QList<MXF::Info> &shot, shotList)
+			{
+				const MXF::Info &first = shot.first();
+				jobs.append(rewrapJob(shot, options.outPath + first.CardId + "_" + first.clip.clipName() + ".mxf",
+				                      options.multichannelAudio));
+			}
+		}
+		else
+		{
+			clips.clear();
+			foreach(const QList<MXF::Info> &shot, shotList)
+				clips.append(shot.first());
+			jobs = convertFolderCmds(clips, options.outPath, options.rewrap, options.multichannelAudio);
+		}
+		// resolveShots() returns the shots of the earlier cards again
+		for (int i = jobs.size() - 1; options.shots && (i >= 0); --i)
+		{
+			if (queuedShots.contains(jobs[i].id))
+				jobs.removeAt(i);
+			else
+				queuedShots.insert(jobs[i].id);
+		}
+		foreach(const QString &e, errors)
+			qDebug().noquote() << "Incomplete shot:" << e;
+		if (!errors.isEmpty())
+			qInfo() << errors.size() << "clip connections wait for further cards";
+		queueJobs(jobs);
+	};
+
+	auto cuesheet = [&](const MXF::Card &card) {
+		ConvertJob job;
+		QString dir = options.outPath + card.id + "_cuesheet";
+		job.id = "cuesheet:" + card.id;
+		job.name = card.id + " (cue sheet)";
+		job.card = card.id;
+		job.program = options.cuesheet;
+		job.arguments << "-o" << dir << card.root;
+		job.output = dir + "/index.html";
+		foreach(const MXF::CardFile &file, card.clips)
+			job.sources.append(card.contents() + "CLIP/" + file.name);
+		return job;
+	};
+
+	QObject::connect(&watcher, &CardWatcher::cardArrived, [&](const MXF::Card &card) {
+		// the cue sheet is small and done first, the operator can start logging
+		if (!options.cuesheet.isEmpty())
+			queueJobs(QList<ConvertJob>() << cuesheet(card));
+		if (options.stagingPath.isEmpty())
+		{
+			convert(card);
+			return;
+		}
+		QSharedPointer<OffloadTask> task(new OffloadTask(card.root, options.stagingPath));
+		ConvertJob job;
+		job.name = card.id + " (offload)";
+		job.card = card.id;
+		job.program = QCoreApplication::applicationName();
+		job.arguments << "--offload" << options.stagingPath << card.root;
+		job.output = task->stagedCard();
+		foreach(const QString &file, task->files())
+			job.sources.append(card.root + "/" + file);
+		job.dataSize = task->totalSize();
+		job.task = task;
+		offloads.insert(task->stagedCard(), card.root);
+		scheduler.addJob(job);
+	});
+
+	QObject::connect(&watcher, &CardWatcher::cardRemoved, [&](const MXF::Card &card) {
+		// once offloaded, the jobs read from the staged copy
+		if (!options.stagingPath.isEmpty() && offloads.key(card.root).isEmpty())
+		{
+			qInfo().noquote() << card.id << "removed, already offloaded";
+			return;
+		}
+		int cancelled = scheduler.cancelCard(card.id);
+		for (int i = shotClips.size() - 1; i >= 0; --i)
+		{
+			if (shotClips[i].FileRoot == card.contents())
+				shotClips.removeAt(i);
+		}
+		if (cancelled)
+			qWarning().noquote() << card.id << "removed during ingest," << cancelled
+			                     << "jobs cancelled, insert it again to finish";
+	});
+
+	// the manifest has marked the job as failed already, see main()
+	QObject::connect(&scheduler, &JobScheduler::jobFinished, [&](const JobResult &r) {
+		if (r.job.task && offloads.contains(r.job.output))
+		{
+			QString staged = r.job.output;
+			offloads.remove(staged);
+			if (r.succeeded() && options.offloadOnly)
+				qInfo().noquote() << r.job.card << "offloaded to" << staged;
+			else if (r.succeeded())
+				convert(MXF::scanCard(staged));
+			else
+				qWarning().noquote() << "Offload of" << r.job.card << "failed, card not converted";
+			return;
+		}
+		if (r.succeeded())
+			return;
+		queuedShots.remove(r.job.id);
+		foreach(const QString &source, r.job.sources)
+		{
+			if (QFile::exists(source))
+				continue;
+			// the card was pulled, nothing of the output is usable
+			if (manifest.discardPartial(r.job))
+				qWarning().noquote() << r.job.name << ": source" << source << "is gone, output removed";
+			break;
+		}
+	});
+	QObject::connect(&scheduler, &JobScheduler::allFinished, [&]() {
+		qInfo().noquote() << "All jobs done, waiting for cards in" << root;
+	});
+
+	qInfo().noquote() << "Watching" << root << "for cards, stop with Ctrl+C";
+	scheduler.start();
+	watcher.start();
+	return QCoreApplication::exec();
+}
+
+void setupProgress(ProgressReporter &reporter, int seconds, QFile *json)
+{
+	reporter.setPrinting(seconds > 0);
+	reporter.setInterval(seconds > 0 ? seconds * 1000 : 1000);
+	if (json->isOpen())
+		reporter.setJsonOutput(json);
+}
+
 int main(int argc, char *argv[])
 {
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("mergeMXF");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Merges audio/video essence files of P2 cards");
+	parser.addHelpOption();
+	parser.addPositionalArgument("input", "card folder or folder containing cards");
+	parser.addPositionalArgument("output", "output folder");
+	QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+	                              "number of concurrent ffmpeg processes",
+	                              "count",
+	                              QString::number(QThread::idealThreadCount()));
+	QCommandLineOption largestFirstOption("largest-first",
+	                                      "start the clips with the most essence data first");
+	QCommandLineOption perDeviceOption("per-device",
+	                                   "number of jobs reading from the same disk at the same time (0: no limit)",
+	                                   "count",
+	                                   "2");
+	QCommandLineOption rewrapOption("rewrap",
+	                                "write OP1a MXF files instead of running ffmpeg");
+	QCommandLineOption shotsOption("shots",
+	                               "write one OP1a MXF file per shot, joining clips spanned over several cards");
+	parser.addOption(jobsOption);
+	parser.addOption(largestFirstOption);
+	parser.addOption(perDeviceOption);
+	parser.addOption(rewrapOption);
+	QCommandLineOption multichannelOption("multichannel-audio",
+	                                      "write all audio channels into one interleaved sound track (implies --rewrap)");
+	QCommandLineOption offloadOption("offload",
+	                                 "copy the cards' CONTENTS to folder first, with an MHL file of "
+	                                 "xxHash64/MD5 checksums per card, then convert from the copies",
+	                                 "folder");
+	QCommandLineOption offloadOnlyOption("offload-only",
+	                                     "stop after the offload");
+	QCommandLineOption verifyOption("verify",
+	                                "check the cards against their MHL files instead of converting");
+	QCommandLineOption progressOption("progress",
+	                                  "print the progress of the running jobs every seconds (0: never)",
+	                                  "seconds",
+	                                  "5");
+	QCommandLineOption progressJsonOption("progress-json",
+	                                      "write the progress as JSON lines to file (-: stdout)",
+	                                      "file");
+	QCommandLineOption restartOption("restart",
+	                                 "convert all clips again, even those finished by an earlier run");
+	parser.addOption(shotsOption);
+	parser.addOption(multichannelOption);
+	parser.addOption(offloadOption);
+	parser.addOption(offloadOnlyOption);
+	parser.addOption(verifyOption);
+	parser.addOption(progressOption);
+	parser.addOption(progressJsonOption);
+	QCommandLineOption watchOption("watch",
+	                               "keep running and ingest every card mounted below input as soon as it shows up");
+	QCommandLineOption cuesheetOption("cuesheet",
+	                                  "with --watch, also write a cue sheet per card by running the given p2_cuesheet binary",
+	                                  "program");
+	QCommandLineOption inOption("in",
+	                            "write only the frames from position on (implies --rewrap): a timecode "
+	                            "hh:mm:ss:ff or a frame number counted from the start of the clip",
+	                            "position");
+	QCommandLineOption outOption("out",
+	                             "write only the frames before position (implies --rewrap), see --in",
+	                             "position");
+	QCommandLineOption clipOption("clip",
+	                              "convert only the clip (with --shots: the shot starting with the clip) "
+	                              "called name, may be given several times",
+	                              "name");
+	parser.addOption(restartOption);
+	parser.addOption(watchOption);
+	parser.addOption(inOption);
+	parser.addOption(outOption);
+	parser.addOption(clipOption);
+	parser.addOption(cuesheetOption);
+	parser.process(app);
+	QStringList args = parser.positionalArguments();
 
 	QString path = QDir::currentPath();
 	QString outPath = path;
-	if (argc>1)
+	if (args.size()>0)
 	{
-		path = argv[1];
+		path = args[0];
 		QDir sd(path);
 		if (!sd.exists())
 			return 2;
 		path = sd.absolutePath();
 		qDebug() << path;
 	}
-	if (argc>2)
-		outPath = argv[2];
+	if (args.size()>1)
+		outPath = args[1];
 
 	if ((outPath.length()) && (!outPath.endsWith("/")))
 	{
 		outPath.append("/");
 	}
-	QStringList cmdList;
+	bool shots = parser.isSet(shotsOption);
+	bool multichannelAudio = parser.isSet(multichannelOption);
+	FramePosition inPoint;
+	FramePosition outPoint;
+	if ((parser.isSet(inOption) && !parsePosition(parser.value(inOption), &inPoint))
+	        || (parser.isSet(outOption) && !parsePosition(parser.value(outOption), &outPoint)))
+	{
+		qWarning() << "--in and --out take a timecode hh:mm:ss:ff or a frame number";
+		return 2;
+	}
+	bool subclip = !inPoint.isNull() || !outPoint.isNull();
+	QStringList clipNames = parser.values(clipOption);
+	bool rewrap = shots || multichannelAudio || subclip || parser.isSet(rewrapOption);
 	qDebug()<<"Input: " << path;
-	//check if we are in a card's root
-	if (path.endsWith("CONTENTS") || QDir(path).entryList().contains("CONTENTS"))
+	QFile progressJson;
+	if (parser.isSet(progressJsonOption))
+	{
+		QString fileName = parser.value(progressJsonOption);
+		bool ok;
+		if (fileName == "-")
+		{
+			ok = progressJson.open(stdout, QIODevice::WriteOnly);
+		}
+		else
+		{
+			progressJson.setFileName(fileName);
+			ok = progressJson.open(QIODevice::WriteOnly | QIODevice::Append);
+		}
+		if (!ok)
+		{
+			qWarning().noquote() << fileName << ":" << progressJson.errorString();
+			return 2;
+		}
+	}
+	int progressSeconds = parser.value(progressOption).toInt();
+
+	if (parser.isSet(watchOption))
 	{
-		cmdList = convertFolderCmds(QDir::currentPath(), outPath);
+		// outputs below the watched root would be scanned over and over
+		if (args.size() < 2)
+		{
+			qWarning() << "--watch needs an output folder";
+			return 2;
+		}
+		if (parser.isSet(verifyOption))
+		{
+			qWarning() << "--verify checks cards once and cannot be combined with --watch";
+			return 2;
+		}
+		if (!QDir().mkpath(outPath))
+		{
+			qWarning().noquote() << outPath << ": cannot create folder";
+			return 2;
+		}
+		JobManifest manifest(outPath + "mergeMXF.manifest.json");
+		if (!manifest.load())
+		{
+			qWarning().noquote() << manifest.fileName() << ":" << manifest.errorString();
+			return 4;
+		}
+		JobScheduler scheduler;
+		QObject::connect(&scheduler, SIGNAL(jobStarted(ConvertJob)),
+		                 &manifest, SLOT(jobStarted(ConvertJob)));
+		QObject::connect(&scheduler, SIGNAL(jobFinished(JobResult)),
+		                 &manifest, SLOT(jobFinished(JobResult)));
+		scheduler.setWorkerCount(parser.value(jobsOption).toInt());
+		scheduler.setStreamsPerDevice(parser.value(perDeviceOption).toInt());
+		if (parser.isSet(largestFirstOption))
+			scheduler.setOrder(JobScheduler::LargestFirst);
+		ProgressReporter progress(&scheduler);
+		setupProgress(progress, progressSeconds, &progressJson);
+
+		WatchOptions options;
+		options.outPath = outPath;
+		options.stagingPath = parser.value(offloadOption);
+		options.offloadOnly = parser.isSet(offloadOnlyOption);
+		options.cuesheet = parser.value(cuesheetOption);
+		options.shots = shots;
+		options.rewrap = rewrap;
+		options.multichannelAudio = multichannelAudio;
+		options.restart = parser.isSet(restartOption);
+		options.inPoint = inPoint;
+		options.outPoint = outPoint;
+		options.clipNames = clipNames;
+		return watchCards(path, options, scheduler, manifest);
 	}
-	else //try one level deeper
+
+	QList<MXF::Card> cards = MXF::findCards(path, qMax(8, parser.value(jobsOption).toInt()));
+	if (parser.isSet(verifyOption))
 	{
-		QDir dir(path);
-		QFileInfoList dirs = dir.entryInfoList();
-		foreach(QFileInfo f, dirs)
+		// files of a card are hashed in parallel, cards one after the other
+		int failed = 0;
+		foreach(const MXF::Card &card, cards)
 		{
-			if (f.isDir())
+			CardVerifier verifier(card.root);
+			verifier.setWorkerCount(parser.value(jobsOption).toInt());
+			if (!verifier.run())
 			{
-				cmdList.append(convertFolderCmds(f.absoluteFilePath(), outPath));
+				qWarning().noquote() << verifier.errorString();
+				failed++;
+				continue;
 			}
+			verifier.printReport();
+			if (verifier.failures())
+				failed++;
 		}
+		return failed ? 5 : 0;
+	}
+	if (parser.isSet(offloadOption))
+	{
+		JobScheduler offloader;
+		offloader.setWorkerCount(parser.value(jobsOption).toInt());
+		offloader.setStreamsPerDevice(parser.value(perDeviceOption).toInt());
+		ProgressReporter offloadProgress(&offloader);
+		setupProgress(offloadProgress, progressSeconds, &progressJson);
+		if (!offloadCards(cards, parser.value(offloadOption), offloader))
+			return 1;
+		// the conversion reads from the staged copies
+		if (parser.isSet(offloadOnlyOption))
+			return 0;
 	}
-	foreach(QString cmd, cmdList)
+	QList<MXF::Info> clips;
+	foreach(const MXF::Card &card, cards)
+		clips.append(readClips(card));
+
+	QList<QList<MXF::Info> > shotList;
+	if (shots)
 	{
-		qDebug()<<cmd;
-		QProcess process;
-		process.start("ffmpeg", cmd.split(" "	));
-		process.waitForFinished(-1);
+		// check all chains before anything is written
+		QStringList errors;
+		shotList = resolveShots(clips, &errors);
+		if (!errors.isEmpty())
+		{
+			foreach(const QString &e, errors)
+				qWarning().noquote() << "Incomplete shot:" << e;
+			qWarning() << "Nothing written, add the missing cards to the input folder";
+			return 3;
+		}
+	}
+	else
+	{
+		foreach(const MXF::Info &info, clips)
+			shotList.append(QList<MXF::Info>() << info);
+	}
+	if (!clipNames.isEmpty())
+	{
+		for (int i = shotList.size() - 1; i >= 0; --i)
+		{
+			if (!clipNames.contains(shotList[i].first().clip.clipName(), Qt::CaseInsensitive))
+				shotList.removeAt(i);
+		}
+		if (shotList.isEmpty())
+		{
+			qWarning() << "None of the clips" << clipNames << "found";
+			return 2;
+		}
+	}
+
+	QList<ConvertJob> cmdList;
+	if (subclip)
+	{
+		cmdList = subclipCmds(shotList, outPath, inPoint, outPoint, multichannelAudio);
+		if (cmdList.isEmpty())
+			qWarning() << "No clip has frames between --in and --out";
+	}
+	else if (shots)
+	{
+		foreach(const QList<MXF::Info> &shot, shotList)
+		{
+			const MXF::Info &first = shot.first();
+			cmdList.append(rewrapJob(shot, outPath + first.CardId + "_" + first.clip.clipName() + ".mxf",
+			                         multichannelAudio));
+		}
+	}
+	else
+	{
+		clips.clear();
+		foreach(const QList<MXF::Info> &shot, shotList)
+			clips.append(shot.first());
+		cmdList = convertFolderCmds(clips, outPath, rewrap, multichannelAudio);
+	}
+
+	// skip what an earlier run over the same cards has finished
+	JobManifest manifest(outPath + "mergeMXF.manifest.json");
+	if (!manifest.load())
+	{
+		qWarning().noquote() << manifest.fileName() << ":" << manifest.errorString();
+		return 4;
+	}
+	int skipped = 0;
+	for (int i = cmdList.size() - 1; i >= 0; --i)
+	{
+		const ConvertJob &job = cmdList[i];
+		if (!parser.isSet(restartOption) && manifest.isDone(job))
+		{
+			qDebug() << job.name << "finished by an earlier run";
+			cmdList.removeAt(i);
+			skipped++;
+		}
+		else if (!manifest.discardPartial(job))
+		{
+			qWarning().noquote() << "Cannot remove partial output of" << job.name;
+			return 4;
+		}
 	}
+	if (skipped)
+		qInfo() << "Skipping" << skipped << "clips finished by an earlier run";
 
+	JobScheduler scheduler;
+	QObject::connect(&scheduler, SIGNAL(jobStarted(ConvertJob)),
+	                 &manifest, SLOT(jobStarted(ConvertJob)));
+	QObject::connect(&scheduler, SIGNAL(jobFinished(JobResult)),
+	                 &manifest, SLOT(jobFinished(JobResult)));
+	scheduler.setWorkerCount(parser.value(jobsOption).toInt());
+	scheduler.setStreamsPerDevice(parser.value(perDeviceOption).toInt());
+	if (parser.isSet(largestFirstOption))
+		scheduler.setOrder(JobScheduler::LargestFirst);
+	ProgressReporter progress(&scheduler);
+	setupProgress(progress, progressSeconds, &progressJson);
+	scheduler.addJobs(cmdList);
+	int failed = scheduler.run();
+	scheduler.printSummary();
 
-	//return a.exec();
-	return 0;
+	return failed ? 1 : 0;
 }
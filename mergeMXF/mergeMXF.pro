@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui xml
+QT       += core gui xml concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -14,9 +14,23 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         wndmain.cpp \
-    mxfmeta.cpp
+    jobscheduler.cpp \
+    op1awriter.cpp \
+    jobmanifest.cpp \
+    cardoffload.cpp \
+    cardverify.cpp \
+    progressreporter.cpp \
+    cardwatcher.cpp
 
 HEADERS  += wndmain.h \
-    mxfmeta.h
+    jobscheduler.h \
+    op1awriter.h \
+    jobmanifest.h \
+    cardoffload.h \
+    cardverify.h \
+    progressreporter.h \
+    cardwatcher.h
 
 FORMS    += wndmain.ui
+
+include(../common/common.pri)
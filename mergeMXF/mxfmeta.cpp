@@ -1,7 +0,0 @@
-#include "mxfmeta.h"
-
-MXFMeta::MXFMeta(QObject *parent) : QObject(parent)
-{
-
-}
-
@@ -1,17 +0,0 @@
-#ifndef MXFMETA_H
-#define MXFMETA_H
-
-#include <QObject>
-
-class MXFMeta : public QObject
-{
-	Q_OBJECT
-public:
-	explicit MXFMeta(QObject *parent = 0);
-
-signals:
-
-public slots:
-};
-
-#endif // MXFMETA_H
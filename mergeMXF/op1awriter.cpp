@@ -0,0 +1,1415 @@
+#include "op1awriter.h"
+#include "klvreader.h"
+#include "pcminterleave.h"
+#include <QFile>
+#include <QUuid>
+#include <QDateTime>
+#include <QPair>
+#include <QVarLengthArray>
+#include <QDebug>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace {
+
+enum SetType {
+	SourceClipSet = 0x11,
+	TimecodeComponentSet = 0x14,
+	SequenceSet = 0x0F,
+	ContentStorageSet = 0x18,
+	EssenceContainerDataSet = 0x23,
+	PrefaceSet = 0x2F,
+	IdentificationSet = 0x30,
+	MaterialPackageSet = 0x36,
+	SourcePackageSet = 0x37,
+	TrackSet = 0x3B,
+	MultipleDescriptorSet = 0x44
+};
+
+const quint32 bodySID = 1;
+const quint32 indexSID = 2;
+
+/// an IndexEntryArray has to fit into a two byte local set length
+const int maxIndexEntriesPerSegment = 5000;
+
+/// payloads smaller than this are copied through the iovec path
+const qint64 minZeroCopySize = 65536;
+/// prefetch this many edit units ahead of the writer
+const int readAheadEditUnits = 64;
+
+const uchar klvPrefix[4] = { 0x06, 0x0E, 0x2B, 0x34 };
+const uchar setPrefix[13] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x02, 0x53, 0x01, 0x01,
+	0x0D, 0x01, 0x01, 0x01, 0x01
+};
+const uchar partitionPrefix[13] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x02, 0x05, 0x01, 0x01,
+	0x0D, 0x01, 0x02, 0x01, 0x01
+};
+const uchar indexSegmentKey[16] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x02, 0x53, 0x01, 0x01,
+	0x0D, 0x01, 0x02, 0x01, 0x01, 0x10, 0x01, 0x00
+};
+const uchar op1a[16] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x04, 0x01, 0x01, 0x01,
+	0x0D, 0x01, 0x02, 0x01, 0x01, 0x01, 0x09, 0x00
+};
+const uchar multipleWrappings[16] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x04, 0x01, 0x01, 0x03,
+	0x0D, 0x01, 0x03, 0x01, 0x02, 0x7F, 0x01, 0x00
+};
+const uchar pictureDataDef[16] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x04, 0x01, 0x01, 0x01,
+	0x01, 0x03, 0x02, 0x02, 0x01, 0x00, 0x00, 0x00
+};
+const uchar soundDataDef[16] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x04, 0x01, 0x01, 0x01,
+	0x01, 0x03, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00
+};
+const uchar timecodeDataDef[16] = {
+	0x06, 0x0E, 0x2B, 0x34, 0x04, 0x01, 0x01, 0x01,
+	0x01, 0x03, 0x02, 0x01, 0x01, 0x00, 0x00, 0x00
+};
+const uchar umidLabel[16] = {
+	0x06, 0x0A, 0x2B, 0x34, 0x01, 0x01, 0x01, 0x05,
+	0x01, 0x01, 0x0D, 0x20, 0x13, 0x00, 0x00, 0x00
+};
+const uchar productUid[16] = {
+	0x3d, 0x2c, 0x5e, 0x0a, 0x71, 0x4b, 0x4e, 0x8f,
+	0x9a, 0x0c, 0x6b, 0x43, 0x32, 0x50, 0x32, 0x01
+};
+
+/// used when the source files don't bring a primer entry for a tag
+struct PrimerEntry
+{
+	quint16 tag;
+	uchar ul[16];
+};
+
+const PrimerEntry defaultPrimer[] = {
+	{ 0x3C0A, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x01,0x01,0x01,0x15,0x02,0x00,0x00,0x00,0x00 } },
+	{ 0x3B02, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x10,0x02,0x04,0x00,0x00 } },
+	{ 0x3B05, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x03,0x01,0x02,0x01,0x05,0x00,0x00,0x00 } },
+	{ 0x3B06, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x06,0x04,0x00,0x00 } },
+	{ 0x3B03, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x02,0x01,0x00,0x00 } },
+	{ 0x3B09, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x01,0x02,0x02,0x03,0x00,0x00,0x00,0x00 } },
+	{ 0x3B0A, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x01,0x02,0x02,0x10,0x02,0x01,0x00,0x00 } },
+	{ 0x3B0B, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x01,0x02,0x02,0x10,0x02,0x02,0x00,0x00 } },
+	{ 0x3C09, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x05,0x20,0x07,0x01,0x01,0x00,0x00,0x00 } },
+	{ 0x3C01, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x05,0x20,0x07,0x01,0x02,0x01,0x00,0x00 } },
+	{ 0x3C02, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x05,0x20,0x07,0x01,0x03,0x01,0x00,0x00 } },
+	{ 0x3C04, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x05,0x20,0x07,0x01,0x05,0x01,0x00,0x00 } },
+	{ 0x3C05, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x05,0x20,0x07,0x01,0x07,0x00,0x00,0x00 } },
+	{ 0x3C06, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x10,0x02,0x03,0x00,0x00 } },
+	{ 0x1901, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x05,0x01,0x00,0x00 } },
+	{ 0x1902, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x05,0x02,0x00,0x00 } },
+	{ 0x2701, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x06,0x01,0x00,0x00,0x00,0x00 } },
+	{ 0x3F06, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x04,0x01,0x03,0x04,0x05,0x00,0x00,0x00,0x00 } },
+	{ 0x3F07, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x04,0x01,0x03,0x04,0x04,0x00,0x00,0x00,0x00 } },
+	{ 0x4401, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x01,0x01,0x01,0x15,0x10,0x00,0x00,0x00,0x00 } },
+	{ 0x4402, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x01,0x01,0x03,0x03,0x02,0x01,0x00,0x00,0x00 } },
+	{ 0x4403, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x06,0x05,0x00,0x00 } },
+	{ 0x4404, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x10,0x02,0x05,0x00,0x00 } },
+	{ 0x4405, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x10,0x01,0x03,0x00,0x00 } },
+	{ 0x4701, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x02,0x03,0x00,0x00 } },
+	{ 0x4801, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x01,0x07,0x01,0x01,0x00,0x00,0x00,0x00 } },
+	{ 0x4804, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x01,0x04,0x01,0x03,0x00,0x00,0x00,0x00 } },
+	{ 0x4B01, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x05,0x30,0x04,0x05,0x00,0x00,0x00,0x00 } },
+	{ 0x4B02, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x03,0x01,0x03,0x00,0x00 } },
+	{ 0x4803, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x02,0x04,0x00,0x00 } },
+	{ 0x0201, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x04,0x07,0x01,0x00,0x00,0x00,0x00,0x00 } },
+	{ 0x0202, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x02,0x01,0x01,0x03,0x00,0x00 } },
+	{ 0x1001, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x06,0x09,0x00,0x00 } },
+	{ 0x1201, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x03,0x01,0x04,0x00,0x00 } },
+	{ 0x1101, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x03,0x01,0x00,0x00,0x00 } },
+	{ 0x1102, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x03,0x02,0x00,0x00,0x00 } },
+	{ 0x1501, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x07,0x02,0x01,0x03,0x01,0x05,0x00,0x00 } },
+	{ 0x1502, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x04,0x04,0x01,0x01,0x02,0x06,0x00,0x00 } },
+	{ 0x1503, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x01,0x04,0x04,0x01,0x01,0x05,0x00,0x00,0x00 } },
+	{ 0x3D07, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x04,0x02,0x01,0x01,0x04,0x00,0x00,0x00 } },
+	{ 0x3D09, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x04,0x02,0x03,0x03,0x05,0x00,0x00,0x00 } },
+	{ 0x3D0A, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x04,0x02,0x03,0x02,0x01,0x00,0x00,0x00 } },
+	{ 0x3F01, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x04,0x06,0x01,0x01,0x04,0x06,0x0B,0x00,0x00 } },
+	{ 0x3006, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x05,0x06,0x01,0x01,0x03,0x05,0x00,0x00,0x00 } },
+	{ 0x3001, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x01,0x04,0x06,0x01,0x01,0x00,0x00,0x00,0x00 } },
+	{ 0x3002, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x01,0x04,0x06,0x01,0x02,0x00,0x00,0x00,0x00 } },
+	{ 0x3004, { 0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x02,0x06,0x01,0x01,0x04,0x01,0x02,0x00,0x00 } },
+};
+
+void put8(QByteArray &b, quint8 v)
+{
+	b.append(char(v));
+}
+
+void put16(QByteArray &b, quint16 v)
+{
+	put8(b, v >> 8);
+	put8(b, v & 0xFF);
+}
+
+void put32(QByteArray &b, quint32 v)
+{
+	put16(b, v >> 16);
+	put16(b, v & 0xFFFF);
+}
+
+void put64(QByteArray &b, quint64 v)
+{
+	put32(b, quint32(v >> 32));
+	put32(b, quint32(v & 0xFFFFFFFF));
+}
+
+/// four byte BER length, so lengths can be patched in place
+void putBer4(QByteArray &b, quint32 length)
+{
+	put8(b, 0x83);
+	put8(b, (length >> 16) & 0xFF);
+	put16(b, length & 0xFFFF);
+}
+
+QByteArray bytes(const uchar *p, int size)
+{
+	return QByteArray(reinterpret_cast<const char*>(p), size);
+}
+
+QByteArray setKey(SetType type)
+{
+	QByteArray key = bytes(setPrefix, sizeof(setPrefix));
+	put8(key, 0x01);
+	put8(key, type);
+	put8(key, 0x00);
+	return key;
+}
+
+QByteArray klv(const QByteArray &key, const QByteArray &value)
+{
+	QByteArray b = key;
+	putBer4(b, value.size());
+	b.append(value);
+	return b;
+}
+
+/** an MXF local set. Items keep their order, the InstanceUID comes first */
+class LocalSet
+{
+public:
+	explicit LocalSet(const QByteArray &key) :
+	    mKey(key), mUid(QUuid::createUuid().toRfc4122())
+	{
+		set(0x3C0A, mUid);
+	}
+
+	/** copy of an existing set with a new InstanceUID */
+	static LocalSet copy(const uchar *key, const MXF::Span &value)
+	{
+		LocalSet s(bytes(key, 16));
+		qint64 pos = 0;
+		while (pos + 4 <= value.size)
+		{
+			quint16 tag = (value.data[pos] << 8) | value.data[pos + 1];
+			quint16 size = (value.data[pos + 2] << 8) | value.data[pos + 3];
+			if (pos + 4 + size > value.size)
+				break;
+			if (tag != 0x3C0A)
+				s.set(tag, bytes(value.data + pos + 4, size));
+			pos += 4 + size;
+		}
+		return s;
+	}
+
+	void set(quint16 tag, const QByteArray &value)
+	{
+		for (int i = 0; i < mItems.size(); ++i)
+		{
+			if (mItems[i].first == tag)
+			{
+				mItems[i].second = value;
+				return;
+			}
+		}
+		mItems.append(qMakePair(tag, value));
+	}
+	void set8(quint16 tag, quint8 v) { QByteArray b; put8(b, v); set(tag, b); }
+	void set16(quint16 tag, quint16 v) { QByteArray b; put16(b, v); set(tag, b); }
+	void set32(quint16 tag, quint32 v) { QByteArray b; put32(b, v); set(tag, b); }
+	void set64(quint16 tag, quint64 v) { QByteArray b; put64(b, v); set(tag, b); }
+	void setUL(quint16 tag, const uchar *ul) { set(tag, bytes(ul, 16)); }
+	void setRational(quint16 tag, qint32 numerator, qint32 denominator)
+	{
+		QByteArray b;
+		put32(b, numerator);
+		put32(b, denominator);
+		set(tag, b);
+	}
+	/** MXF strings are UTF-16 big endian */
+	void setString(quint16 tag, const QString &s)
+	{
+		QByteArray b;
+		for (int i = 0; i < s.size(); ++i)
+			put16(b, s.at(i).unicode());
+		set(tag, b);
+	}
+	void setTimestamp(quint16 tag, const QDateTime &t)
+	{
+		QByteArray b;
+		put16(b, t.date().year());
+		put8(b, t.date().month());
+		put8(b, t.date().day());
+		put8(b, t.time().hour());
+		put8(b, t.time().minute());
+		put8(b, t.time().second());
+		put8(b, t.time().msec() / 4);
+		set(tag, b);
+	}
+	/** batch or array of 16 byte items (references or ULs) */
+	void setBatch(quint16 tag, const QList<QByteArray> &items)
+	{
+		QByteArray b;
+		put32(b, items.size());
+		put32(b, 16);
+		foreach(const QByteArray &item, items)
+			b.append(item);
+		set(tag, b);
+	}
+
+	void remove(quint16 tag)
+	{
+		for (int i = 0; i < mItems.size(); ++i)
+		{
+			if (mItems[i].first == tag)
+			{
+				mItems.removeAt(i);
+				return;
+			}
+		}
+	}
+	/** dynamic tags would need their own primer entries */
+	void removeDynamicTags()
+	{
+		for (int i = mItems.size() - 1; i >= 0; --i)
+		{
+			if (mItems[i].first >= 0x8000)
+				mItems.removeAt(i);
+		}
+	}
+
+	QByteArray value(quint16 tag) const
+	{
+		for (int i = 0; i < mItems.size(); ++i)
+		{
+			if (mItems[i].first == tag)
+				return mItems[i].second;
+		}
+		return QByteArray();
+	}
+	QByteArray uid() const { return mUid; }
+	QList<quint16> tags() const
+	{
+		QList<quint16> t;
+		for (int i = 0; i < mItems.size(); ++i)
+			t.append(mItems[i].first);
+		return t;
+	}
+
+	QByteArray toKlv() const
+	{
+		QByteArray v;
+		for (int i = 0; i < mItems.size(); ++i)
+		{
+			put16(v, mItems[i].first);
+			put16(v, mItems[i].second.size());
+			v.append(mItems[i].second);
+		}
+		return klv(mKey, v);
+	}
+
+private:
+	QByteArray mKey;
+	QByteArray mUid;
+	QList<QPair<quint16, QByteArray> > mItems;
+};
+
+QByteArray partitionPack(quint8 kind, quint8 status,
+                         quint64 thisPartition, quint64 previousPartition,
+                         quint64 footerPartition, quint64 headerByteCount,
+                         quint64 indexByteCount, quint32 packIndexSID,
+                         quint32 packBodySID, const QList<QByteArray> &containers)
+{
+	QByteArray key = bytes(partitionPrefix, sizeof(partitionPrefix));
+	put8(key, kind);
+	put8(key, status);
+	put8(key, 0x00);
+	QByteArray v;
+	put16(v, 1);                // major version
+	put16(v, 2);                // minor version
+	put32(v, 1);                // KAG size
+	put64(v, thisPartition);
+	put64(v, previousPartition);
+	put64(v, footerPartition);
+	put64(v, headerByteCount);
+	put64(v, indexByteCount);
+	put32(v, packIndexSID);
+	put64(v, 0);                // body offset
+	put32(v, packBodySID);
+	v.append(bytes(op1a, sizeof(op1a)));
+	put32(v, containers.size());
+	put32(v, 16);
+	foreach(const QByteArray &c, containers)
+		v.append(c);
+	return klv(key, v);
+}
+
+/** first generic container UL of the source's header partition */
+QByteArray sourceContainer(const MXF::KlvReader *reader)
+{
+	static const uchar gc[4] = { 0x0D, 0x01, 0x03, 0x01 };
+	QList<MXF::PartitionPack> partitions = reader->partitions();
+	if (partitions.isEmpty())
+		return QByteArray();
+	foreach(const QByteArray &c, partitions.first().essenceContainers)
+	{
+		if ((c.size() == 16) && !memcmp(c.constData() + 8, gc, sizeof(gc)))
+			return c;
+	}
+	return QByteArray();
+}
+
+/** the file descriptor of an OP-Atom file matching one of the set types */
+bool findDescriptor(const MXF::KlvReader *reader, const QList<int> &types, LocalSet *descriptor)
+{
+	foreach(const MXF::KlvPacket &set, reader->metadataSets())
+	{
+		if ((set.key[13] == 0x01) && types.contains(set.key[14]))
+		{
+			*descriptor = LocalSet::copy(set.key, reader->span(set.valueOffset, set.length));
+			return true;
+		}
+	}
+	return false;
+}
+
+QList<int> pictureDescriptorTypes()
+{
+	// generic picture, CDCI, RGBA, MPEG video
+	return QList<int>() << 0x27 << 0x28 << 0x29 << 0x51;
+}
+
+QList<int> soundDescriptorTypes()
+{
+	// generic sound, AES3, wave
+	return QList<int>() << 0x42 << 0x47 << 0x48;
+}
+
+void adviseSequential(const MXF::KlvReader *reader)
+{
+	posix_fadvise(reader->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+	MXF::Span all = reader->span(0, reader->size());
+	posix_madvise(const_cast<uchar*>(all.data), all.size, POSIX_MADV_SEQUENTIAL);
+}
+
+void willNeed(const MXF::KlvReader *reader, const MXF::Span &range)
+{
+	if (!range.isNull())
+		posix_fadvise(reader->handle(), reader->fileOffset(range), range.size,
+		              POSIX_FADV_WILLNEED);
+}
+
+/** reads size bytes at offset, fewer at the end of the file, -1 on errors.
+ * Essence is read like this rather than through the mapping: if the card
+ * is pulled, a read fails where touching the mapping raises SIGBUS */
+qint64 readAt(int fd, uchar *buffer, qint64 size, qint64 offset)
+{
+	qint64 done = 0;
+	while (done < size)
+	{
+		ssize_t n = pread(fd, buffer + done, size - done, offset + done);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n < 0)
+			return -1;
+		if (n == 0)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+}
+
+/** copies essence payloads into the output file.
+ * Small items are collected and written with writev(), large payloads are
+ * transferred with copy_file_range() as long as the kernel accepts it for
+ * the two files involved. */
+class Op1aWriter::EssenceCopier
+{
+public:
+	EssenceCopier(int fd, bool zeroCopy, const QAtomicInt *cancel) :
+	    mFd(fd), mZeroCopy(zeroCopy), mCancel(cancel), mBufferUsed(0), mPending(0), mWritten(0)
+	{
+		mBuffer.resize(256 * 1024);
+		mIov.reserve(IOV_MAX);
+	}
+
+	/** small data like KLV headers, copied into an internal buffer */
+	bool append(const char *data, int size)
+	{
+		if (size > mBuffer.size())
+			return flush() && writeAll(data, size);
+		uchar *p = reserve(size);
+		if (!p)
+			return false;
+		memcpy(p, data, size);
+		return true;
+	}
+
+	/** room for size bytes in the internal buffer, written out with the
+	 * next flush. returns 0 on a write error */
+	uchar *reserve(int size)
+	{
+		if ((mBufferUsed + size > mBuffer.size()) || (mIov.size() >= IOV_MAX))
+		{
+			if (!flush())
+				return 0;
+		}
+		if (size > mBuffer.size())
+			mBuffer.resize(size);
+		char *p = mBuffer.data() + mBufferUsed;
+		addIov(p, size);
+		mBufferUsed += size;
+		return reinterpret_cast<uchar*>(p);
+	}
+
+	bool append(const QByteArray &data)
+	{
+		return append(data.constData(), data.size());
+	}
+
+	/** zero bytes, e.g. to fill up short audio */
+	bool appendSilence(qint64 size)
+	{
+		static const char zeros[4096] = { 0 };
+		while (size > 0)
+		{
+			int n = int(qMin<qint64>(size, sizeof(zeros)));
+			if (!append(zeros, n))
+				return false;
+			size -= n;
+		}
+		return true;
+	}
+
+	/** payload from a source file, data is its range in the source's
+	 * mapping; only its size is used, the bytes are read from srcFd */
+	bool append(const MXF::Span &data, int srcFd, qint64 srcOffset)
+	{
+		if (cancelled())
+			return false;
+		if (mZeroCopy && (data.size >= minZeroCopySize))
+		{
+			if (!flush())
+				return false;
+			qint64 done = 0;
+			loff_t in = srcOffset;
+			ssize_t n = 0;
+			while (done < data.size)
+			{
+				n = copy_file_range(srcFd, &in, mFd, NULL, data.size - done, 0);
+				if ((n < 0) && (errno == EINTR))
+					continue;
+				if (n <= 0)
+					break;
+				done += n;
+			}
+			mWritten += done;
+			if (done == data.size)
+				return true;
+			if (n == 0)
+			{
+				// the source ends before the index says
+				mError = QStringLiteral("source file ends %1 bytes early").arg(data.size - done);
+				return false;
+			}
+			int error = errno;
+			if ((error != EXDEV) && (error != EINVAL) && (error != ENOSYS)
+			        && (error != EOPNOTSUPP) && (error != EBADF))
+			{
+				mError = QString::fromLocal8Bit(strerror(error));
+				return false;
+			}
+			// not possible between these files, read them from now on
+			qDebug() << "copy_file_range not available:" << strerror(error);
+			mZeroCopy = false;
+			return append(data.mid(done), srcFd, srcOffset + done);
+		}
+		uchar *p = reserve(int(data.size));
+		if (!p)
+			return false;
+		qint64 n = readAt(srcFd, p, data.size, srcOffset);
+		if (n < 0)
+		{
+			mError = QString::fromLocal8Bit(strerror(errno));
+			return false;
+		}
+		if (n < data.size)
+		{
+			mError = QStringLiteral("source file ends %1 bytes early").arg(data.size - n);
+			return false;
+		}
+		return true;
+	}
+
+	/** true, with the error set, once the task has been cancelled */
+	bool cancelled()
+	{
+		if (!mCancel || !mCancel->loadAcquire())
+			return false;
+		mError = QStringLiteral("cancelled");
+		return true;
+	}
+
+	bool flush()
+	{
+		if (mIov.isEmpty())
+			return true;
+		bool ok = writeAll(mIov.data(), mIov.size());
+		mIov.clear();
+		mBufferUsed = 0;
+		mWritten += mPending;
+		mPending = 0;
+		return ok;
+	}
+
+	qint64 written() const
+	{
+		return mWritten + mPending;
+	}
+
+	QString errorString() const
+	{
+		return mError;
+	}
+
+private:
+	void addIov(const void *data, qint64 size)
+	{
+		struct iovec v;
+		v.iov_base = const_cast<void*>(data);
+		v.iov_len = size;
+		mIov.append(v);
+		mPending += size;
+	}
+
+	bool writeAll(const char *data, qint64 size)
+	{
+		struct iovec v;
+		v.iov_base = const_cast<char*>(data);
+		v.iov_len = size;
+		if (!writeAll(&v, 1))
+			return false;
+		mWritten += size;
+		return true;
+	}
+
+	bool writeAll(struct iovec *iov, int count)
+	{
+		while (count > 0)
+		{
+			ssize_t n = writev(mFd, iov, count);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				mError = QString::fromLocal8Bit(strerror(errno));
+				return false;
+			}
+			while ((count > 0) && (size_t(n) >= iov->iov_len))
+			{
+				n -= iov->iov_len;
+				iov++;
+				count--;
+			}
+			if (count > 0)
+			{
+				iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+				iov->iov_len -= n;
+			}
+		}
+		return true;
+	}
+
+	int mFd;
+	bool mZeroCopy;
+	const QAtomicInt *mCancel;
+	QVector<char> mBuffer;
+	int mBufferUsed;
+	QVector<struct iovec> mIov;
+	qint64 mPending;
+	qint64 mWritten;
+	QString mError;
+};
+
+Op1aWriter::Op1aWriter() :
+    mEditRateNumerator(0),
+    mEditRateDenominator(1),
+    mStartTimecode(0),
+    mDropFrame(false),
+    mDuration(0),
+    mZeroCopy(true),
+    mInterleaveAudio(false),
+    mPrepared(false),
+    mCancel(0),
+    mBytesWritten(0),
+    mAudioElementType(0),
+    mEditUnitByteCount(0)
+{
+}
+
+Op1aWriter::~Op1aWriter()
+{
+	closeSources();
+}
+
+void Op1aWriter::setEditRate(int numerator, int denominator)
+{
+	mEditRateNumerator = numerator;
+	mEditRateDenominator = denominator;
+}
+
+void Op1aWriter::setStartTimecode(qint64 frames, bool dropFrame)
+{
+	mStartTimecode = frames;
+	mDropFrame = dropFrame;
+}
+
+void Op1aWriter::setSourcePackageId(const QByteArray &umid)
+{
+	mSourcePackageId = umid;
+}
+
+void Op1aWriter::setName(const QString &name)
+{
+	mName = name;
+}
+
+void Op1aWriter::setZeroCopy(bool enabled)
+{
+	mZeroCopy = enabled;
+}
+
+void Op1aWriter::setCancelFlag(const QAtomicInt *cancel)
+{
+	mCancel = cancel;
+}
+
+void Op1aWriter::setInterleavedAudio(bool enabled)
+{
+	mInterleaveAudio = enabled;
+	mPrepared = false;
+}
+
+void Op1aWriter::addSegment(const RewrapSegment &segment)
+{
+	mSegments.append(segment);
+	mPrepared = false;
+}
+
+QString Op1aWriter::errorString() const
+{
+	return mError;
+}
+
+qint64 Op1aWriter::duration() const
+{
+	return mDuration;
+}
+
+qint64 Op1aWriter::bytesWritten() const
+{
+	return mBytesWritten.load();
+}
+
+bool Op1aWriter::fail(const QString &message)
+{
+	mError = message;
+	return false;
+}
+
+void Op1aWriter::closeSources()
+{
+	foreach(const Source &s, mSources)
+	{
+		delete s.video;
+		qDeleteAll(s.audio);
+	}
+	mSources.clear();
+}
+
+qint64 Op1aWriter::audioSample(int track, qint64 editUnit) const
+{
+	const AudioTrack &t = mAudioTracks[track];
+	return editUnit * t.rateNumerator * mEditRateDenominator
+	        / (qint64(t.rateDenominator) * mEditRateNumerator);
+}
+
+int Op1aWriter::soundTrackCount() const
+{
+	if (mInterleaveAudio)
+		return qMin(1, mAudioTracks.size());
+	return mAudioTracks.size();
+}
+
+quint32 Op1aWriter::soundBlockAlign(int track) const
+{
+	if (mInterleaveAudio)
+		return mAudioTracks.first().blockAlign * mAudioTracks.size();
+	return mAudioTracks[track].blockAlign;
+}
+
+bool Op1aWriter::prepare()
+{
+	closeSources();
+	mAudioTracks.clear();
+	mPrimer.clear();
+	mDuration = 0;
+	mPrepared = false;
+	if (mSegments.isEmpty())
+		return fail(QStringLiteral("nothing to write"));
+	if ((mEditRateNumerator <= 0) || (mEditRateDenominator <= 0))
+		return fail(QStringLiteral("invalid edit rate"));
+
+	bool cbr = true;
+	quint32 videoByteCount = 0;
+	foreach(const RewrapSegment &segment, mSegments)
+	{
+		Source src;
+		src.video = new MXF::KlvReader(segment.videoFile);
+		foreach(const QString &audioFile, segment.audioFiles)
+			src.audio.append(new MXF::KlvReader(audioFile));
+		mSources.append(src);
+
+		if (!src.video->isOpen())
+			return fail(QStringLiteral("%1: %2").arg(segment.videoFile, src.video->errorString()));
+		for (int i = 0; i < src.audio.size(); ++i)
+		{
+			if (!src.audio[i]->isOpen())
+				return fail(QStringLiteral("%1: %2").arg(segment.audioFiles[i], src.audio[i]->errorString()));
+		}
+		if (src.audio.size() != mSources.first().audio.size())
+			return fail(QStringLiteral("%1: number of audio channels differs")
+			            .arg(segment.videoFile));
+		if (src.video->essenceElements().isEmpty())
+			return fail(QStringLiteral("%1: no essence").arg(segment.videoFile));
+
+		qint64 available = src.video->editUnitCount();
+		if (!available)
+			return fail(QStringLiteral("%1: no index table").arg(segment.videoFile));
+		src.first = qBound<qint64>(0, segment.firstFrame, available);
+		src.count = available - src.first;
+		if ((segment.frameCount >= 0) && (segment.frameCount < src.count))
+			src.count = segment.frameCount;
+		mSources.last() = src;
+		mDuration += src.count;
+
+		if (sourceContainer(src.video) != sourceContainer(mSources.first().video))
+			return fail(QStringLiteral("%1: essence container differs from the first clip")
+			            .arg(segment.videoFile));
+
+		quint32 eubc = src.video->editUnitByteCount();
+		if (mSources.size() == 1)
+			videoByteCount = eubc;
+		if (!eubc || (eubc != videoByteCount))
+			cbr = false;
+	}
+
+	// the essence layout is taken from the first clip
+	const Source &first = mSources.first();
+	QByteArray key = bytes(first.video->essenceElements().first().klv.key, 16);
+	// DV (SMPTE 383): clip wrapped element 0x02, frame wrapped 0x01
+	if ((uchar(key[12]) != 0x18) || (uchar(key[14]) > 0x02))
+		return fail(QStringLiteral("%1: unsupported video essence").arg(mSegments.first().videoFile));
+	key[13] = 0x01;
+	key[14] = 0x01;
+	key[15] = 0x01;
+	mVideoKey = key;
+
+	mVideoContainer = sourceContainer(first.video);
+	if ((mVideoContainer.size() != 16) || (mVideoContainer[13] != 0x02))
+		return fail(QStringLiteral("%1: unsupported essence container").arg(mSegments.first().videoFile));
+	mVideoContainer[15] = 0x01;
+
+	LocalSet descriptor(setKey(MultipleDescriptorSet));
+	if (!findDescriptor(first.video, pictureDescriptorTypes(), &descriptor))
+		return fail(QStringLiteral("%1: no picture descriptor").arg(mSegments.first().videoFile));
+	mPrimer = first.video->primer();
+
+	for (int i = 0; i < first.audio.size(); ++i)
+	{
+		const QString &fileName = mSegments.first().audioFiles[i];
+		QByteArray container = sourceContainer(first.audio[i]);
+		// BWF (0x01/0x02) or AES3 (0x03/0x04), frame wrapped is the odd one
+		if ((container.size() != 16) || (container[13] != 0x06)
+		        || (container[14] < 0x01) || (container[14] > 0x04))
+			return fail(QStringLiteral("%1: unsupported audio container").arg(fileName));
+		if (!(container[14] & 1))
+			container[14] = container[14] - 1;
+		if (i == 0)
+		{
+			mAudioContainer = container;
+			mAudioElementType = container[14];
+		}
+		else if (container != mAudioContainer)
+		{
+			return fail(QStringLiteral("%1: audio channels use different containers").arg(fileName));
+		}
+
+		if (!findDescriptor(first.audio[i], soundDescriptorTypes(), &descriptor))
+			return fail(QStringLiteral("%1: no sound descriptor").arg(fileName));
+		QByteArray blockAlign = descriptor.value(0x3D0A);
+		QByteArray rate = descriptor.value(0x3D03);
+		AudioTrack track;
+		track.blockAlign = 0;
+		if (blockAlign.size() == 2)
+			track.blockAlign = (uchar(blockAlign[0]) << 8) | uchar(blockAlign[1]);
+		if (!track.blockAlign)
+		{
+			QByteArray bits = descriptor.value(0x3D01);
+			if (bits.size() == 4)
+				track.blockAlign = (uchar(bits[3]) + 7) / 8;
+		}
+		if ((rate.size() != 8) || !track.blockAlign)
+			return fail(QStringLiteral("%1: incomplete sound descriptor").arg(fileName));
+		track.rateNumerator = qint32((uchar(rate[0]) << 24) | (uchar(rate[1]) << 16)
+		                            | (uchar(rate[2]) << 8) | uchar(rate[3]));
+		track.rateDenominator = qint32((uchar(rate[4]) << 24) | (uchar(rate[5]) << 16)
+		                              | (uchar(rate[6]) << 8) | uchar(rate[7]));
+		if ((track.rateNumerator <= 0) || (track.rateDenominator <= 0))
+			return fail(QStringLiteral("%1: invalid sampling rate").arg(fileName));
+		if (mInterleaveAudio && !mAudioTracks.isEmpty()
+		        && ((track.blockAlign != mAudioTracks.first().blockAlign)
+		            || (qint64(track.rateNumerator) * mAudioTracks.first().rateDenominator
+		                != qint64(mAudioTracks.first().rateNumerator) * track.rateDenominator)))
+			return fail(QStringLiteral("%1: channels differ in sample size or rate, "
+			                           "they cannot be interleaved").arg(fileName));
+		mAudioTracks.append(track);
+
+		QMap<quint16, QByteArray> primer = first.audio[i]->primer();
+		for (QMap<quint16, QByteArray>::const_iterator it = primer.constBegin(); it != primer.constEnd(); ++it)
+		{
+			if (!mPrimer.contains(it.key()))
+				mPrimer.insert(it.key(), it.value());
+		}
+	}
+
+	// constant bytes per edit unit if every audio edit unit holds the same
+	// number of samples
+	mEditUnitByteCount = 0;
+	if (cbr)
+	{
+		mEditUnitByteCount = 20 + videoByteCount;
+		for (int i = 0; i < soundTrackCount(); ++i)
+		{
+			const AudioTrack &t = mAudioTracks[i];
+			qint64 num = qint64(t.rateNumerator) * mEditRateDenominator;
+			qint64 den = qint64(t.rateDenominator) * mEditRateNumerator;
+			if (num % den)
+			{
+				mEditUnitByteCount = 0;
+				break;
+			}
+			mEditUnitByteCount += 20 + quint32(num / den) * soundBlockAlign(i);
+		}
+	}
+
+	mPrepared = true;
+	return true;
+}
+
+/** the labels for the preface and the partition packs; a clip without
+ * audio has no sound container */
+QList<QByteArray> Op1aWriter::essenceContainers() const
+{
+	QList<QByteArray> containers;
+	containers << bytes(multipleWrappings, sizeof(multipleWrappings)) << mVideoContainer;
+	if (!mAudioContainer.isEmpty())
+		containers << mAudioContainer;
+	return containers;
+}
+
+QByteArray Op1aWriter::headerMetadata()
+{
+	const Source &first = mSources.first();
+	QDateTime now = QDateTime::currentDateTimeUtc();
+	QByteArray materialPackageId = bytes(umidLabel, sizeof(umidLabel))
+	        + QUuid::createUuid().toRfc4122();
+	QByteArray filePackageId = mSourcePackageId;
+	if (filePackageId.size() != 32)
+		filePackageId = bytes(umidLabel, sizeof(umidLabel)) + QUuid::createUuid().toRfc4122();
+	int roundedBase = (mEditRateNumerator + mEditRateDenominator - 1) / mEditRateDenominator;
+
+	QList<LocalSet> sets;
+
+	// creates component, sequence and track, returns the track's uid
+	struct TrackBuilder {
+		static QByteArray add(QList<LocalSet> *sets, const Op1aWriter *w,
+		                      quint32 trackId, quint32 trackNumber, const LocalSet &component)
+		{
+			LocalSet sequence(setKey(SequenceSet));
+			sequence.set(0x0201, component.value(0x0201));
+			sequence.set64(0x0202, w->mDuration);
+			sequence.setBatch(0x1001, QList<QByteArray>() << component.uid());
+			LocalSet track(setKey(TrackSet));
+			track.set32(0x4801, trackId);
+			track.set32(0x4804, trackNumber);
+			track.setRational(0x4B01, w->mEditRateNumerator, w->mEditRateDenominator);
+			track.set64(0x4B02, 0);
+			track.set(0x4803, sequence.uid());
+			sets->append(component);
+			sets->append(sequence);
+			sets->append(track);
+			return track.uid();
+		}
+	};
+
+	// material package: timecode, picture, sound tracks referencing the file package
+	QList<QByteArray> materialTracks;
+	QList<QByteArray> fileTracks;
+	for (int package = 0; package < 2; ++package)
+	{
+		bool isFilePackage = (package == 1);
+		QList<QByteArray> &tracks = isFilePackage ? fileTracks : materialTracks;
+		QByteArray sourceId = isFilePackage ? QByteArray(32, 0) : filePackageId;
+
+		LocalSet timecode(setKey(TimecodeComponentSet));
+		timecode.setUL(0x0201, timecodeDataDef);
+		timecode.set64(0x0202, mDuration);
+		timecode.set16(0x1502, roundedBase);
+		timecode.set64(0x1501, mStartTimecode);
+		timecode.set8(0x1503, mDropFrame ? 1 : 0);
+		tracks.append(TrackBuilder::add(&sets, this, 1, 0, timecode));
+
+		LocalSet picture(setKey(SourceClipSet));
+		picture.setUL(0x0201, pictureDataDef);
+		picture.set64(0x0202, mDuration);
+		picture.set64(0x1201, 0);
+		picture.set(0x1101, sourceId);
+		picture.set32(0x1102, isFilePackage ? 0 : 2);
+		quint32 videoTrackNumber = (uchar(mVideoKey[12]) << 24) | (uchar(mVideoKey[13]) << 16)
+		        | (uchar(mVideoKey[14]) << 8) | uchar(mVideoKey[15]);
+		tracks.append(TrackBuilder::add(&sets, this, 2,
+		                                isFilePackage ? videoTrackNumber : 0, picture));
+
+		for (int i = 0; i < soundTrackCount(); ++i)
+		{
+			LocalSet sound(setKey(SourceClipSet));
+			sound.setUL(0x0201, soundDataDef);
+			sound.set64(0x0202, mDuration);
+			sound.set64(0x1201, 0);
+			sound.set(0x1101, sourceId);
+			sound.set32(0x1102, isFilePackage ? 0 : 3 + i);
+			quint32 trackNumber = (0x16u << 24) | (quint32(soundTrackCount()) << 16)
+			        | (quint32(mAudioElementType) << 8) | quint32(i + 1);
+			tracks.append(TrackBuilder::add(&sets, this, 3 + i,
+			                                isFilePackage ? trackNumber : 0, sound));
+		}
+	}
+
+	// descriptors, taken over from the OP-Atom files
+	QList<QByteArray> subDescriptors;
+	LocalSet video(setKey(MultipleDescriptorSet));
+	findDescriptor(first.video, pictureDescriptorTypes(), &video);
+	video.remove(0x3F01);
+	video.removeDynamicTags();
+	video.set32(0x3006, 2);
+	video.setRational(0x3001, mEditRateNumerator, mEditRateDenominator);
+	video.set64(0x3002, mDuration);
+	video.set(0x3004, mVideoContainer);
+	sets.append(video);
+	subDescriptors.append(video.uid());
+	for (int i = 0; i < soundTrackCount(); ++i)
+	{
+		LocalSet sound(setKey(MultipleDescriptorSet));
+		findDescriptor(first.audio[i], soundDescriptorTypes(), &sound);
+		sound.remove(0x3F01);
+		sound.removeDynamicTags();
+		if (mInterleaveAudio)
+		{
+			const AudioTrack &t = mAudioTracks[i];
+			sound.set32(0x3D07, mAudioTracks.size());
+			sound.set16(0x3D0A, soundBlockAlign(i));
+			sound.set32(0x3D09, quint32(qint64(t.rateNumerator) * soundBlockAlign(i) / t.rateDenominator));
+			// AES3 channel status and user data are given per channel
+			for (quint16 tag = 0x3D10; tag <= 0x3D13; ++tag)
+				sound.remove(tag);
+		}
+		sound.set32(0x3006, 3 + i);
+		sound.setRational(0x3001, mEditRateNumerator, mEditRateDenominator);
+		sound.set64(0x3002, mDuration);
+		sound.set(0x3004, mAudioContainer);
+		sets.append(sound);
+		subDescriptors.append(sound.uid());
+	}
+	LocalSet multiple(setKey(MultipleDescriptorSet));
+	multiple.setRational(0x3001, mEditRateNumerator, mEditRateDenominator);
+	multiple.set64(0x3002, mDuration);
+	multiple.setUL(0x3004, multipleWrappings);
+	multiple.setBatch(0x3F01, subDescriptors);
+	sets.append(multiple);
+
+	LocalSet materialPackage(setKey(MaterialPackageSet));
+	materialPackage.set(0x4401, materialPackageId);
+	materialPackage.setString(0x4402, mName);
+	materialPackage.setTimestamp(0x4405, now);
+	materialPackage.setTimestamp(0x4404, now);
+	materialPackage.setBatch(0x4403, materialTracks);
+	sets.append(materialPackage);
+
+	LocalSet filePackage(setKey(SourcePackageSet));
+	filePackage.set(0x4401, filePackageId);
+	filePackage.setString(0x4402, mName);
+	filePackage.setTimestamp(0x4405, now);
+	filePackage.setTimestamp(0x4404, now);
+	filePackage.setBatch(0x4403, fileTracks);
+	filePackage.set(0x4701, multiple.uid());
+	sets.append(filePackage);
+
+	LocalSet containerData(setKey(EssenceContainerDataSet));
+	containerData.set(0x2701, filePackageId);
+	containerData.set32(0x3F06, indexSID);
+	containerData.set32(0x3F07, bodySID);
+	sets.append(containerData);
+
+	LocalSet storage(setKey(ContentStorageSet));
+	storage.setBatch(0x1901, QList<QByteArray>() << materialPackage.uid() << filePackage.uid());
+	storage.setBatch(0x1902, QList<QByteArray>() << containerData.uid());
+	sets.append(storage);
+
+	LocalSet identification(setKey(IdentificationSet));
+	identification.set(0x3C09, QUuid::createUuid().toRfc4122());
+	identification.setString(0x3C01, QStringLiteral("mxf-tools"));
+	identification.setString(0x3C02, QStringLiteral("mergeMXF"));
+	identification.setString(0x3C04, QStringLiteral("1.0"));
+	identification.setUL(0x3C05, productUid);
+	identification.setTimestamp(0x3C06, now);
+	sets.append(identification);
+
+	LocalSet preface(setKey(PrefaceSet));
+	preface.setTimestamp(0x3B02, now);
+	preface.set16(0x3B05, 0x0102);
+	preface.setBatch(0x3B06, QList<QByteArray>() << identification.uid());
+	preface.set(0x3B03, storage.uid());
+	preface.setUL(0x3B09, op1a);
+	preface.setBatch(0x3B0A, essenceContainers());
+	preface.setBatch(0x3B0B, QList<QByteArray>());
+
+	// preface first, the order of the other sets does not matter
+	QByteArray metadata = preface.toKlv();
+	QMap<quint16, QByteArray> primer;
+	QList<LocalSet> all = QList<LocalSet>() << preface;
+	all.append(sets);
+	for (uint i = 0; i < sizeof(defaultPrimer) / sizeof(defaultPrimer[0]); ++i)
+	{
+		if (!mPrimer.contains(defaultPrimer[i].tag))
+			mPrimer.insert(defaultPrimer[i].tag, bytes(defaultPrimer[i].ul, 16));
+	}
+	foreach(const LocalSet &set, all)
+	{
+		foreach(quint16 tag, set.tags())
+		{
+			if (mPrimer.contains(tag))
+				primer.insert(tag, mPrimer.value(tag));
+			else
+				qWarning() << "MXF: no primer entry for local tag" << hex << tag;
+		}
+	}
+	foreach(const LocalSet &set, sets)
+		metadata.append(set.toKlv());
+
+	QByteArray primerValue;
+	put32(primerValue, primer.size());
+	put32(primerValue, 18);
+	for (QMap<quint16, QByteArray>::const_iterator it = primer.constBegin(); it != primer.constEnd(); ++it)
+	{
+		put16(primerValue, it.key());
+		primerValue.append(it.value());
+	}
+	QByteArray primerKey = bytes(partitionPrefix, sizeof(partitionPrefix));
+	put8(primerKey, 0x05);
+	put8(primerKey, 0x01);
+	put8(primerKey, 0x00);
+	return klv(primerKey, primerValue) + metadata;
+}
+
+QByteArray Op1aWriter::indexSegment(const QVector<quint64> &offsets, quint32 editUnitByteCount) const
+{
+	QByteArray segments;
+	qint64 start = 0;
+	do
+	{
+		LocalSet s(bytes(indexSegmentKey, sizeof(indexSegmentKey)));
+		s.setRational(0x3F0B, mEditRateNumerator, mEditRateDenominator);
+		s.set64(0x3F0C, start);
+		s.set32(0x3F05, editUnitByteCount);
+		s.set32(0x3F06, indexSID);
+		s.set32(0x3F07, bodySID);
+		s.set8(0x3F08, 0);
+		if (editUnitByteCount)
+		{
+			s.set64(0x3F0D, mDuration);
+			// position of the elements within the content package
+			QByteArray deltas;
+			put32(deltas, 1 + soundTrackCount());
+			put32(deltas, 6);
+			quint32 delta = 0;
+			put8(deltas, 0);
+			put8(deltas, 0);
+			put32(deltas, delta);
+			delta += 20 + quint32(mSources.first().video->editUnitByteCount());
+			for (int i = 0; i < soundTrackCount(); ++i)
+			{
+				put8(deltas, 0);
+				put8(deltas, 0);
+				put32(deltas, delta);
+				const AudioTrack &t = mAudioTracks[i];
+				delta += 20 + quint32(qint64(t.rateNumerator) * mEditRateDenominator
+				                      / (qint64(t.rateDenominator) * mEditRateNumerator))
+				        * soundBlockAlign(i);
+			}
+			s.set(0x3F09, deltas);
+			start = mDuration;
+		}
+		else
+		{
+			qint64 count = qMin<qint64>(offsets.size() - start, maxIndexEntriesPerSegment);
+			s.set64(0x3F0D, count);
+			QByteArray entries;
+			put32(entries, count);
+			put32(entries, 11);
+			for (qint64 i = start; i < start + count; ++i)
+			{
+				put8(entries, 0);       // temporal offset
+				put8(entries, 0);       // key frame offset
+				put8(entries, 0x80);    // random access
+				put64(entries, offsets[i]);
+			}
+			s.set(0x3F0A, entries);
+			start += count;
+		}
+		segments.append(s.toKlv());
+	} while (start < offsets.size());
+	return segments;
+}
+
+/** one sound element with the samples of all channels of a frame */
+bool Op1aWriter::writeInterleavedAudio(EssenceCopier &out, const Source &src, qint64 frame,
+                                       const QByteArray &key, quint64 *stream)
+{
+	const int channels = src.audio.size();
+	const quint32 align = mAudioTracks.first().blockAlign;
+	qint64 s0 = audioSample(0, frame);
+	qint64 samples = audioSample(0, frame + 1) - s0;
+	qint64 size = samples * align;
+
+	if (out.cancelled())
+		return fail(out.errorString());
+	QVarLengthArray<const uchar*, 16> in(channels);
+	QList<QByteArray> samplesIn;
+	for (int i = 0; i < channels; ++i)
+	{
+		// audio may end a bit before the video does, the rest stays silent
+		samplesIn.append(QByteArray(int(size), 0));
+		MXF::Span data = src.audio[i]->essence().mid(s0 * align, size);
+		if (!data.isNull() && data.size
+		        && (readAt(src.audio[i]->handle(), reinterpret_cast<uchar*>(samplesIn.last().data()),
+		                   data.size, src.audio[i]->fileOffset(data)) < 0))
+			return fail(QStringLiteral("%1: %2").arg(src.audio[i]->fileName(),
+			                                         QString::fromLocal8Bit(strerror(errno))));
+		in[i] = reinterpret_cast<const uchar*>(samplesIn.last().constData());
+	}
+
+	QByteArray header = key;
+	putBer4(header, size * channels);
+	uchar *element = 0;
+	if (!out.append(header) || !(element = out.reserve(int(size * channels))))
+		return fail(out.errorString());
+	MXF::interleavePcm(in.constData(), channels, align, samples, element);
+	*stream += header.size() + size * channels;
+	return true;
+}
+
+bool Op1aWriter::writeEssence(int fd, QVector<quint64> *offsets)
+{
+	EssenceCopier out(fd, mZeroCopy, mCancel);
+	quint64 stream = 0;
+	QList<QByteArray> audioKeys;
+	for (int i = 0; i < soundTrackCount(); ++i)
+	{
+		QByteArray key = mVideoKey;
+		key[12] = 0x16;
+		key[13] = char(soundTrackCount());
+		key[14] = char(mAudioElementType);
+		key[15] = char(i + 1);
+		audioKeys.append(key);
+	}
+
+	foreach(const Source &src, mSources)
+	{
+		adviseSequential(src.video);
+		foreach(const MXF::KlvReader *audio, src.audio)
+			adviseSequential(audio);
+
+		for (qint64 frame = src.first; frame < src.first + src.count; ++frame)
+		{
+			if ((frame - src.first) % readAheadEditUnits == 0)
+			{
+				qint64 n = qMin<qint64>(readAheadEditUnits, src.first + src.count - frame);
+				willNeed(src.video, src.video->editUnits(frame, n));
+				for (int i = 0; i < src.audio.size(); ++i)
+				{
+					qint64 s0 = audioSample(i, frame);
+					qint64 s1 = audioSample(i, frame + n);
+					quint32 align = mAudioTracks[i].blockAlign;
+					willNeed(src.audio[i], src.audio[i]->essence().mid(s0 * align, (s1 - s0) * align));
+				}
+			}
+
+			if (offsets)
+				offsets->append(stream);
+			MXF::Span video = src.video->editUnits(frame);
+			if (video.isNull())
+				return fail(QStringLiteral("%1: frame %2 missing")
+				            .arg(src.video->fileName()).arg(frame));
+			QByteArray header = mVideoKey;
+			putBer4(header, video.size);
+			if (!out.append(header) || !out.append(video, src.video->handle(), src.video->fileOffset(video)))
+				return fail(out.errorString());
+			stream += header.size() + video.size;
+
+			if (mInterleaveAudio && !src.audio.isEmpty())
+			{
+				if (!writeInterleavedAudio(out, src, frame, audioKeys.first(), &stream))
+					return false;
+				mBytesWritten.store(out.written());
+				continue;
+			}
+			for (int i = 0; i < src.audio.size(); ++i)
+			{
+				quint32 align = mAudioTracks[i].blockAlign;
+				qint64 s0 = audioSample(i, frame);
+				qint64 size = (audioSample(i, frame + 1) - s0) * align;
+				MXF::Span samples = src.audio[i]->essence().mid(s0 * align, size);
+				header = audioKeys[i];
+				putBer4(header, size);
+				if (!out.append(header))
+					return fail(out.errorString());
+				if (!samples.isNull() && samples.size
+				        && !out.append(samples, src.audio[i]->handle(), src.audio[i]->fileOffset(samples)))
+					return fail(out.errorString());
+				// audio may end a bit before the video does
+				if (!out.appendSilence(size - (samples.isNull() ? 0 : samples.size)))
+					return fail(out.errorString());
+				stream += header.size() + size;
+			}
+			mBytesWritten.store(out.written());
+		}
+	}
+	if (!out.flush())
+		return fail(out.errorString());
+	mBytesWritten.store(out.written());
+	return true;
+}
+
+bool Op1aWriter::write(const QString &fileName)
+{
+	if (!mPrepared && !prepare())
+		return false;
+	mBytesWritten.store(0);
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+		return fail(QStringLiteral("%1: %2").arg(fileName, file.errorString()));
+	int fd = file.handle();
+
+	QList<QByteArray> containers = essenceContainers();
+
+	// header and body partition are rewritten with the footer position at the end
+	QByteArray metadata = headerMetadata();
+	QByteArray header = partitionPack(0x02, 0x01, 0, 0, 0, metadata.size(), 0, 0, 0, containers);
+	quint64 bodyPartition = header.size() + metadata.size();
+	QByteArray body = partitionPack(0x03, 0x04, bodyPartition, 0, 0, 0, 0, 0, bodySID, containers);
+	bool ok = (file.write(header) == header.size())
+	        && (file.write(metadata) == metadata.size())
+	        && (file.write(body) == body.size());
+	if (!ok)
+	{
+		fail(QStringLiteral("%1: %2").arg(fileName, file.errorString()));
+		file.remove();
+		return false;
+	}
+
+	QVector<quint64> offsets;
+	if (!writeEssence(fd, mEditUnitByteCount ? 0 : &offsets))
+	{
+		file.remove();
+		return false;
+	}
+
+	quint64 footerPartition = bodyPartition + body.size() + mBytesWritten.load();
+	QByteArray index = indexSegment(offsets, mEditUnitByteCount);
+	QByteArray footer = partitionPack(0x04, 0x04, footerPartition, bodyPartition,
+	                                  footerPartition, 0, index.size(), indexSID, 0, containers);
+
+	QByteArray rip;
+	put32(rip, 0);
+	put64(rip, 0);
+	put32(rip, bodySID);
+	put64(rip, bodyPartition);
+	put32(rip, 0);
+	put64(rip, footerPartition);
+	put32(rip, 16 + 4 + rip.size() + 4);
+	QByteArray ripKey = bytes(partitionPrefix, sizeof(partitionPrefix));
+	put8(ripKey, 0x11);
+	put8(ripKey, 0x01);
+	put8(ripKey, 0x00);
+
+	QByteArray tail = footer + index + klv(ripKey, rip);
+	header = partitionPack(0x02, 0x04, 0, 0, footerPartition, metadata.size(), 0, 0, 0, containers);
+	body = partitionPack(0x03, 0x04, bodyPartition, 0, footerPartition, 0, 0, 0, bodySID, containers);
+	ok = file.seek(footerPartition) && (file.write(tail) == tail.size())
+	        && file.seek(0) && (file.write(header) == header.size())
+	        && file.seek(bodyPartition) && (file.write(body) == body.size());
+	if (!ok)
+	{
+		fail(QStringLiteral("%1: %2").arg(fileName, file.errorString()));
+		file.remove();
+		return false;
+	}
+	file.close();
+	closeSources();
+	mPrepared = false;
+	return true;
+}
+
+bool RewrapTask::run()
+{
+	return mWriter.write(mOutput);
+}
+
+QString RewrapTask::errorString() const
+{
+	return mWriter.errorString();
+}
+
+qint64 RewrapTask::bytesDone() const
+{
+	return mWriter.bytesWritten();
+}
@@ -0,0 +1,140 @@
+#ifndef OP1AWRITER_H
+#define OP1AWRITER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QVector>
+#include <QAtomicInteger>
+#include <QAtomicInt>
+#include "jobscheduler.h"
+
+namespace MXF {
+class KlvReader;
+}
+
+/** a range of edit units taken from the essence files of one clip */
+struct RewrapSegment
+{
+	RewrapSegment() : firstFrame(0), frameCount(-1) {}
+	QString videoFile;
+	QStringList audioFiles;
+	qint64 firstFrame;
+	qint64 frameCount;      ///< -1: up to the end of the clip
+};
+
+/**
+ * Rewraps the OP-Atom essence files of P2 clips into a single OP1a file:
+ * header partition with the structural metadata, one body partition with
+ * frame wrapped, interleaved video and audio elements and a footer partition
+ * with the index table. The picture and sound descriptors are taken over
+ * from the source files.
+ */
+class Op1aWriter
+{
+public:
+	Op1aWriter();
+	~Op1aWriter();
+
+	void setEditRate(int numerator, int denominator);
+	/** start timecode in frames at the rounded timecode base; dropFrame
+	 * marks 29.97/59.94 drop frame counting */
+	void setStartTimecode(qint64 frames, bool dropFrame = false);
+	/** UMID of the file package, e.g. the clip's GlobalClipID */
+	void setSourcePackageId(const QByteArray &umid);
+	void setName(const QString &name);
+	/** use copy_file_range() for the essence payload if the kernel allows it */
+	void setZeroCopy(bool enabled);
+	/** write one sound track with all audio channels interleaved instead of
+	 * one mono track per channel. The channels need the same sample size */
+	void setInterleavedAudio(bool enabled);
+	/** flag set from another thread to stop write() at the next essence
+	 * element. Not owned */
+	void setCancelFlag(const QAtomicInt *cancel);
+
+	void addSegment(const RewrapSegment &segment);
+
+	/** opens all sources and checks they can be written into one file */
+	bool prepare();
+	bool write(const QString &fileName);
+	QString errorString() const;
+
+	qint64 duration() const;
+	/** essence bytes written so far, may be called from another thread
+	 * while write() runs */
+	qint64 bytesWritten() const;
+
+private:
+	class EssenceCopier;
+
+	struct Source
+	{
+		Source() : video(0), first(0), count(0) {}
+		MXF::KlvReader *video;
+		QList<MXF::KlvReader*> audio;
+		qint64 first;
+		qint64 count;
+	};
+
+	struct AudioTrack
+	{
+		quint32 blockAlign;
+		qint32 rateNumerator;
+		qint32 rateDenominator;
+	};
+
+	bool fail(const QString &message);
+	void closeSources();
+	qint64 audioSample(int track, qint64 editUnit) const;
+	int soundTrackCount() const;
+	quint32 soundBlockAlign(int track) const;
+	QList<QByteArray> essenceContainers() const;
+	QByteArray headerMetadata();
+	QByteArray indexSegment(const QVector<quint64> &offsets, quint32 editUnitByteCount) const;
+	bool writeEssence(int fd, QVector<quint64> *offsets);
+	bool writeInterleavedAudio(EssenceCopier &out, const Source &src, qint64 frame,
+	                           const QByteArray &key, quint64 *stream);
+
+	QList<RewrapSegment> mSegments;
+	QList<Source> mSources;
+	QList<AudioTrack> mAudioTracks;
+	qint32 mEditRateNumerator;
+	qint32 mEditRateDenominator;
+	qint64 mStartTimecode;
+	bool mDropFrame;
+	qint64 mDuration;
+	QByteArray mSourcePackageId;
+	QString mName;
+	bool mZeroCopy;
+	bool mInterleaveAudio;
+	bool mPrepared;
+	const QAtomicInt *mCancel;
+	QString mError;
+	QAtomicInteger<qint64> mBytesWritten;
+
+	QByteArray mVideoKey;
+	QByteArray mVideoContainer;
+	QByteArray mAudioContainer;
+	quint8 mAudioElementType;
+	quint32 mEditUnitByteCount;     ///< 0 if the edit units vary in size
+	QMap<quint16, QByteArray> mPrimer;
+};
+
+/** rewraps one clip from a JobScheduler pool thread */
+class RewrapTask : public NativeTask
+{
+public:
+	explicit RewrapTask(const QString &output) : mOutput(output) { mWriter.setCancelFlag(&mCancelled); }
+	Op1aWriter &writer() { return mWriter; }
+	bool run();
+	QString errorString() const;
+	qint64 bytesDone() const;
+
+private:
+	Op1aWriter mWriter;
+	QString mOutput;
+};
+
+#endif // OP1AWRITER_H
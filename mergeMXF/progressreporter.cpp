@@ -0,0 +1,218 @@
+#include "progressreporter.h"
+#include <QJsonDocument>
+#include <QFileDevice>
+#include <QDebug>
+
+/// weight of the newest sample in the smoothed rates
+static const double rateSmoothing = 0.3;
+
+static const char *stateName(JobProgress::State state)
+{
+	switch (state)
+	{
+	case JobProgress::Queued:
+		return "queued";
+	case JobProgress::Running:
+		return "running";
+	case JobProgress::Succeeded:
+		return "succeeded";
+	case JobProgress::Failed:
+		return "failed";
+	}
+	return "";
+}
+
+/** h:mm:ss or m:ss, "?" if unknown */
+static QString formatSeconds(double seconds)
+{
+	if (seconds < 0)
+		return QStringLiteral("?");
+	qint64 s = qRound64(seconds);
+	if (s >= 3600)
+		return QString().sprintf("%lld:%02lld:%02lld", s / 3600, (s / 60) % 60, s % 60);
+	return QString().sprintf("%lld:%02lld", s / 60, s % 60);
+}
+
+static double megabytes(double bytes)
+{
+	return bytes / (1024 * 1024);
+}
+
+/** seconds until remaining bytes are done at rate, -1 if unknown */
+static double eta(qint64 remaining, double bytesPerSecond)
+{
+	if (bytesPerSecond <= 0)
+		return -1;
+	return remaining / bytesPerSecond;
+}
+
+ProgressReporter::ProgressReporter(JobScheduler *scheduler, QObject *parent) :
+    QObject(parent),
+    mScheduler(scheduler),
+    mPrinting(true),
+    mJson(0)
+{
+	mTimer.setInterval(5000);
+	connect(&mTimer, SIGNAL(timeout()), this, SLOT(report()));
+	connect(scheduler, SIGNAL(jobStarted(ConvertJob)), this, SLOT(jobStarted()));
+	connect(scheduler, SIGNAL(jobFinished(JobResult)), this, SLOT(jobFinished(JobResult)));
+	connect(scheduler, SIGNAL(allFinished()), this, SLOT(allFinished()));
+}
+
+void ProgressReporter::setInterval(int msecs)
+{
+	mTimer.setInterval(qMax(100, msecs));
+}
+
+void ProgressReporter::setPrinting(bool enabled)
+{
+	mPrinting = enabled;
+}
+
+void ProgressReporter::setJsonOutput(QIODevice *device)
+{
+	mJson = device;
+}
+
+void ProgressReporter::jobStarted()
+{
+	if (!mTimer.isActive() && (mPrinting || mJson))
+		mTimer.start();
+}
+
+void ProgressReporter::jobFinished(const JobResult &result)
+{
+	mRates.remove(result.job.name);
+	if (!mJson)
+		return;
+	QJsonObject o;
+	o["event"] = QStringLiteral("finished");
+	o["elapsed"] = mScheduler->elapsed();
+	o["name"] = result.job.name;
+	o["card"] = result.job.card;
+	o["succeeded"] = result.succeeded();
+	o["size"] = result.job.dataSize;
+	o["msecs"] = result.msecs;
+	if (result.msecs > 0)
+		o["rate"] = result.job.dataSize * 1000.0 / result.msecs;
+	writeJson(o);
+}
+
+void ProgressReporter::allFinished()
+{
+	mTimer.stop();
+	mRates.clear();
+}
+
+void ProgressReporter::report()
+{
+	struct CardTotal
+	{
+		CardTotal() : jobs(0), done(0), running(0), bytes(0), size(0), rate(0) {}
+		int jobs;
+		int done;
+		int running;
+		qint64 bytes;
+		qint64 size;
+		double rate;
+		QStringList lines;   ///< one per running job
+	};
+	QMap<QString, CardTotal> cards;
+	qint64 elapsed = mScheduler->elapsed();
+
+	foreach(const JobProgress &p, mScheduler->progress())
+	{
+		CardTotal &card = cards[p.card];
+		card.jobs++;
+		card.size += p.dataSize;
+		if (p.state == JobProgress::Succeeded || p.state == JobProgress::Failed)
+			card.done++;
+		if (p.bytesDone > 0)
+			card.bytes += p.bytesDone;
+		if (p.state != JobProgress::Running)
+			continue;
+		card.running++;
+
+		// ffmpeg may not have reported anything yet
+		if (p.bytesDone < 0)
+		{
+			card.lines << QStringLiteral("  %1 running for %2").arg(p.name, formatSeconds(p.msecs / 1000.0));
+			continue;
+		}
+		Rate &rate = mRates[p.name];
+		if (p.msecs > rate.msecs)
+		{
+			double current = (p.bytesDone - rate.bytes) * 1000.0 / (p.msecs - rate.msecs);
+			rate.bytesPerSecond = rate.msecs ? (rateSmoothing * current + (1 - rateSmoothing) * rate.bytesPerSecond)
+			                                 : current;
+			rate.bytes = p.bytesDone;
+			rate.msecs = p.msecs;
+		}
+		card.rate += rate.bytesPerSecond;
+		double left = eta(p.dataSize - p.bytesDone, rate.bytesPerSecond);
+		int percent = p.dataSize ? int(p.bytesDone * 100 / p.dataSize) : 0;
+		card.lines << QStringLiteral("  %1 %2%, %3 MB/s, ETA %4")
+		            .arg(p.name).arg(percent)
+		            .arg(megabytes(rate.bytesPerSecond), 0, 'f', 1)
+		            .arg(formatSeconds(left));
+
+		if (mJson)
+		{
+			QJsonObject o;
+			o["event"] = QStringLiteral("job");
+			o["elapsed"] = elapsed;
+			o["name"] = p.name;
+			o["card"] = p.card;
+			o["state"] = QString::fromLatin1(stateName(p.state));
+			o["bytes"] = p.bytesDone;
+			o["size"] = p.dataSize;
+			o["rate"] = rate.bytesPerSecond;
+			o["eta"] = left;
+			writeJson(o);
+		}
+	}
+
+	for (QMap<QString, CardTotal>::const_iterator it = cards.constBegin(); it != cards.constEnd(); ++it)
+	{
+		const CardTotal &card = it.value();
+		if (!card.running)
+			continue;
+		double left = eta(card.size - card.bytes, card.rate);
+		if (mPrinting)
+		{
+			qInfo().noquote() << QStringLiteral("%1: %2/%3 jobs done, %4 running, %5 of %6 MB, %7 MB/s, ETA %8")
+			                     .arg(it.key().isEmpty() ? QStringLiteral("(no card)") : it.key())
+			                     .arg(card.done).arg(card.jobs).arg(card.running)
+			                     .arg(megabytes(card.bytes), 0, 'f', 0)
+			                     .arg(megabytes(card.size), 0, 'f', 0)
+			                     .arg(megabytes(card.rate), 0, 'f', 1)
+			                     .arg(formatSeconds(left));
+			foreach(const QString &line, card.lines)
+				qInfo().noquote() << line;
+		}
+		if (mJson)
+		{
+			QJsonObject o;
+			o["event"] = QStringLiteral("card");
+			o["elapsed"] = elapsed;
+			o["card"] = it.key();
+			o["jobs"] = card.jobs;
+			o["done"] = card.done;
+			o["running"] = card.running;
+			o["bytes"] = card.bytes;
+			o["size"] = card.size;
+			o["rate"] = card.rate;
+			o["eta"] = left;
+			writeJson(o);
+		}
+	}
+}
+
+void ProgressReporter::writeJson(const QJsonObject &object)
+{
+	mJson->write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+	mJson->write("\n");
+	// readers follow the stream while the run is going
+	if (QFileDevice *file = qobject_cast<QFileDevice*>(mJson))
+		file->flush();
+}
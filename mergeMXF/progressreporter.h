@@ -0,0 +1,56 @@
+#ifndef PROGRESSREPORTER_H
+#define PROGRESSREPORTER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMap>
+#include <QIODevice>
+#include <QJsonObject>
+#include "jobscheduler.h"
+
+/**
+ * Samples the progress of a JobScheduler run at a fixed interval. For every
+ * running job the share of its dataSize done, the rate and the time left
+ * are printed, and the same summed up per card, so a slow reader or disk
+ * shows up while the run is going. The samples can also be written as JSON
+ * lines to a device for monitoring tools.
+ */
+class ProgressReporter : public QObject
+{
+	Q_OBJECT
+public:
+	explicit ProgressReporter(JobScheduler *scheduler, QObject *parent = 0);
+
+	void setInterval(int msecs);
+	/** print to the terminal, default true */
+	void setPrinting(bool enabled);
+	/** one JSON object per line, not owned. 0 to disable */
+	void setJsonOutput(QIODevice *device);
+
+public slots:
+	void report();
+
+private slots:
+	void jobStarted();
+	void jobFinished(const JobResult &result);
+	void allFinished();
+
+private:
+	struct Rate
+	{
+		Rate() : bytes(0), msecs(0), bytesPerSecond(0) {}
+		qint64 bytes;
+		qint64 msecs;
+		double bytesPerSecond;
+	};
+
+	void writeJson(const QJsonObject &object);
+
+	JobScheduler *mScheduler;
+	QTimer mTimer;
+	bool mPrinting;
+	QIODevice *mJson;
+	QMap<QString, Rate> mRates;   ///< job name -> last sample
+};
+
+#endif // PROGRESSREPORTER_H
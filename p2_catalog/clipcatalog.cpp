@@ -0,0 +1,370 @@
+#include "clipcatalog.h"
+#include "mxfmeta.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QStandardPaths>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QHash>
+
+static const int schemaVersion = 1;
+
+ClipCatalog::ClipCatalog(const QString &fileName) :
+    mFileName(fileName),
+    mConnection(QStringLiteral("catalog_%1").arg(quintptr(this)))
+{
+}
+
+ClipCatalog::~ClipCatalog()
+{
+	if (mDb.isValid())
+	{
+		mDb.close();
+		mDb = QSqlDatabase();
+		QSqlDatabase::removeDatabase(mConnection);
+	}
+}
+
+QString ClipCatalog::defaultLocation()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+	        + "/p2_catalog/catalog.sqlite";
+}
+
+QString ClipCatalog::errorString() const
+{
+	return mError;
+}
+
+bool ClipCatalog::fail(const QSqlQuery &query)
+{
+	mError = QStringLiteral("%1: %2").arg(mFileName, query.lastError().text());
+	return false;
+}
+
+bool ClipCatalog::exec(const QString &statement)
+{
+	QSqlQuery query(mDb);
+	if (!query.exec(statement))
+		return fail(query);
+	return true;
+}
+
+bool ClipCatalog::open()
+{
+	QDir().mkpath(QFileInfo(mFileName).path());
+	mDb = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), mConnection);
+	mDb.setDatabaseName(mFileName);
+	if (!mDb.open())
+	{
+		mError = QStringLiteral("%1: %2").arg(mFileName, mDb.lastError().text());
+		return false;
+	}
+	// one writer, many readers; a lost update is redone on the next run
+	if (!exec("PRAGMA journal_mode=WAL") || !exec("PRAGMA synchronous=NORMAL"))
+		return false;
+
+	QSqlQuery version(mDb);
+	if (!version.exec("PRAGMA user_version") || !version.next())
+		return fail(version);
+	if (version.value(0).toInt() == schemaVersion)
+		return true;
+	version.finish();
+
+	// all or nothing, a run that dies here leaves the catalog as it was
+	if (!mDb.transaction())
+	{
+		mError = QStringLiteral("%1: %2").arg(mFileName, mDb.lastError().text());
+		return false;
+	}
+	// the catalog is only a cache of the cards, rebuild it; the drop also
+	// clears a table left by a run that died before this was transactional
+	bool ok = exec("DROP TABLE IF EXISTS clips")
+	        && exec("CREATE TABLE clips ("
+	            " card_root TEXT NOT NULL,"
+	            " card_id TEXT NOT NULL,"
+	            " xml_file TEXT NOT NULL,"
+	            " xml_size INTEGER NOT NULL,"
+	            " xml_modified INTEGER NOT NULL,"
+	            " clip_name TEXT,"
+	            " global_clip_id TEXT,"
+	            " global_shot_id TEXT,"
+	            " shoot_start INTEGER,"  // msecs since epoch
+	            " shoot_end INTEGER,"
+	            " shoot_offset INTEGER," // utc offset of the camera clock, seconds
+	            " shoot_date TEXT,"      // yyyy-MM-dd in camera time
+	            " duration INTEGER,"
+	            " frame_rate REAL,"
+	            " codec TEXT,"
+	            " manufacturer TEXT,"
+	            " serial_no TEXT,"
+	            " model_name TEXT,"
+	            " video_file TEXT,"
+	            " video_size INTEGER,"
+	            " audio_files TEXT,"     // '\\n' separated
+	            " audio_size INTEGER,"
+	            " PRIMARY KEY (card_root, xml_file))")
+	        && exec("CREATE INDEX clips_start ON clips (shoot_start)")
+	        && exec("CREATE INDEX clips_date ON clips (shoot_date)")
+	        && exec("CREATE INDEX clips_serial ON clips (serial_no)")
+	        && exec("CREATE INDEX clips_shot ON clips (global_shot_id)")
+	        && exec("CREATE INDEX clips_clip ON clips (global_clip_id)")
+	        && exec("CREATE INDEX clips_card ON clips (card_id)")
+	        && exec(QStringLiteral("PRAGMA user_version=%1").arg(schemaVersion));
+	if (!ok)
+	{
+		mDb.rollback();
+		return false;
+	}
+	if (!mDb.commit())
+	{
+		mError = QStringLiteral("%1: %2").arg(mFileName, mDb.lastError().text());
+		return false;
+	}
+	return true;
+}
+
+int ClipCatalog::updateCard(const MXF::Card &card)
+{
+	// what the catalog knows about this card: xml file -> size and mtime
+	QHash<QString, QPair<qint64, qint64> > known;
+	QSqlQuery select(mDb);
+	select.prepare("SELECT xml_file, xml_size, xml_modified FROM clips WHERE card_root = ?");
+	select.addBindValue(card.root);
+	if (!select.exec())
+	{
+		fail(select);
+		return -1;
+	}
+	while (select.next())
+		known.insert(select.value(0).toString(),
+		             qMakePair(select.value(1).toLongLong(), select.value(2).toLongLong()));
+
+	if (!mDb.transaction())
+	{
+		mError = QStringLiteral("%1: %2").arg(mFileName, mDb.lastError().text());
+		return -1;
+	}
+	QSqlQuery insert(mDb);
+	insert.prepare("INSERT OR REPLACE INTO clips VALUES"
+	               " (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+	int parsed = 0;
+	foreach(const MXF::CardFile &file, card.clips)
+	{
+		if (known.contains(file.name))
+		{
+			QPair<qint64, qint64> stamp = known.take(file.name);
+			if (stamp.first == file.size && stamp.second == file.modified)
+				continue;
+		}
+		QFile xml(card.contents() + "CLIP/" + file.name);
+		if (!xml.open(QIODevice::ReadOnly))
+			continue;
+		MXF::ClipInfo clip(xml.readAll());
+		parsed++;
+
+		QString clipName = clip.clipName();
+		QString videoFile = clipName + "." + clip.videoEssence().videoFormat();
+		const MXF::CardFile *video = MXF::Card::find(card.video, videoFile);
+		QStringList audioFiles;
+		qint64 audioSize = 0;
+		const QVector<MXF::AudioInfo> &audio = clip.audioEssences();
+		for (int i = 0; i < audio.size(); ++i)
+		{
+			QString name = clipName + QString().sprintf("%02x.", i) + audio[i].audioFormat();
+			audioFiles.append(card.contents() + "AUDIO/" + name);
+			if (const MXF::CardFile *f = MXF::Card::find(card.audio, name))
+				audioSize += f->size;
+		}
+		const MXF::ClipMetaData &meta = clip.metaData();
+		MXF::EditUnit unit = clip.editUnit();
+
+		insert.addBindValue(card.root);
+		insert.addBindValue(card.id);
+		insert.addBindValue(file.name);
+		insert.addBindValue(file.size);
+		insert.addBindValue(file.modified);
+		insert.addBindValue(clipName);
+		insert.addBindValue(clip.globalClipID());
+		insert.addBindValue(clip.relation().globalShotId);
+		insert.addBindValue(meta.shootStart().isValid() ? QVariant(meta.shootStart().toMSecsSinceEpoch()) : QVariant());
+		insert.addBindValue(meta.shootEnd().isValid() ? QVariant(meta.shootEnd().toMSecsSinceEpoch()) : QVariant());
+		insert.addBindValue(meta.shootStart().offsetFromUtc());
+		insert.addBindValue(meta.shootStart().date().toString(Qt::ISODate));
+		insert.addBindValue(clip.duration());
+		insert.addBindValue(unit.numerator ? double(unit.denominator) / unit.numerator : 0.0);
+		insert.addBindValue(clip.videoEssence().codec());
+		insert.addBindValue(meta.device().manufacturer);
+		insert.addBindValue(meta.device().serialNo);
+		insert.addBindValue(meta.device().modelName);
+		insert.addBindValue(card.contents() + "VIDEO/" + videoFile);
+		insert.addBindValue(video ? video->size : 0);
+		insert.addBindValue(audioFiles.join('\n'));
+		insert.addBindValue(audioSize);
+		if (!insert.exec())
+		{
+			fail(insert);
+			mDb.rollback();
+			return -1;
+		}
+	}
+
+	// whatever is left in known was deleted from the card
+	QSqlQuery remove(mDb);
+	remove.prepare("DELETE FROM clips WHERE card_root = ? AND xml_file = ?");
+	for (QHash<QString, QPair<qint64, qint64> >::const_iterator it = known.constBegin(); it != known.constEnd(); ++it)
+	{
+		remove.addBindValue(card.root);
+		remove.addBindValue(it.key());
+		if (!remove.exec())
+		{
+			fail(remove);
+			mDb.rollback();
+			return -1;
+		}
+	}
+	if (!mDb.commit())
+	{
+		mError = QStringLiteral("%1: %2").arg(mFileName, mDb.lastError().text());
+		return -1;
+	}
+	return parsed;
+}
+
+int ClipCatalog::prune()
+{
+	QSqlQuery roots(mDb);
+	if (!roots.exec("SELECT DISTINCT card_root FROM clips"))
+	{
+		fail(roots);
+		return -1;
+	}
+	QStringList gone;
+	while (roots.next())
+	{
+		QString root = roots.value(0).toString();
+		if (!QFileInfo(root + "/CONTENTS").isDir())
+			gone.append(root);
+	}
+	int dropped = 0;
+	QSqlQuery remove(mDb);
+	remove.prepare("DELETE FROM clips WHERE card_root = ?");
+	foreach(const QString &root, gone)
+	{
+		remove.addBindValue(root);
+		if (!remove.exec())
+		{
+			fail(remove);
+			return -1;
+		}
+		dropped += remove.numRowsAffected();
+	}
+	return dropped;
+}
+
+int ClipCatalog::clipCount()
+{
+	QSqlQuery count(mDb);
+	if (!count.exec("SELECT COUNT(*) FROM clips") || !count.next())
+	{
+		fail(count);
+		return -1;
+	}
+	return count.value(0).toInt();
+}
+
+QList<ClipCatalog::Entry> ClipCatalog::find(const Query &query)
+{
+	mError.clear();
+	QList<Entry> entries;
+	QStringList where;
+	QVariantList values;
+	if (query.date.isValid())
+	{
+		where << "shoot_date = ?";
+		values << query.date.toString(Qt::ISODate);
+	}
+	if (query.from.isValid())
+	{
+		where << "shoot_start >= ?";
+		values << query.from.toMSecsSinceEpoch();
+	}
+	if (query.to.isValid())
+	{
+		where << "shoot_start < ?";
+		values << query.to.toMSecsSinceEpoch();
+	}
+	if (!query.device.isEmpty())
+	{
+		where << "serial_no = ?";
+		values << query.device;
+	}
+	if (!query.model.isEmpty())
+	{
+		// a substring can't use an index, on its own this is a scan
+		where << "model_name LIKE ?";
+		values << "%" + query.model + "%";
+	}
+	if (!query.shot.isEmpty())
+	{
+		where << "global_shot_id = ?";
+		values << query.shot;
+	}
+	if (!query.clip.isEmpty())
+	{
+		where << "(global_clip_id = ? OR clip_name = ?)";
+		values << query.clip << query.clip;
+	}
+	if (!query.card.isEmpty())
+	{
+		where << "card_id = ?";
+		values << query.card;
+	}
+
+	QString statement = "SELECT card_id, card_root, clip_name, global_clip_id, global_shot_id,"
+	                    " shoot_start, shoot_end, shoot_offset, duration, frame_rate, codec,"
+	                    " manufacturer, serial_no, model_name, video_file, video_size,"
+	                    " audio_files, audio_size FROM clips";
+	if (!where.isEmpty())
+		statement += " WHERE " + where.join(" AND ");
+	statement += " ORDER BY shoot_start, card_id, clip_name";
+
+	QSqlQuery select(mDb);
+	select.setForwardOnly(true);
+	select.prepare(statement);
+	foreach(const QVariant &value, values)
+		select.addBindValue(value);
+	if (!select.exec())
+	{
+		fail(select);
+		return entries;
+	}
+	while (select.next())
+	{
+		Entry e;
+		e.cardId = select.value(0).toString();
+		e.cardRoot = select.value(1).toString();
+		e.clipName = select.value(2).toString();
+		e.globalClipId = select.value(3).toString();
+		e.globalShotId = select.value(4).toString();
+		int offset = select.value(7).toInt();
+		if (!select.value(5).isNull())
+			e.shootStart = QDateTime::fromMSecsSinceEpoch(select.value(5).toLongLong(), Qt::OffsetFromUTC, offset);
+		if (!select.value(6).isNull())
+			e.shootEnd = QDateTime::fromMSecsSinceEpoch(select.value(6).toLongLong(), Qt::OffsetFromUTC, offset);
+		e.duration = select.value(8).toInt();
+		e.frameRate = select.value(9).toDouble();
+		e.codec = select.value(10).toString();
+		e.manufacturer = select.value(11).toString();
+		e.serialNo = select.value(12).toString();
+		e.modelName = select.value(13).toString();
+		e.videoFile = select.value(14).toString();
+		e.videoSize = select.value(15).toLongLong();
+		e.audioFiles = select.value(16).toString().split('\n', QString::SkipEmptyParts);
+		e.audioSize = select.value(17).toLongLong();
+		entries.append(e);
+	}
+	return entries;
+}
@@ -0,0 +1,82 @@
+#ifndef CLIPCATALOG_H
+#define CLIPCATALOG_H
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include <QSqlDatabase>
+#include "p2card.h"
+
+class QSqlQuery;
+
+/**
+ * Clips of many cards in one SQLite file. Cards are updated incrementally:
+ * only clip xml files whose size or mtime changed are parsed again.
+ * Shoot times, device serial and shot id are indexed for the queries below.
+ */
+class ClipCatalog
+{
+public:
+	/** a clip as stored in the catalog */
+	struct Entry
+	{
+		QString cardId;
+		QString cardRoot;
+		QString clipName;
+		QString globalClipId;
+		QString globalShotId;
+		QDateTime shootStart;   ///< in the camera's utc offset
+		QDateTime shootEnd;
+		int duration;           ///< frames
+		double frameRate;       ///< edit units per second
+		QString codec;
+		QString manufacturer;
+		QString serialNo;
+		QString modelName;
+		QString videoFile;      ///< absolute path
+		qint64 videoSize;
+		QStringList audioFiles; ///< absolute paths
+		qint64 audioSize;
+	};
+
+	/** conditions left empty are ignored, the others are combined */
+	struct Query
+	{
+		QDate date;             ///< shot on this day, camera local time
+		QDateTime from;         ///< shoot start at or after
+		QDateTime to;           ///< shoot start before
+		QString device;         ///< camera serial number
+		QString model;          ///< a part of the model name, not indexed
+		QString shot;           ///< global shot id
+		QString clip;           ///< global clip id or clip name
+		QString card;           ///< card folder name
+	};
+
+	explicit ClipCatalog(const QString &fileName = defaultLocation());
+	~ClipCatalog();
+
+	bool open();
+	QString errorString() const;
+
+	/** brings the clips of card up to date. returns the number of clip
+	 * files parsed (0 if nothing changed), -1 on error */
+	int updateCard(const MXF::Card &card);
+	/** forgets cards whose folder is gone; returns the number of clips dropped, -1 on error */
+	int prune();
+
+	QList<Entry> find(const Query &query);
+	int clipCount();
+
+	static QString defaultLocation();
+
+private:
+	bool exec(const QString &statement);
+	bool fail(const QSqlQuery &query);
+
+	QString mFileName;
+	QString mConnection;
+	QSqlDatabase mDb;
+	QString mError;
+};
+
+#endif // CLIPCATALOG_H
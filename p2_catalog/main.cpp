@@ -0,0 +1,187 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QFile>
+#include <QDebug>
+#include "p2card.h"
+#include "clipcatalog.h"
+
+/** ISO date or date and time; a bare date means the start of that day,
+ * or the start of the next one if endOfDay is set */
+static QDateTime parseTime(const QString &text, bool endOfDay = false)
+{
+	QDateTime time = QDateTime::fromString(text, Qt::ISODate);
+	if (text.contains('T') || text.contains(' '))
+		return time;
+	QDate date = QDate::fromString(text, Qt::ISODate);
+	if (!date.isValid())
+		return QDateTime();
+	return QDateTime(endOfDay ? date.addDays(1) : date, QTime(0, 0));
+}
+
+static int update(ClipCatalog &catalog, const QStringList &paths, bool prune)
+{
+	QElapsedTimer timer;
+	timer.start();
+	int cards = 0;
+	int parsed = 0;
+	foreach(const QString &path, paths)
+	{
+		foreach(const MXF::Card &card, MXF::findCards(path))
+		{
+			int n = catalog.updateCard(card);
+			if (n < 0)
+			{
+				qCritical().noquote() << catalog.errorString();
+				return 1;
+			}
+			cards++;
+			parsed += n;
+		}
+	}
+	if (prune)
+	{
+		int dropped = catalog.prune();
+		if (dropped < 0)
+		{
+			qCritical().noquote() << catalog.errorString();
+			return 1;
+		}
+		qInfo() << dropped << "clips of removed cards dropped";
+	}
+	qInfo() << cards << "cards," << parsed << "clip files read," << catalog.clipCount()
+	        << "clips in the catalog," << timer.elapsed() << "ms";
+	return 0;
+}
+
+static int query(ClipCatalog &catalog, const ClipCatalog::Query &q, bool countOnly)
+{
+	QElapsedTimer timer;
+	timer.start();
+	QList<ClipCatalog::Entry> entries = catalog.find(q);
+	if (!catalog.errorString().isEmpty())
+	{
+		qCritical().noquote() << catalog.errorString();
+		return 1;
+	}
+	qint64 msecs = timer.elapsed();
+
+	QFile stdOut;
+	stdOut.open(stdout, QIODevice::WriteOnly);
+	QTextStream out(&stdOut);
+	out.setCodec("UTF-8");
+	if (countOnly)
+		out << entries.size() << "\n";
+	else
+	{
+		foreach(const ClipCatalog::Entry &e, entries)
+		{
+			int seconds = e.frameRate > 0 ? int(e.duration / e.frameRate) : 0;
+			out << e.shootStart.toString(Qt::ISODate) << '\t'
+			    << e.cardId << '_' << e.clipName << '\t'
+			    << QString().sprintf("%d:%02d", seconds / 60, seconds % 60) << '\t'
+			    << e.modelName << ' ' << e.serialNo << '\t'
+			    << e.globalShotId << '\t'
+			    << e.videoFile << '\n';
+		}
+	}
+	out.flush();
+	qInfo() << entries.size() << "clips in" << msecs << "ms";
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("p2_catalog");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Catalog of the clips on many P2 cards\n\n"
+	                                 "  update <path>...  add or refresh the cards in path (a card or a folder of cards)\n"
+	                                 "  query             list the clips matching all given conditions");
+	parser.addHelpOption();
+	parser.addPositionalArgument("command", "update or query");
+	parser.addPositionalArgument("path", "cards to update", "[path...]");
+	QCommandLineOption catalogOption("catalog", "catalog file (default: " + ClipCatalog::defaultLocation() + ")",
+	                                 "file", ClipCatalog::defaultLocation());
+	parser.addOption(catalogOption);
+	QCommandLineOption pruneOption("prune", "update: forget cards whose folder no longer exists");
+	parser.addOption(pruneOption);
+	QCommandLineOption dateOption("date", "query: shot on this day (yyyy-MM-dd, camera time)", "date");
+	parser.addOption(dateOption);
+	QCommandLineOption fromOption("from", "query: shoot start at or after this date or date and time", "time");
+	parser.addOption(fromOption);
+	QCommandLineOption toOption("to", "query: shoot start before this time, or up to the end of this date", "time");
+	parser.addOption(toOption);
+	QCommandLineOption deviceOption("device", "query: camera serial number", "serial");
+	parser.addOption(deviceOption);
+	QCommandLineOption modelOption("model", "query: part of the camera model name", "name");
+	parser.addOption(modelOption);
+	QCommandLineOption shotOption("shot", "query: clips of this global shot id", "id");
+	parser.addOption(shotOption);
+	QCommandLineOption clipOption("clip", "query: global clip id or clip name", "id");
+	parser.addOption(clipOption);
+	QCommandLineOption cardOption("card", "query: clips of this card folder name", "name");
+	parser.addOption(cardOption);
+	QCommandLineOption countOption("count", "query: only print the number of matching clips");
+	parser.addOption(countOption);
+	parser.process(app);
+
+	QStringList args = parser.positionalArguments();
+	if (args.isEmpty())
+		parser.showHelp(2);
+	QString command = args.takeFirst();
+
+	ClipCatalog catalog(parser.value(catalogOption));
+	if (!catalog.open())
+	{
+		qCritical().noquote() << catalog.errorString();
+		return 1;
+	}
+
+	if (command == "update")
+	{
+		if (args.isEmpty())
+			args << ".";
+		return update(catalog, args, parser.isSet(pruneOption));
+	}
+	if (command != "query")
+		parser.showHelp(2);
+
+	ClipCatalog::Query q;
+	if (parser.isSet(dateOption))
+	{
+		q.date = QDate::fromString(parser.value(dateOption), Qt::ISODate);
+		if (!q.date.isValid())
+		{
+			qCritical() << "invalid date" << parser.value(dateOption);
+			return 2;
+		}
+	}
+	if (parser.isSet(fromOption))
+	{
+		q.from = parseTime(parser.value(fromOption));
+		if (!q.from.isValid())
+		{
+			qCritical() << "invalid time" << parser.value(fromOption);
+			return 2;
+		}
+	}
+	if (parser.isSet(toOption))
+	{
+		q.to = parseTime(parser.value(toOption), true);
+		if (!q.to.isValid())
+		{
+			qCritical() << "invalid time" << parser.value(toOption);
+			return 2;
+		}
+	}
+	q.device = parser.value(deviceOption);
+	q.model = parser.value(modelOption);
+	q.shot = parser.value(shotOption);
+	q.clip = parser.value(clipOption);
+	q.card = parser.value(cardOption);
+	return query(catalog, q, parser.isSet(countOption));
+}
@@ -0,0 +1,20 @@
+QT += core sql
+QT -= gui
+
+CONFIG += c++11
+
+TARGET = p2_catalog
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    clipcatalog.cpp
+
+HEADERS += \
+    clipcatalog.h
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../common/common.pri)
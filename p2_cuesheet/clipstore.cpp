@@ -0,0 +1,375 @@
+#include "clipstore.h"
+#include <QtConcurrent>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+/// fewest records read back from a run file at a time while merging
+static const int minMergeBuffer = 256;
+/// run files merged in one pass, more take several passes
+static const int maxFanIn = 64;
+
+static ClipEntry readClip(const MXF::Card &card, int file)
+{
+	ClipEntry entry;
+	QFile dataFile(card.contents() + "CLIP/" + card.clips.at(file).name);
+	if (!dataFile.open(QFile::ReadOnly))
+		return entry;
+	entry.read = true;
+	entry.clip = MXF::ClipInfo(dataFile.readAll());
+	entry.source = card.id;
+
+	const MXF::ClipInfo &clip = entry.clip;
+	QString icon = clip.clipName() + "." + clip.metaData().thumbnail().format;
+	if (MXF::Card::find(card.icons, icon))
+		entry.icon = card.contents() + "ICON/" + icon;
+	QString video = clip.clipName() + "." + clip.videoEssence().videoFormat();
+	if (MXF::Card::find(card.video, video))
+		entry.video = card.contents() + "VIDEO/" + video;
+	const QVector<MXF::AudioInfo> &audio = clip.audioEssences();
+	for (int a = 0; a < audio.size(); ++a)
+	{
+		QString channel = clip.clipName() + QString().sprintf("%02x.", a) + audio[a].audioFormat();
+		if (MXF::Card::find(card.audio, channel))
+			entry.audio.append(card.contents() + "AUDIO/" + channel);
+	}
+	return entry;
+}
+
+/** reads one clip for QtConcurrent::blockingMapped() */
+struct ClipReader
+{
+	typedef ClipEntry result_type;
+	explicit ClipReader(const QList<MXF::Card> &c) : cards(c) {}
+	ClipEntry operator()(const ClipStore::ClipRef &ref) const
+	{
+		return readClip(cards.at(ref.card), ref.file);
+	}
+	const QList<MXF::Card> &cards;
+};
+
+ClipStore::ClipStore(const QList<MXF::Card> &cards, qint64 memoryCeiling) :
+    mCards(cards),
+    mCeiling(memoryCeiling),
+    mCacheSize(64),
+    mSpilled(0)
+{
+}
+
+ClipStore::~ClipStore()
+{
+	mPool.waitForDone();
+	qDeleteAll(mRuns);
+}
+
+void ClipStore::load()
+{
+	QVector<ClipRef> refs;
+	for (int c = 0; c < mCards.size(); ++c)
+	{
+		for (int f = 0; f < mCards.at(c).clips.size(); ++f)
+		{
+			ClipRef ref = { c, f };
+			refs.append(ref);
+		}
+	}
+	if (isBounded())
+		loadBounded(refs);
+	else
+		loadAll(refs);
+}
+
+int ClipStore::size() const
+{
+	return mRefs.size();
+}
+
+bool ClipStore::isBounded() const
+{
+	return mCeiling > 0;
+}
+
+int ClipStore::spilledRuns() const
+{
+	return mSpilled;
+}
+
+const QVector<MXF::ShotGraph::Links> &ClipStore::links() const
+{
+	return mLinks;
+}
+
+QString ClipStore::source(int i) const
+{
+	return mCards.at(mRefs.at(i).card).id;
+}
+
+void ClipStore::prefetch(int i)
+{
+	if (!isBounded() || mLoaded.contains(i))
+		return;
+	while (mLoadOrder.size() >= mCacheSize)
+		mLoaded.remove(mLoadOrder.dequeue());
+	const ClipRef &ref = mRefs.at(i);
+	mLoaded.insert(i, QtConcurrent::run(&mPool, readClip, mCards.at(ref.card), int(ref.file)));
+	mLoadOrder.enqueue(i);
+}
+
+ClipEntry ClipStore::entry(int i)
+{
+	if (!isBounded())
+		return mEntries.at(i);
+	prefetch(i);
+	return mLoaded.value(i).result();
+}
+
+void ClipStore::setCacheSize(int entries)
+{
+	mCacheSize = qMax(1, entries);
+}
+
+bool ClipStore::lessThan(const SortRecord &a, const SortRecord &b)
+{
+	if (a.start != b.start)
+		return a.start < b.start;
+	return a.seq < b.seq;
+}
+
+ClipStore::SortRecord ClipStore::sortRecord(const ClipEntry &entry, int seq, const ClipRef &ref)
+{
+	const QDateTime &start = entry.clip.metaData().shootStart();
+	SortRecord r;
+	r.start = start.isValid() ? start.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+	r.seq = seq;
+	r.ref = ref;
+	r.links = MXF::ShotGraph::links(entry.clip);
+	return r;
+}
+
+void ClipStore::loadAll(const QVector<ClipRef> &refs)
+{
+	// parsed on all cores, the results come back in input order
+	QVector<ClipEntry> parsed = QtConcurrent::blockingMapped<QVector<ClipEntry> >(refs, ClipReader(mCards));
+	QVector<SortRecord> order;
+	order.reserve(parsed.size());
+	for (int i = 0; i < parsed.size(); ++i)
+	{
+		if (parsed.at(i).read)
+			order.append(sortRecord(parsed.at(i), i, refs.at(i)));
+	}
+	std::sort(order.begin(), order.end(), lessThan);
+	mEntries.reserve(order.size());
+	mLinks.reserve(order.size());
+	mRefs.reserve(order.size());
+	foreach(const SortRecord &r, order)
+	{
+		mEntries.append(parsed.at(r.seq));
+		mLinks.append(r.links);
+		mRefs.append(r.ref);
+	}
+}
+
+void ClipStore::loadBounded(const QVector<ClipRef> &refs)
+{
+	// half the ceiling for the run being collected, the parsed batch is
+	// small against it
+	const int maxRun = int(qBound<qint64>(1024, mCeiling / 2 / qint64(sizeof(SortRecord)), 1 << 24));
+	const int batch = qMin(maxRun, 256 * qMax(1, QThread::idealThreadCount()));
+	QVector<SortRecord> run;
+	bool canSpill = true;
+	for (int first = 0; first < refs.size(); first += batch)
+	{
+		QVector<ClipRef> part = refs.mid(first, batch);
+		QVector<ClipEntry> parsed = QtConcurrent::blockingMapped<QVector<ClipEntry> >(part, ClipReader(mCards));
+		for (int i = 0; i < parsed.size(); ++i)
+		{
+			if (parsed.at(i).read)
+				run.append(sortRecord(parsed.at(i), first + i, part.at(i)));
+		}
+		if (canSpill && (run.size() >= maxRun))
+		{
+			std::sort(run.begin(), run.end(), lessThan);
+			canSpill = spill(run);
+			if (canSpill)
+				run.clear();
+		}
+	}
+	std::sort(run.begin(), run.end(), lessThan);
+	merge(run);
+
+	qint64 kept = qint64(mLinks.size()) * (sizeof(MXF::ShotGraph::Links) + sizeof(ClipRef));
+	if (kept > mCeiling)
+		qWarning() << "the shot graph of" << mLinks.size() << "clips needs" << (kept >> 20)
+		           << "MiB, more than the memory ceiling";
+}
+
+bool ClipStore::spill(const QVector<SortRecord> &run)
+{
+	// read back by this process only, so the records go out as they are
+	QTemporaryFile *file = new QTemporaryFile(QDir::tempPath() + "/p2_cuesheet-XXXXXX.run");
+	qint64 bytes = qint64(run.size()) * sizeof(SortRecord);
+	if (!file->open() || (file->write(reinterpret_cast<const char *>(run.constData()), bytes) != bytes))
+	{
+		qWarning() << file->fileName() << ":" << file->errorString() << ", sorting the rest in memory";
+		delete file;
+		return false;
+	}
+	mRuns.append(file);
+	mSpilled++;
+	return true;
+}
+
+/** merges the runs written by spill() and the last run, still in memory,
+ * into mLinks and mRefs. The runs are read through buffers that share half
+ * the ceiling; with more runs than fit in it at a useful size, groups of
+ * them are first merged into longer runs */
+void ClipStore::merge(QVector<SortRecord> &tail)
+{
+	qint64 total = tail.size();
+	foreach(QTemporaryFile *file, mRuns)
+		total += file->size() / qint64(sizeof(SortRecord));
+	mLinks.reserve(int(total));
+	mRefs.reserve(int(total));
+
+	const qint64 records = mCeiling / 2 / qint64(sizeof(SortRecord));
+	const int fanIn = int(qBound<qint64>(2, records / minMergeBuffer, maxFanIn));
+	while (mRuns.size() >= fanIn)
+	{
+		QList<QTemporaryFile *> merged;
+		int first = 0;
+		for (; first < mRuns.size(); first += fanIn)
+		{
+			QList<QTemporaryFile *> group = mRuns.mid(first, fanIn);
+			if (group.size() == 1)
+			{
+				merged.append(group.first());
+				continue;
+			}
+			QTemporaryFile *file = mergeToFile(group);
+			if (!file)
+				break;
+			qDeleteAll(group);
+			merged.append(file);
+		}
+		bool failed = first < mRuns.size();
+		mRuns = merged + mRuns.mid(first);
+		if (failed)
+		{
+			qWarning() << "merging" << mRuns.size() << "runs at once";
+			break;
+		}
+	}
+
+	mergeRuns(mRuns, &tail, 0);
+	qDeleteAll(mRuns);
+	mRuns.clear();
+}
+
+/** one pass over a group of runs, 0 if the merged run could not be written */
+QTemporaryFile *ClipStore::mergeToFile(const QList<QTemporaryFile *> &runs)
+{
+	QTemporaryFile *file = new QTemporaryFile(QDir::tempPath() + "/p2_cuesheet-XXXXXX.run");
+	if (!file->open() || !mergeRuns(runs, 0, file))
+	{
+		qWarning() << file->fileName() << ":" << file->errorString();
+		delete file;
+		return 0;
+	}
+	return file;
+}
+
+/** a sorted run read through a buffer, or the run kept in memory */
+struct ClipStore::RunSource
+{
+	RunSource() : file(0), pos(0) {}
+	QTemporaryFile *file;
+	QVector<SortRecord> buffer;
+	int pos;
+	bool atEnd() const { return pos >= buffer.size(); }
+	const SortRecord &head() const { return buffer.at(pos); }
+	void fill(int records)
+	{
+		pos = 0;
+		buffer.resize(records);
+		qint64 got = file ? file->read(reinterpret_cast<char *>(buffer.data()),
+		                               qint64(records) * sizeof(SortRecord)) : 0;
+		buffer.resize(int(qMax<qint64>(0, got) / qint64(sizeof(SortRecord))));
+	}
+};
+
+/** merges runs and tail into out, or into mLinks and mRefs if out is 0.
+ * The smallest head is kept on top of a heap of the sources */
+bool ClipStore::mergeRuns(const QList<QTemporaryFile *> &runs, QVector<SortRecord> *tail, QTemporaryFile *out)
+{
+	// the output buffer takes one share as well
+	const int records = int(qBound<qint64>(minMergeBuffer,
+	                                       mCeiling / 2 / qint64(sizeof(SortRecord)) / (runs.size() + 1),
+	                                       1 << 20));
+	QVector<RunSource> sources(runs.size());
+	for (int s = 0; s < runs.size(); ++s)
+	{
+		sources[s].file = runs.at(s);
+		runs.at(s)->seek(0);
+		sources[s].fill(records);
+	}
+	if (tail)
+	{
+		RunSource memory;
+		memory.buffer = *tail;
+		tail->clear();
+		sources.append(memory);
+	}
+
+	QVector<int> heap;
+	for (int s = 0; s < sources.size(); ++s)
+	{
+		if (!sources.at(s).atEnd())
+			heap.append(s);
+	}
+	auto later = [&sources](int a, int b) { return lessThan(sources.at(b).head(), sources.at(a).head()); };
+	std::make_heap(heap.begin(), heap.end(), later);
+
+	QVector<SortRecord> written;
+	if (out)
+		written.reserve(records);
+	while (!heap.isEmpty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), later);
+		RunSource &source = sources[heap.last()];
+		const SortRecord &r = source.head();
+		if (out)
+		{
+			written.append(r);
+			if (written.size() >= records)
+			{
+				qint64 bytes = qint64(written.size()) * sizeof(SortRecord);
+				if (out->write(reinterpret_cast<const char *>(written.constData()), bytes) != bytes)
+					return false;
+				written.clear();
+			}
+		}
+		else
+		{
+			mLinks.append(r.links);
+			mRefs.append(r.ref);
+		}
+		source.pos++;
+		if (source.atEnd() && source.file)
+			source.fill(records);
+		if (source.atEnd())
+			heap.removeLast();
+		else
+			std::push_heap(heap.begin(), heap.end(), later);
+	}
+	if (out)
+	{
+		qint64 bytes = qint64(written.size()) * sizeof(SortRecord);
+		if (out->write(reinterpret_cast<const char *>(written.constData()), bytes) != bytes)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,102 @@
+#ifndef CLIPSTORE_H
+#define CLIPSTORE_H
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QQueue>
+#include <QFuture>
+#include <QThreadPool>
+#include <mxfmeta.h>
+#include "p2card.h"
+#include "shotgraph.h"
+
+class QTemporaryFile;
+
+/** a parsed clip and the files shown with it */
+struct ClipEntry
+{
+	ClipEntry() : read(false) {}
+	bool read;          ///< false if the xml file could not be opened
+	MXF::ClipInfo clip;
+	QString source;     ///< card id
+	QString icon;       ///< icon file, empty if there is none
+	QString video;      ///< video essence for the filmstrip, empty if there is none
+	QStringList audio;  ///< audio essence for the waveform, one file per channel
+};
+
+/**
+ * The clips of all cards in shoot start order, read on all cores. By
+ * default every ClipEntry is kept. With a memory ceiling only a compact
+ * record per clip stays in memory, the links for the shot graph and the
+ * position of its xml file, and entry() reads the xml again when the clip
+ * is printed. The shoot start order is then found by sorting runs of
+ * records that are written to temporary files once they reach the ceiling
+ * and merged afterwards, in several passes if there are many of them.
+ */
+class ClipStore
+{
+public:
+	/** memoryCeiling in bytes, 0 keeps every entry */
+	explicit ClipStore(const QList<MXF::Card> &cards, qint64 memoryCeiling = 0);
+	~ClipStore();
+
+	/** reads and sorts the clips of all cards */
+	void load();
+
+	int size() const;
+	bool isBounded() const;
+	/** sorted runs that went to disk */
+	int spilledRuns() const;
+	const QVector<MXF::ShotGraph::Links> &links() const;
+	/** card id of clip i, without reading the clip */
+	QString source(int i) const;
+	/** starts reading clip i in the background, bounded mode only */
+	void prefetch(int i);
+	/** clip i; in bounded mode a few recently used entries are kept */
+	ClipEntry entry(int i);
+	/** entries kept by entry() in bounded mode, at least the prefetch distance */
+	void setCacheSize(int entries);
+
+	/** where the xml file of a clip is */
+	struct ClipRef
+	{
+		qint32 card;
+		qint32 file;    ///< index into Card::clips
+	};
+
+private:
+	/** what is sorted and spilled, plain data written as is */
+	struct SortRecord
+	{
+		qint64 start;   ///< shoot start in msecs since epoch, minimum if unset
+		qint32 seq;     ///< input order, keeps the sort stable
+		ClipRef ref;
+		MXF::ShotGraph::Links links;
+	};
+	struct RunSource;
+	static bool lessThan(const SortRecord &a, const SortRecord &b);
+	static SortRecord sortRecord(const ClipEntry &entry, int seq, const ClipRef &ref);
+
+	void loadAll(const QVector<ClipRef> &refs);
+	void loadBounded(const QVector<ClipRef> &refs);
+	bool spill(const QVector<SortRecord> &run);
+	void merge(QVector<SortRecord> &tail);
+	QTemporaryFile *mergeToFile(const QList<QTemporaryFile *> &runs);
+	bool mergeRuns(const QList<QTemporaryFile *> &runs, QVector<SortRecord> *tail, QTemporaryFile *out);
+
+	QList<MXF::Card> mCards;
+	qint64 mCeiling;
+	QVector<MXF::ShotGraph::Links> mLinks;
+	QVector<ClipRef> mRefs;
+	QVector<ClipEntry> mEntries;            ///< all of them, unbounded mode only
+	QList<QTemporaryFile *> mRuns;
+	QThreadPool mPool;                      ///< re-reads clips in bounded mode
+	QHash<int, QFuture<ClipEntry> > mLoaded;
+	QQueue<int> mLoadOrder;                 ///< mLoaded keys, oldest first
+	int mCacheSize;
+	int mSpilled;
+};
+
+#endif // CLIPSTORE_H
@@ -3,99 +3,177 @@
 #include <QByteArray>
 #include <mxfmeta.h>
 #include <QDebug>
-#include <QMap>
+#include <QVector>
 #include <QDir>
 #include <QFileInfo>
-#include <iostream>
-#include <iomanip>
-#include <QImage>
-#include <QBuffer>
+#include <QTextStream>
+#include <QImageWriter>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
-QString cardId(QString cardRoot)
-{
-	QDir dir(cardRoot);
-	if (!dir.entryList().contains("CONTENTS"))
-		dir.cd("..");
-	cardRoot = dir.absolutePath();
-	if (!dir.entryList().contains("CONTENTS"))
-		return QString();
-	return dir.absolutePath().split("/").last();
-}
+#include <QThread>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include "p2card.h"
+#include "shotgraph.h"
+#include "thumbnailcache.h"
+#include "waveformcache.h"
+#include "clipstore.h"
 
-/** gets a list of all the xml files */
-QStringList parseCard(QString cardRoot)
+static QString durationString(const MXF::ClipInfo &clip)
 {
-    qDebug()<<"parsing data in"<<cardRoot;
-	QDir dir(cardRoot);
-	QStringList fileList;
-	if (!dir.entryList().contains("CONTENTS"))
-		dir.cd("..");
-	cardRoot = dir.absolutePath();
-	if (!dir.entryList().contains("CONTENTS"))
-		return QStringList();
-
-	dir.setPath(cardRoot+"/CONTENTS/CLIP");
-	dir.setNameFilters(QStringList()<<"*.xml"<<"*.XML");
-	//qDebug()<<dir.absolutePath();
-	foreach(QFileInfo file, dir.entryInfoList())
-	{
-		fileList.append(file.absoluteFilePath());
-	}
-	return fileList;
-}
-
-static bool shootStartLessThan(const MXF::ClipInfo &s1, const MXF::ClipInfo &s2)
-{
-	return s1.metaData().shootStart() < s2.metaData().shootStart();
+	int duration = clip.duration() * clip.editUnit().numerator / clip.editUnit().denominator;
+	return QString().sprintf("%d:%02d", duration / 60, duration % 60);
 }
 
-
-void printClipEntry(const MXF::ClipInfo & clip, QString prefix, int counter, bool html = false, QByteArray thumbData = QByteArray())
+/** thumbUrl and stripUrl are either data: urls or paths relative to the html file,
+ * waveform is inline svg */
+void printClipEntry(QTextStream &out, const MXF::ClipInfo & clip, QString prefix, int counter, bool html = false,
+                    const QString &thumbUrl = QString(), const QString &stripUrl = QString(),
+                    const QString &waveform = QString())
 {
-	int duration = clip.duration() * clip.editUnit().numerator / clip.editUnit().denominator;
 	if (html)
 	{
-		QString clipName = prefix.size()?(prefix + "_"):"";
-		clipName += clip.clipName();
-
-		QString entry = "<li>";
-		if (thumbData.size())
+		out << "<li>";
+		if (thumbUrl.size())
 		{
-			entry += QStringLiteral("<img src=\"data:image/png;base64,%1\" alt=\"(thumbnail)\" "
-			                        "class=\"thumbnail\" id=\"thumb_%2\" />")
-			         .arg(QString(thumbData.toBase64()))
-			         .arg(clip.globalClipID());
-			entry+="<br />";
+			out << "<img src=\"" << thumbUrl << "\" alt=\"(thumbnail)\" "
+			    << "class=\"thumbnail\" id=\"thumb_" << clip.globalClipID() << "\" />"
+			    << "<br />";
 		}
+		if (stripUrl.size())
+		{
+			out << "<img src=\"" << stripUrl << "\" alt=\"(filmstrip)\" "
+			    << "class=\"filmstrip\" />"
+			    << "<br />";
+		}
+		if (waveform.size())
+			out << waveform << "<br />";
 
-		entry+= QStringLiteral("<span class=\"clipname\">%1</span><br/>").arg(clipName);
-		entry+= QStringLiteral("<span class=\"duration\">%1</span><br/>")
-		        .arg(QString().sprintf("%d:%02d", duration / 60, duration % 60));
-		entry+="</li>\n";
-		std::cout << entry.toStdString();
+		out << "<span class=\"clipname\">";
+		if (prefix.size())
+			out << prefix << "_";
+		out << clip.clipName() << "</span><br/>"
+		    << "<span class=\"duration\">" << durationString(clip) << "</span><br/>"
+		    << "</li>\n";
 	}
 	else
 	{
-		std::cout << "Clip";
+		out << "Clip";
 		if (counter)
-			std::cout << " " << counter;
-		std::cout << ": ";
+			out << " " << counter;
+		out << ": ";
 		if (prefix.size())
-			std::cout << prefix.toStdString() << "_";
-		std::cout << clip.clipName().toStdString()
-		          << " ("
-		          << duration / 60 << ":" << std::setw(2) << std::setfill('0') << duration % 60
-		          << ")\n";
+			out << prefix << "_";
+		out << clip.clipName() << " (" << durationString(clip) << ")\n";
 	}
 }
 
+enum OutputFormat
+{
+	HtmlFormat,
+	TextFormat,
+	NdjsonFormat,   ///< one json object per line and record
+	CsvFormat       ///< one row per record, the keys of csvColumns
+};
+
+/// every record key, in column order; a record leaves the columns empty
+/// that do not apply to it
+static const char *const csvColumns[] = {
+    "type", "shot", "index", "card", "clip", "globalClipId", "userClipName", "shootStart",
+    "frames", "duration", "videoFormat", "clips", "status", "top", "previous", "next"
+};
+
+static QString csvField(const QJsonValue &value)
+{
+	QString field;
+	if (value.isBool())
+		field = value.toBool() ? "true" : "false";
+	else if (value.isDouble())
+		field = QString::number(value.toDouble(), 'g', 15);
+	else
+		field = value.toString();
+	if (field.contains(',') || field.contains('"') || field.contains('\n') || field.contains('\r'))
+		field = '"' + field.replace('"', "\"\"") + '"';
+	return field;
+}
+
+/** ndjson and csv records go out one by one and are flushed by the caller
+ * as soon as a shot is complete */
+static void writeRecord(QTextStream &out, OutputFormat format, const QJsonObject &record)
+{
+	if (format == NdjsonFormat)
+	{
+		out << QString::fromUtf8(QJsonDocument(record).toJson(QJsonDocument::Compact)) << "\n";
+		return;
+	}
+	QStringList fields;
+	for (const char *column : csvColumns)
+		fields.append(csvField(record.value(QLatin1String(column))));
+	out << fields.join(',') << "\r\n";
+}
+
+/** the fields of a clip record; type, shot and index are up to the caller */
+static QJsonObject clipRecord(const MXF::ClipInfo &clip, const QString &card)
+{
+	QJsonObject o;
+	o["card"] = card;
+	o["clip"] = clip.clipName();
+	o["globalClipId"] = clip.globalClipID();
+	o["userClipName"] = clip.metaData().userClipName();
+	o["shootStart"] = clip.metaData().shootStart().toString(Qt::ISODate);
+	o["frames"] = clip.duration();
+	o["duration"] = double(clip.duration()) * clip.editUnit().numerator / clip.editUnit().denominator;
+	o["videoFormat"] = clip.videoEssence().videoFormat();
+	const MXF::ClipRelation &relation = clip.relation();
+	if (relation.connectionTop.isSet())
+		o["top"] = relation.connectionTop.globalClipId;
+	if (relation.connectionPrevious.isSet())
+		o["previous"] = relation.connectionPrevious.globalClipId;
+	if (relation.connectionNext.isSet())
+		o["next"] = relation.connectionNext.globalClipId;
+	return o;
+}
+
 int main(int argc, char *argv[])
 {	
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("p2_cuesheet");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Clip reference sheet for P2 cards");
+	parser.addHelpOption();
+	parser.addPositionalArgument("path", "A P2 card or a folder holding several cards (default: current folder)");
+	QCommandLineOption outputOption(QStringList() << "o" << "output-dir",
+	                                "Write index.html (or index.txt, .ndjson, .csv) and the thumbnails as separate files into <dir> instead of inlining them on stdout.",
+	                                "dir");
+	parser.addOption(outputOption);
+	QCommandLineOption formatOption("format",
+	                                "Output format: html, text, ndjson or csv (default: html). ndjson and csv write one record per shot and clip, flushed shot by shot.",
+	                                "format", "html");
+	parser.addOption(formatOption);
+	QCommandLineOption thumbFormatOption("thumbnail-format",
+	                                     "Image format of the thumbnails: png, jpg or webp (default: png).",
+	                                     "format", "png");
+	parser.addOption(thumbFormatOption);
+	QCommandLineOption filmstripOption("filmstrip",
+	                                   "Show count frames of each clip, decoded at 1/8 size from the DV essence (default: 0, none).",
+	                                   "count", "0");
+	parser.addOption(filmstripOption);
+	QCommandLineOption waveformOption("waveform",
+	                                  "Show the audio levels of each clip as a waveform of the given width in pixels (default: 0, none).",
+	                                  "width", "0");
+	parser.addOption(waveformOption);
+	QCommandLineOption memoryOption("max-memory",
+	                                "Keep only a compact record per clip and read the details again when they are written; "
+	                                "sorting spills to temporary files beyond about half of MiB (default: 0, keep everything).",
+	                                "MiB", "0");
+	parser.addOption(memoryOption);
+	parser.process(app);
+
 	QString path = QDir::currentPath();
-	if (argc>1)
+	if (parser.positionalArguments().size())
 	{
-		path = argv[1];
+		path = parser.positionalArguments().first();
 		QDir sd(path);
 		if (!sd.exists())
 			return 2;
@@ -103,219 +181,327 @@ int main(int argc, char *argv[])
 		qDebug() << path;
 	}
 
-	QStringList xmlList;
-	qDebug()<<"Input: " << path;
-	//check if we are in a card's root
-	if (path.endsWith("CONTENTS") || QDir(path).entryList().contains("CONTENTS"))
+	QByteArray thumbFormat = parser.value(thumbFormatOption).toLatin1().toLower();
+	if (!QImageWriter::supportedImageFormats().contains(thumbFormat))
 	{
-        xmlList = parseCard(path);
+		qCritical() << "thumbnail format" << thumbFormat << "is not supported by this Qt build";
+		return 2;
 	}
-	else //try one level deeper
-	{
-		QDir dir(path);
-		QFileInfoList dirs = dir.entryInfoList();
-		foreach(QFileInfo f, dirs)
-		{
-			if (f.isDir())
-			{
-				xmlList.append(parseCard(f.absoluteFilePath()));
-			}
-		}
-	}
-	QList<MXF::ClipInfo> clipList;
-	QMap<QString, QString> clipSourceMap;
 
-	foreach(QString f, xmlList)
+	const QStringList formatNames = QStringList() << "html" << "text" << "ndjson" << "csv";
+	int formatIndex = formatNames.indexOf(parser.value(formatOption).toLower());
+	if (formatIndex < 0)
 	{
-		QFile dataFile(f);
-		if (dataFile.open(QFile::ReadOnly))
-		{
-			QByteArray data = dataFile.readAll();
-			MXF::ClipInfo clipData(data);
-			clipList.append(clipData);
-			QString cardId;
-			QStringList path = f.split('/');
-			if (path.size()>3)
-			{
-				path.pop_back();
-				path.pop_back();
-				path.pop_back();
-				cardId = path.last();
-			}
-			clipSourceMap.insert(clipData.globalClipID(), cardId);
-
-		}
+		qCritical() << "unknown output format" << parser.value(formatOption);
+		return 2;
 	}
+	OutputFormat format = OutputFormat(formatIndex);
+	bool html = format == HtmlFormat;
+	bool records = (format == NdjsonFormat) || (format == CsvFormat);
 
-	qSort(clipList.begin(), clipList.end(), shootStartLessThan);
+	int filmstripFrames = qBound(0, parser.value(filmstripOption).toInt(), 100);
+	int waveformWidth = qBound(0, parser.value(waveformOption).toInt(), 4000);
+	qint64 memoryCeiling = qMax<qint64>(0, parser.value(memoryOption).toLongLong()) << 20;
 
-	QMap<QString, MXF::ClipInfo> clipMap;
-	foreach(MXF::ClipInfo clip, clipList)
-		clipMap.insert(clip.globalClipID(), clip);
-
-
-	QStringList shotList;
-
-	foreach(MXF::ClipInfo clip, clipList)
+	// everything goes through one buffered stream, either stdout or <dir>/index.<format>
+	QString outputDir;
+	QFile outFile;
+	if (parser.isSet(outputOption))
 	{
-		if (clip.relation().connectionTop.isSet())
+		outputDir = QDir(parser.value(outputOption)).absolutePath();
+		if (!QDir().mkpath(html ? outputDir + "/thumbnails" : outputDir))
 		{
-			if (clip.relation().connectionTop.globalClipId == clip.globalClipID())
-			{
-				shotList << clip.globalClipID();
-			}
+			qCritical() << outputDir << ": cannot create folder";
+			return 2;
 		}
-		else
+		outFile.setFileName(outputDir + "/index." + (format == TextFormat ? QString("txt") : formatNames.at(format)));
+		if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
 		{
-			shotList.append(QStringList() << clip.globalClipID());
+			qCritical() << outFile.fileName() << ":" << outFile.errorString();
+			return 2;
 		}
 	}
+	else
+		outFile.open(stdout, QIODevice::WriteOnly);
+	QTextStream out(&outFile);
+	out.setCodec("UTF-8");
+
+	qDebug()<<"Input: " << path;
+	QList<MXF::Card> cards = MXF::findCards(path);
+	ThumbnailCache thumbnails;
+	thumbnails.setFormat(thumbFormat);
+	WaveformCache waveforms;
+
+	// stage 1 and 2: the clip xml files are read and parsed on all cores
+	// and sorted by shoot start, see ClipStore
+	ClipStore store(cards, memoryCeiling);
+	store.load();
+
+	MXF::ShotGraph graph(store.links());
+	foreach(const MXF::ShotGraph::Problem &p, graph.problems())
+		if (p.kind == MXF::ShotGraph::Problem::Duplicate)
+			qWarning() << store.source(p.clip) << store.entry(p.clip).clip.clipName() << "has a clip id seen before, left out";
 
-//    foreach(auto clip, clipList)
-//    {
-//        QString stc = clip.metaData().shootStart().toString("yyyy-MM-dd_hh:mm:ss");
-//        std::cout << "mv " << clipSourceMap[clip.globalClipID()].toStdString() << "_" << clip.clipName().toStdString() << ".avi "
-//        << stc.toStdString() << "_"
-//                  << clipSourceMap[clip.globalClipID()].toStdString() << "_" << clip.clipName().toStdString()
-//                  <<".avi\n";
-//    }
+	// card of a connected clip, empty if it is not among the input
+	auto sourceOf = [&](const QString &globalClipId) {
+		int i = graph.indexOf(MXF::ClipId::fromString(globalClipId));
+		return i >= 0 ? store.source(i) : QString();
+	};
 
-//    return 0;
 	bool foundIncomplete = false;
-	bool html = true;
-	QStringList processed;
-	//now parse the list of start clips and create lists of filenames
+	//now print the shots and their clips
 	if (html)
 	{
 		QFile hdr(":/sitehead.html");
 		hdr.open(QIODevice::ReadOnly);
-		std::cout << hdr.readAll().constData();
-		std::cout << std::endl;
+		out << hdr.readAll() << "\n";
 	}
-	else
-		std::cout << "Clip reference sheet\n";
+	else if (format == CsvFormat)
+	{
+		QStringList header;
+		for (const char *column : csvColumns)
+			header.append(QLatin1String(column));
+		out << header.join(',') << "\r\n";
+	}
+	else if (format == TextFormat)
+		out << "Clip reference sheet\n";
+
+	// inlined as data: url on stdout, a file next to index.html otherwise
+	auto imageUrl = [&](const QByteArray &imageData, const QString &baseName) {
+		if (imageData.isEmpty())
+			return QString();
+		if (outputDir.isEmpty())
+			return "data:" + thumbnails.mimeType() + ";base64," + QString::fromLatin1(imageData.toBase64());
+		QString name = QStringLiteral("thumbnails/%1.%2").arg(baseName, QString::fromLatin1(thumbnails.format()));
+		QFile imageFile(outputDir + "/" + name);
+		if (imageFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+		        && imageFile.write(imageData) == imageData.size())
+			return name;
+		qWarning() << imageFile.fileName() << ":" << imageFile.errorString();
+		return QString();
+	};
+
+	// stage 3: clips are read back (with a memory ceiling) and pictures and
+	// waveforms made on the pools in the order they are printed, a bounded
+	// distance ahead of stage 4 (printing), so the pools stay busy without
+	// holding the whole archive in memory
+	QVector<int> renderOrder;
+	foreach(const MXF::ShotGraph::Shot &shot, graph.shots())
+	{
+		if (!shot.missingStart)
+			renderOrder += shot.clips;
+	}
+	const int lookahead = 4 * QThread::idealThreadCount() + 4;
+	store.setCacheSize(2 * lookahead + 8);
+	int readAhead = 0;
+	int mediaAhead = 0;
+	auto prefetch = [&](int rendered) {
+		for (; (readAhead < rendered + 2 * lookahead) && (readAhead < renderOrder.size()); ++readAhead)
+			store.prefetch(renderOrder.at(readAhead));
+		for (; html && (mediaAhead < rendered + lookahead) && (mediaAhead < renderOrder.size()); ++mediaAhead)
+		{
+			ClipEntry entry = store.entry(renderOrder.at(mediaAhead));
+			if (!entry.icon.isEmpty())
+				thumbnails.request(entry.icon);
+			if (filmstripFrames && !entry.video.isEmpty())
+				thumbnails.requestFilmstrip(entry.video, filmstripFrames);
+			if (waveformWidth && !entry.audio.isEmpty())
+			{
+				const MXF::AudioInfo &audio = entry.clip.audioEssences().first();
+				waveforms.request(entry.audio, audio.bitsPerSample(), audio.samplingRate());
+			}
+		}
+	};
+	int rendered = 0;
+	prefetch(rendered);
 
-	foreach(QString startId, shotList)
+	QVector<const MXF::ShotGraph::Shot *> orphans;
+	int shotCtr = 0;
+	foreach(const MXF::ShotGraph::Shot &shot, graph.shots())
 	{
-		MXF::ClipInfo startClip = clipMap[startId];
+		if (shot.missingStart)
+		{
+			orphans.append(&shot);
+			continue;
+		}
+		QDateTime shootStart = store.entry(shot.clips.first()).clip.metaData().shootStart();
+		++shotCtr;
+
+		if (records)
+		{
+			// the shot, then its clips in playback order
+			QJsonObject o;
+			o["type"] = QStringLiteral("shot");
+			o["shot"] = shotCtr;
+			o["shootStart"] = shootStart.toString(Qt::ISODate);
+			QList<ClipEntry> entries;
+			qint64 frames = 0;
+			double duration = 0;
+			foreach(int i, shot.clips)
+			{
+				prefetch(++rendered);
+				entries.append(store.entry(i));
+				const MXF::ClipInfo &clip = entries.last().clip;
+				frames += clip.duration();
+				duration += double(clip.duration()) * clip.editUnit().numerator / clip.editUnit().denominator;
+			}
+			o["frames"] = frames;
+			o["duration"] = duration;
+			o["clips"] = shot.clips.size();
+			o["status"] = shot.loop ? QStringLiteral("loop")
+			                        : shot.missingEnd ? QStringLiteral("incomplete") : QStringLiteral("complete");
+			writeRecord(out, format, o);
+			int clipCtr = 1;
+			foreach(const ClipEntry &entry, entries)
+			{
+				QJsonObject c = clipRecord(entry.clip, entry.source);
+				c["type"] = QStringLiteral("clip");
+				c["shot"] = shotCtr;
+				c["index"] = clipCtr++;
+				writeRecord(out, format, c);
+			}
+			if (!shot.isComplete())
+				foundIncomplete = true;
+			// consumers see each shot as soon as it is written
+			out.flush();
+			continue;
+		}
 
 		if (html)
 		{
-			std::cout << "<div class=\"shot\">";
-			std::cout << "<span class=\"start\">Start time: "
-			          << startClip.metaData().shootStart().toString("yyyy-MM-dd HH:mm:ss").toStdString()
-			          << "</span>"
-			          << "\n";
-			std::cout << "<ul>\n";
+			out << "<div class=\"shot\">"
+			    << "<span class=\"start\">Start time: "
+			    << shootStart.toString("yyyy-MM-dd HH:mm:ss")
+			    << "</span>\n"
+			    << "<ul>\n";
 		}
 		else
 		{
-			std::cout << "Start time: " << startClip.metaData().shootStart().toString("yyyy-MM-dd HH:mm:ss").toStdString()
-			          << "\n";
+			out << "Start time: " << shootStart.toString("yyyy-MM-dd HH:mm:ss")
+			    << "\n";
 		}
 
-		MXF::ClipInfo clip = startClip;
-
 		int clipCtr = 1;
-		while(1)
+		foreach(int i, shot.clips)
 		{
-			QByteArray thumbData;
-			if (html) // try reading thumbnail
-			{
-				QString iconPath = path
-				                   + "/"
-				                   + clipSourceMap[clip.globalClipID()]
-				                   + "/CONTENTS/ICON/";
-				iconPath += clip.clipName();
-				iconPath += "." + clip.metaData().thumbnail().format;
-				QImage icon(iconPath);
-				qDebug()<<iconPath;
-				qDebug()<<icon.size();
-				if (!icon.isNull())
-				{
-					QBuffer buff(&thumbData);
-					icon.save(&buff, "PNG");
-				}
-			}
-			printClipEntry(clip,
-			               clipSourceMap[clip.globalClipID()],
+			prefetch(++rendered);
+			ClipEntry entry = store.entry(i);
+			const MXF::ClipInfo &clip = entry.clip;
+			QString prefix = entry.source;
+			QString baseName = (prefix.size() ? prefix + "_" : QString()) + clip.clipName();
+			QString thumbUrl;
+			QString stripUrl;
+			if (html && !entry.icon.isEmpty())
+				thumbUrl = imageUrl(thumbnails.data(entry.icon), baseName);
+			if (html && filmstripFrames && !entry.video.isEmpty())
+				stripUrl = imageUrl(thumbnails.filmstripData(entry.video, filmstripFrames), baseName + "_strip");
+			QString waveform;
+			if (html && waveformWidth && !entry.audio.isEmpty())
+				waveform = waveforms.svg(entry.audio, waveformWidth, 32);
+			printClipEntry(out,
+			               clip,
+			               prefix,
 			        clipCtr++,
 			        html,
-			        thumbData);
-			processed.push_back(clip.globalClipID());
-			if (!clip.relation().connectionNext.isSet())
-				break;
-			clip = clipMap[clip.relation().connectionNext.globalClipId];
-			if (clip.isNull())
-			{
-				foundIncomplete = true;
-				std::cout << "(incomplete)";
-				break;
-			}
+			        thumbUrl,
+			        stripUrl,
+			        waveform);
+		}
+		if (!shot.isComplete())
+		{
+			foundIncomplete = true;
+			out << (shot.loop ? "(connection loop)" : "(incomplete)");
+			if (!html)
+				out << "\n";
 		}
 		if (html)
 		{
-			std::cout << "</ul></div>\n";
+			out << "</ul></div>\n";
 		}
 		else
-			std::cout << "====\n\n";
+			out << "====\n\n";
 	}
-	//
-	if (foundIncomplete)
+	if (records)
 	{
-		if (html)
-			std::cout << "<div class=\"warning\">There were incomplete shots</div>\n";
-		else
-			std::cout << "(!!) There were incomplete shots\n";
+		// clips whose shot start is not among the input, shot 0
+		foreach (const MXF::ShotGraph::Shot *shot, orphans)
+		{
+			int clipCtr = 1;
+			foreach (int i, shot->clips)
+			{
+				ClipEntry entry = store.entry(i);
+				QJsonObject c = clipRecord(entry.clip, entry.source);
+				c["type"] = QStringLiteral("orphan");
+				c["shot"] = 0;
+				c["index"] = clipCtr++;
+				c["status"] = QStringLiteral("missing start");
+				writeRecord(out, format, c);
+			}
+		}
+		if (foundIncomplete || orphans.size())
+			qWarning() << "there were incomplete shots or orphaned clips";
 	}
-	foreach(QString id, processed)
+	else if (foundIncomplete)
 	{
-		clipMap.remove(id);
+		if (html)
+			out << "<div class=\"warning\">There were incomplete shots</div>\n";
+		else
+			out << "(!!) There were incomplete shots\n";
 	}
-	if (clipMap.size())
+	if (orphans.size() && !records)
 	{
-		std::cout << "(!!) There are orphaned clips\n";
-		foreach (QString id, clipMap.keys())
+		out << "(!!) There are orphaned clips\n";
+		foreach (const MXF::ShotGraph::Shot *shot, orphans)
 		{
-			MXF::ClipInfo clip = clipMap[id];
-			std::cout << "Start time: "
-			          << clip.metaData().shootStart().toString("yyyy-MM-dd HH:mm:ss").toStdString()
-			          << "\n";
-			int duration = clip.duration() * clip.editUnit().numerator / clip.editUnit().denominator;
-
-			std::cout << "Clip: "
-			          << clipSourceMap[clip.globalClipID()].toStdString()
-			          << "_" << clip.clipName().toStdString()
-			          << " ("
-			          << duration / 60 << ":" << std::setw(2) << std::setfill('0') << duration % 60
-			          << ")\n";
-			std::cout << "Relations:\n"
-			          << "Top:  "
-			          << clipSourceMap[clip.relation().connectionTop.globalClipId].toStdString()
-			          << "_"
-			          << clip.relation().connectionTop.clipName.toStdString() << "\n";
-			if (clip.relation().connectionPrevious.isSet())
-				std::cout
-				      << "Prev: "
-				      << clipSourceMap[clip.relation().connectionPrevious.globalClipId].toStdString()
-				      << "_"
-				      << clip.relation().connectionPrevious.clipName.toStdString() << "\n";
-			if (clip.relation().connectionPrevious.isSet())
-				std::cout
-				      << "Next: "
-				      << clipSourceMap[clip.relation().connectionNext.globalClipId].toStdString()
-				      << "_"
-				      << clip.relation().connectionNext.clipName.toStdString() << "\n";
-
+			foreach (int i, shot->clips)
+			{
+				ClipEntry entry = store.entry(i);
+				const MXF::ClipInfo &clip = entry.clip;
+				const MXF::ClipRelation &relation = clip.relation();
+				out << "Start time: "
+				    << clip.metaData().shootStart().toString("yyyy-MM-dd HH:mm:ss")
+				    << "\n";
+				out << "Clip: "
+				    << entry.source
+				    << "_" << clip.clipName()
+				    << " (" << durationString(clip) << ")\n";
+				out << "Relations:\n"
+				    << "Top:  "
+				    << sourceOf(relation.connectionTop.globalClipId)
+				    << "_"
+				    << relation.connectionTop.clipName << "\n";
+				if (relation.connectionPrevious.isSet())
+					out << "Prev: "
+					    << sourceOf(relation.connectionPrevious.globalClipId)
+					    << "_"
+					    << relation.connectionPrevious.clipName << "\n";
+				if (relation.connectionNext.isSet())
+					out << "Next: "
+					    << sourceOf(relation.connectionNext.globalClipId)
+					    << "_"
+					    << relation.connectionNext.clipName << "\n";
+			}
 		}
 	}
 	if (html)
 	{
-		std::cout << "</body></html>\n\n";
+		out << "</body></html>\n\n";
 	}
-	qDebug() << clipList.size() << "clips found";
+	qDebug() << store.size() << "clips found";
+	if (store.isBounded())
+		qDebug() << "sorted in" << store.spilledRuns() + 1 << "runs";
+	qDebug() << "thumbnails:" << thumbnails.hits() << "cached," << thumbnails.misses() << "encoded";
+	if (waveformWidth)
+		qDebug() << "waveforms:" << waveforms.hits() << "cached," << waveforms.misses() << "read";
 
-    std::cout << "\n\n=======\n";
+	if (outputDir.isEmpty() && !records)
+		out << "\n\n=======\n";
+	out.flush();
+	if (outFile.error() != QFile::NoError)
+	{
+		qCritical() << outFile.fileName() << ":" << outFile.errorString();
+		return 2;
+	}
 
 
 	return 0;
@@ -1,4 +1,4 @@
-QT += core xmlpatterns xml gui
+QT += core xmlpatterns gui
 
 CONFIG += c++11
 
@@ -9,7 +9,14 @@ CONFIG -= app_bundle
 TEMPLATE = app
 
 SOURCES += main.cpp \
-    mxfmeta.cpp
+    thumbnailcache.cpp \
+    waveformcache.cpp \
+    clipstore.cpp
+
+HEADERS += \
+    thumbnailcache.h \
+    waveformcache.h \
+    clipstore.h
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which as been marked deprecated (the exact warnings
@@ -22,12 +29,11 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-HEADERS += \
-    mxfmeta.h
-
 DISTFILES += \
     0002I4.XML \
     sitehead.html
 
 RESOURCES += \
     testdata.qrc
+
+include(../common/common.pri)
@@ -0,0 +1,185 @@
+#include "thumbnailcache.h"
+#include "xxhash64.h"
+#include "klvreader.h"
+#include "dvthumbnail.h"
+#include <QtConcurrent>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QImage>
+#include <QBuffer>
+#include <QStandardPaths>
+
+ThumbnailCache::ThumbnailCache(const QString &cacheDir) :
+    mDir(cacheDir),
+    mFormat("png"),
+    mHits(0),
+    mMisses(0)
+{
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+	mPool.waitForDone();
+}
+
+QString ThumbnailCache::defaultLocation()
+{
+	QString base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+	if (base.isEmpty())
+		return QString();
+	return base + "/p2_cuesheet/thumbnails";
+}
+
+void ThumbnailCache::setFormat(const QByteArray &format)
+{
+	mFormat = format.toLower();
+	if (mFormat == "jpeg")
+		mFormat = "jpg";
+}
+
+QByteArray ThumbnailCache::format() const
+{
+	return mFormat;
+}
+
+QString ThumbnailCache::mimeType() const
+{
+	if (mFormat == "jpg")
+		return QStringLiteral("image/jpeg");
+	return QStringLiteral("image/") + QString::fromLatin1(mFormat);
+}
+
+QString ThumbnailCache::cacheFile(const QFileInfo &source, int frames) const
+{
+	if (mDir.isEmpty())
+		return QString();
+	QByteArray key = source.absoluteFilePath().toUtf8();
+	key += '\n' + QByteArray::number(source.size());
+	key += '\n' + QByteArray::number(source.lastModified().toMSecsSinceEpoch());
+	if (frames)
+		key += "\nfilmstrip " + QByteArray::number(frames);
+	QString name = QString::number(MXF::XxHash64::hash(reinterpret_cast<const uchar *>(key.constData()), key.size()), 16)
+	        .rightJustified(16, '0');
+	// two levels keep folders small on archives with many thousand clips
+	return QStringLiteral("%1/%2/%3.%4").arg(mDir, name.left(2), name, QString::fromLatin1(mFormat));
+}
+
+void ThumbnailCache::request(const QString &iconPath)
+{
+	request(iconPath, 0);
+}
+
+QByteArray ThumbnailCache::data(const QString &iconPath)
+{
+	return data(iconPath, 0);
+}
+
+void ThumbnailCache::requestFilmstrip(const QString &videoPath, int frames)
+{
+	if (frames > 0)
+		request(videoPath, frames);
+}
+
+QByteArray ThumbnailCache::filmstripData(const QString &videoPath, int frames)
+{
+	if (frames <= 0)
+		return QByteArray();
+	return data(videoPath, frames);
+}
+
+void ThumbnailCache::request(const QString &path, int frames)
+{
+	QString key = frames ? path + '#' + QString::number(frames) : path;
+	if (mPending.contains(key) || mCached.contains(key))
+		return;
+	QFileInfo source(path);
+	if (!source.isFile())
+		return;
+	QString file = cacheFile(source, frames);
+	if (!file.isEmpty() && QFileInfo(file).isFile())
+	{
+		mCached.insert(key, file);
+		mHits++;
+		return;
+	}
+	mMisses++;
+	mPending.insert(key, QtConcurrent::run(&mPool, &ThumbnailCache::encode, path, frames, mFormat, file));
+}
+
+QByteArray ThumbnailCache::data(const QString &path, int frames)
+{
+	request(path, frames);
+	QString key = frames ? path + '#' + QString::number(frames) : path;
+	if (mPending.contains(key))
+		return mPending.take(key).result();
+	// each picture is collected once, so the entry is dropped with it
+	QString cached = mCached.take(key);
+	if (cached.isEmpty())
+		return QByteArray();
+	QFile file(cached);
+	if (file.open(QIODevice::ReadOnly))
+		return file.readAll();
+	return QByteArray();
+}
+
+int ThumbnailCache::hits() const
+{
+	return mHits;
+}
+
+int ThumbnailCache::misses() const
+{
+	return mMisses;
+}
+
+QByteArray ThumbnailCache::encode(const QString &path, int frames, const QByteArray &format, const QString &cacheFile)
+{
+	QByteArray data;
+	QImage image = frames ? filmstrip(path, frames) : QImage(path);
+	if (image.isNull())
+		return data;
+	QBuffer buff(&data);
+	image.save(&buff, format.constData());
+	if (cacheFile.isEmpty() || data.isEmpty())
+		return data;
+
+	// a failed write only costs the next run another encode
+	QDir().mkpath(QFileInfo(cacheFile).path());
+	QSaveFile out(cacheFile);
+	if (out.open(QIODevice::WriteOnly))
+	{
+		out.write(data);
+		out.commit();
+	}
+	return data;
+}
+
+/** only the frames shown are read: the essence is mapped and DV frames
+ * have a constant size, so frame n is found without reading the ones before */
+QImage ThumbnailCache::filmstrip(const QString &videoPath, int frames)
+{
+	MXF::KlvReader reader(videoPath);
+	qint64 count = reader.isOpen() ? reader.editUnitCount() : 0;
+	if (count <= 0)
+		return QImage();
+	frames = int(qMin<qint64>(frames, count));
+	QImage strip;
+	for (int i = 0; i < frames; ++i)
+	{
+		MXF::Span frame = reader.editUnits((2 * i + 1) * count / (2 * frames));
+		QSize size = MXF::dvDcSize(frame.data, frame.size);
+		if (size.isEmpty())
+			return QImage();
+		if (strip.isNull())
+		{
+			strip = QImage(size.width() * frames, size.height(), QImage::Format_RGB32);
+			strip.fill(Qt::black);
+		}
+		if (strip.height() != size.height())
+			return QImage();
+		MXF::decodeDvDc(frame.data, frame.size, strip.bits() + i * size.width() * 4, strip.bytesPerLine());
+	}
+	return strip;
+}
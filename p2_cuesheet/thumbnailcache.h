@@ -0,0 +1,64 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QFuture>
+#include <QThreadPool>
+
+class QFileInfo;
+class QImage;
+
+/**
+ * Clip icons re-encoded as PNG (or another image format), kept on disk between runs.
+ * Entries are keyed by icon path, size and modification time, so an icon
+ * that did not change is never decoded again. Misses are encoded on a
+ * thread pool; request() as early as possible and collect with data().
+ * Filmstrips of DV video files are kept the same way.
+ */
+class ThumbnailCache
+{
+public:
+	/** an empty cacheDir keeps nothing on disk */
+	explicit ThumbnailCache(const QString &cacheDir = defaultLocation());
+	~ThumbnailCache();
+
+	/** image format the icons are encoded to, "png" by default; set before the first request() */
+	void setFormat(const QByteArray &format);
+	QByteArray format() const;
+	/** mime type matching format(), for data: urls */
+	QString mimeType() const;
+
+	/** starts encoding iconPath unless it is cached already */
+	void request(const QString &iconPath);
+	/** encoded icon, waits for a pending encode; empty if the icon can't be read */
+	QByteArray data(const QString &iconPath);
+	/** starts rendering frames pictures of the DV essence in videoPath side
+	 * by side, evenly spread over the clip (see MXF::decodeDvDc()) */
+	void requestFilmstrip(const QString &videoPath, int frames);
+	/** encoded filmstrip, empty if the video is no DV25/DV50 essence */
+	QByteArray filmstripData(const QString &videoPath, int frames);
+
+	int hits() const;
+	int misses() const;
+
+	static QString defaultLocation();
+
+private:
+	/** frames is 0 for the icon itself */
+	void request(const QString &path, int frames);
+	QByteArray data(const QString &path, int frames);
+	QString cacheFile(const QFileInfo &source, int frames) const;
+	static QByteArray encode(const QString &path, int frames, const QByteArray &format, const QString &cacheFile);
+	static QImage filmstrip(const QString &videoPath, int frames);
+
+	QString mDir;
+	QByteArray mFormat;
+	QThreadPool mPool;
+	QHash<QString, QFuture<QByteArray> > mPending;
+	QHash<QString, QString> mCached;
+	int mHits;
+	int mMisses;
+};
+
+#endif // THUMBNAILCACHE_H
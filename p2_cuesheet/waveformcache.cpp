@@ -0,0 +1,225 @@
+#include "waveformcache.h"
+#include "xxhash64.h"
+#include "klvreader.h"
+#include <QtConcurrent>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <fcntl.h>
+#include <math.h>
+
+/// "P2PK", followed by the format version
+static const quint32 peakFileMagic = 0x5032504b;
+static const quint16 peakFileVersion = 1;
+/// peaks per second of audio
+static const int bucketsPerSecond = 10;
+
+WaveformCache::WaveformCache(const QString &cacheDir) :
+    mDir(cacheDir),
+    mHits(0),
+    mMisses(0)
+{
+	// the clips mostly sit on the same card reader, more streams only seek
+	mPool.setMaxThreadCount(2);
+}
+
+WaveformCache::~WaveformCache()
+{
+	mPool.waitForDone();
+}
+
+QString WaveformCache::defaultLocation()
+{
+	QString base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+	if (base.isEmpty())
+		return QString();
+	return base + "/p2_cuesheet/peaks";
+}
+
+QString WaveformCache::cacheFile(const QStringList &audioFiles) const
+{
+	if (mDir.isEmpty())
+		return QString();
+	QByteArray key;
+	foreach(const QString &file, audioFiles)
+	{
+		QFileInfo info(file);
+		key += info.absoluteFilePath().toUtf8();
+		key += '\n' + QByteArray::number(info.size());
+		key += '\n' + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + '\n';
+	}
+	QString name = QString::number(MXF::XxHash64::hash(reinterpret_cast<const uchar *>(key.constData()), key.size()), 16)
+	        .rightJustified(16, '0');
+	return QStringLiteral("%1/%2/%3.peaks").arg(mDir, name.left(2), name);
+}
+
+void WaveformCache::request(const QStringList &audioFiles, int bitsPerSample, int samplingRate)
+{
+	QString key = audioFiles.join('\n');
+	if (audioFiles.isEmpty() || mPending.contains(key) || mCached.contains(key))
+		return;
+	QString file = cacheFile(audioFiles);
+	if (!file.isEmpty() && QFileInfo(file).isFile())
+	{
+		mCached.insert(key, file);
+		mHits++;
+		return;
+	}
+	mMisses++;
+	mPending.insert(key, QtConcurrent::run(&mPool, &WaveformCache::compute, audioFiles,
+	                                       bitsPerSample, samplingRate, file));
+}
+
+WaveformCache::Peaks WaveformCache::peaks(const QStringList &audioFiles)
+{
+	QString key = audioFiles.join('\n');
+	if (mPending.contains(key))
+		return mPending.take(key).result();
+	QString cached = mCached.take(key);
+	if (cached.isEmpty())
+		return Peaks();
+	return load(cached);
+}
+
+QString WaveformCache::svg(const QStringList &audioFiles, int width, int height)
+{
+	Peaks p = peaks(audioFiles);
+	int buckets = p.buckets();
+	if (!buckets || (width <= 0) || (height <= 0))
+		return QString();
+
+	// one column per pixel, over all channels
+	QString peakPath;
+	QString rmsPath;
+	const double scale = height / 65536.0;
+	const int middle = height / 2;
+	for (int x = 0; x < width; ++x)
+	{
+		int first = int(qint64(x) * buckets / width);
+		int last = qMax(first + 1, int(qint64(x + 1) * buckets / width));
+		int min = 32767;
+		int max = -32768;
+		double squares = 0;
+		for (int c = 0; c < p.channels; ++c)
+		{
+			const MXF::AudioPeak *peak = p.peaks.constData() + c * buckets;
+			for (int i = first; i < last; ++i)
+			{
+				min = qMin<int>(min, peak[i].min);
+				max = qMax<int>(max, peak[i].max);
+				squares += double(peak[i].rms) * peak[i].rms;
+			}
+		}
+		double rms = sqrt(squares / ((last - first) * p.channels));
+		int top = middle - qRound(max * scale);
+		int bottom = qMax(top + 1, middle - qRound(min * scale));
+		peakPath += QStringLiteral("M%1.5 %2V%3").arg(x).arg(top).arg(bottom);
+		int rmsHeight = qRound(rms * scale);
+		if (rmsHeight)
+			rmsPath += QStringLiteral("M%1.5 %2V%3").arg(x).arg(middle - rmsHeight).arg(middle + rmsHeight);
+	}
+	return QStringLiteral("<svg class=\"waveform\" xmlns=\"http://www.w3.org/2000/svg\" "
+	                      "width=\"%1\" height=\"%2\" viewBox=\"0 0 %1 %2\">"
+	                      "<path d=\"%3\" stroke=\"#8ab\" fill=\"none\"/>"
+	                      "<path d=\"%4\" stroke=\"#246\" fill=\"none\"/></svg>")
+	        .arg(width).arg(height).arg(peakPath, rmsPath);
+}
+
+int WaveformCache::hits() const
+{
+	return mHits;
+}
+
+int WaveformCache::misses() const
+{
+	return mMisses;
+}
+
+WaveformCache::Peaks WaveformCache::compute(const QStringList &audioFiles, int bitsPerSample,
+                                            int samplingRate, const QString &cacheFile)
+{
+	Peaks result;
+	int bytesPerSample = (bitsPerSample + 7) / 8;
+	if (bytesPerSample < 2)
+		return result;
+	result.samplingRate = samplingRate;
+	result.samplesPerBucket = samplingRate > 0 ? samplingRate / bucketsPerSecond : 4800;
+
+	QList<QVector<MXF::AudioPeak> > channels;
+	int buckets = 0;
+	foreach(const QString &file, audioFiles)
+	{
+		MXF::KlvReader reader(file);
+		MXF::Span pcm = reader.isOpen() ? reader.essence() : MXF::Span();
+		if (pcm.isNull())
+			continue;
+		// read once front to back; the pages are not needed again
+		posix_fadvise(reader.handle(), reader.fileOffset(pcm), pcm.size, POSIX_FADV_SEQUENTIAL);
+		qint64 samples = pcm.size / bytesPerSample;
+		QVector<MXF::AudioPeak> peaks(int((samples + result.samplesPerBucket - 1) / result.samplesPerBucket));
+		MXF::pcmPeaks(pcm.data, bytesPerSample, samples, result.samplesPerBucket, peaks.data());
+		posix_fadvise(reader.handle(), reader.fileOffset(pcm), pcm.size, POSIX_FADV_DONTNEED);
+		buckets = qMax(buckets, peaks.size());
+		channels.append(peaks);
+	}
+	if (channels.isEmpty() || !buckets)
+		return result;
+
+	// channels that end early are silent for the rest
+	MXF::AudioPeak silence = { 0, 0, 0 };
+	result.channels = channels.size();
+	result.peaks.reserve(result.channels * buckets);
+	foreach(const QVector<MXF::AudioPeak> &peaks, channels)
+	{
+		result.peaks += peaks;
+		for (int i = peaks.size(); i < buckets; ++i)
+			result.peaks.append(silence);
+	}
+	if (!cacheFile.isEmpty())
+		save(result, cacheFile);
+	return result;
+}
+
+WaveformCache::Peaks WaveformCache::load(const QString &cacheFile)
+{
+	Peaks p;
+	QFile file(cacheFile);
+	if (!file.open(QIODevice::ReadOnly))
+		return p;
+	QDataStream in(&file);
+	quint32 magic;
+	quint16 version;
+	qint32 channels, samplingRate, samplesPerBucket, buckets;
+	in >> magic >> version >> channels >> samplingRate >> samplesPerBucket >> buckets;
+	if ((in.status() != QDataStream::Ok) || (magic != peakFileMagic) || (version != peakFileVersion)
+	        || (channels <= 0) || (buckets < 0) || (qint64(channels) * buckets * 6 > file.size()))
+		return p;
+	QVector<MXF::AudioPeak> peaks(channels * buckets);
+	for (int i = 0; i < peaks.size(); ++i)
+		in >> peaks[i].min >> peaks[i].max >> peaks[i].rms;
+	if (in.status() != QDataStream::Ok)
+		return p;
+	p.channels = channels;
+	p.samplingRate = samplingRate;
+	p.samplesPerBucket = samplesPerBucket;
+	p.peaks = peaks;
+	return p;
+}
+
+void WaveformCache::save(const Peaks &peaks, const QString &cacheFile)
+{
+	// a failed write only costs the next run another pass over the audio
+	QDir().mkpath(QFileInfo(cacheFile).path());
+	QSaveFile out(cacheFile);
+	if (!out.open(QIODevice::WriteOnly))
+		return;
+	QDataStream s(&out);
+	s << peakFileMagic << peakFileVersion << qint32(peaks.channels) << qint32(peaks.samplingRate)
+	  << qint32(peaks.samplesPerBucket) << qint32(peaks.buckets());
+	foreach(const MXF::AudioPeak &p, peaks.peaks)
+		s << p.min << p.max << p.rms;
+	out.commit();
+}
@@ -0,0 +1,67 @@
+#ifndef WAVEFORMCACHE_H
+#define WAVEFORMCACHE_H
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QFuture>
+#include <QThreadPool>
+#include "audiopeaks.h"
+
+/**
+ * Audio levels of clips for the cue sheet. The PCM essence of all channels
+ * of a clip is read once, front to back, and summed up to min/max/RMS peaks
+ * of 100 ms buckets (see MXF::pcmPeaks()). The peaks are kept on disk as a
+ * small peak file keyed by the audio files' paths, sizes and modification
+ * times, so a later run renders the waveform without reading any audio.
+ * Misses are computed on a thread pool; request() early, collect with svg().
+ */
+class WaveformCache
+{
+public:
+	/** the peaks of one clip, channel after channel */
+	struct Peaks
+	{
+		Peaks() : channels(0), samplingRate(0), samplesPerBucket(0) {}
+		bool isNull() const { return !channels; }
+		int buckets() const { return channels ? peaks.size() / channels : 0; }
+		int channels;
+		int samplingRate;
+		int samplesPerBucket;
+		QVector<MXF::AudioPeak> peaks;
+	};
+
+	/** an empty cacheDir keeps nothing on disk */
+	explicit WaveformCache(const QString &cacheDir = defaultLocation());
+	~WaveformCache();
+
+	/** starts reading the audio files of a clip unless their peaks are cached.
+	 * bitsPerSample and samplingRate as given by MXF::AudioInfo */
+	void request(const QStringList &audioFiles, int bitsPerSample, int samplingRate);
+	/** waits for a pending request; null if none of the files could be read */
+	Peaks peaks(const QStringList &audioFiles);
+	/** an inline svg of width x height pixels showing the peaks of all
+	 * channels merged, empty if there are none */
+	QString svg(const QStringList &audioFiles, int width, int height);
+
+	int hits() const;
+	int misses() const;
+
+	static QString defaultLocation();
+
+private:
+	QString cacheFile(const QStringList &audioFiles) const;
+	static Peaks compute(const QStringList &audioFiles, int bitsPerSample, int samplingRate,
+	                     const QString &cacheFile);
+	static Peaks load(const QString &cacheFile);
+	static void save(const Peaks &peaks, const QString &cacheFile);
+
+	QString mDir;
+	QThreadPool mPool;
+	QHash<QString, QFuture<Peaks> > mPending;
+	QHash<QString, QString> mCached;
+	int mHits;
+	int mMisses;
+};
+
+#endif // WAVEFORMCACHE_H
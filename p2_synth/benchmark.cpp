@@ -0,0 +1,353 @@
+#include "benchmark.h"
+#include "p2card.h"
+#include "mxfmeta.h"
+#include "shotgraph.h"
+#include "audiopeaks.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QFile>
+#include <QImage>
+#include <QBuffer>
+#include <QDomDocument>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// every heap allocation of the program passes here
+static std::atomic<qint64> allocationCount(0);
+
+void *operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) Q_DECL_NOTHROW
+{
+	free(p);
+}
+
+void operator delete[](void *p) Q_DECL_NOTHROW
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) Q_DECL_NOTHROW
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) Q_DECL_NOTHROW
+{
+	free(p);
+}
+
+/** wall time and allocations between construction and stop() */
+class Measurement
+{
+public:
+	Measurement() :
+	    mAllocations(allocationCount.load())
+	{
+		mTimer.start();
+	}
+	void stop()
+	{
+		mNsecs = mTimer.nsecsElapsed();
+		mAllocations = allocationCount.load() - mAllocations;
+	}
+	qint64 nsecs() const { return mNsecs; }
+	qint64 allocations() const { return mAllocations; }
+
+private:
+	QElapsedTimer mTimer;
+	qint64 mNsecs;
+	qint64 mAllocations;
+};
+
+/** the fields ClipInfo read from the DOM before the streaming parser */
+struct DomClip
+{
+	DomClip() : duration(0), offsetInShot(0), videoOffset(0), videoSize(0),
+	    thumbnailOffset(0), thumbnailWidth(0), thumbnailHeight(0) {}
+	QString clipName, globalClipId, shotId, userClipName, dataSource;
+	int duration, offsetInShot;
+	QStringList editUnit, connections, video, audio, device;
+	QDateTime creation, lastUpdate, shootStart, shootEnd;
+	qint64 videoOffset, videoSize;
+	int thumbnailOffset, thumbnailWidth, thumbnailHeight;
+	QString thumbnailFormat;
+};
+
+static QString domText(const QDomElement &e, const char *name)
+{
+	return e.firstChildElement(QLatin1String(name)).text();
+}
+
+/** what ClipInfo did before the streaming parser: build the DOM, then
+ * look up every field it kept */
+static DomClip domClip(const QByteArray &data)
+{
+	DomClip c;
+	QDomDocument doc;
+	if (!doc.setContent(data))
+		return c;
+	QDomElement content = doc.documentElement().firstChildElement(QStringLiteral("ClipContent"));
+	c.clipName = domText(content, "ClipName");
+	c.globalClipId = domText(content, "GlobalClipID");
+	c.duration = domText(content, "Duration").toInt();
+	c.editUnit = domText(content, "EditUnit").split('/');
+
+	QDomElement relation = content.firstChildElement(QStringLiteral("Relation"));
+	c.offsetInShot = domText(relation, "OffsetInShot").toInt();
+	c.shotId = domText(relation, "GlobalShotID");
+	QDomElement connection = relation.firstChildElement(QStringLiteral("Connection"));
+	foreach(const char *link, QList<const char *>() << "Top" << "Previous" << "Next")
+	{
+		QDomElement e = connection.firstChildElement(QLatin1String(link));
+		c.connections << domText(e, "ClipName") << domText(e, "GlobalClipID") << domText(e, "P2SerialNo.");
+	}
+
+	QDomNodeList essences = content.firstChildElement(QStringLiteral("EssenceList")).childNodes();
+	for (int i = 0; i < essences.length(); ++i)
+	{
+		QDomElement e = essences.at(i).toElement();
+		if (e.tagName() == "Video")
+		{
+			c.video << e.attribute("ValidAudioFlag") << domText(e, "VideoFormat") << domText(e, "Codec")
+			        << domText(e, "FrameRate") << domText(e, "AspectRatio") << domText(e, "StartBinaryGroup")
+			        << domText(e, "StartTimecode").split(':');
+			QDomElement index = e.firstChildElement(QStringLiteral("VideoIndex"));
+			c.videoOffset = domText(index, "StartByteOffset").toLongLong();
+			c.videoSize = domText(index, "DataSize").toLongLong();
+		}
+		else if (e.tagName() == "Audio")
+		{
+			c.audio << domText(e, "AudioFormat") << domText(e, "SamplingRate") << domText(e, "BitsPerSample");
+		}
+	}
+
+	QDomElement meta = content.firstChildElement(QStringLiteral("ClipMetadata"));
+	c.userClipName = domText(meta, "UserClipName");
+	c.dataSource = domText(meta, "DataSource");
+	QDomElement access = meta.firstChildElement(QStringLiteral("Access"));
+	c.creation = QDateTime::fromString(domText(access, "CreationDate"), Qt::ISODate);
+	c.lastUpdate = QDateTime::fromString(domText(access, "LastUpdateDate"), Qt::ISODate);
+	QDomElement device = meta.firstChildElement(QStringLiteral("Device"));
+	c.device << domText(device, "Manufacturer") << domText(device, "SerialNo.") << domText(device, "ModelName");
+	QDomElement shoot = meta.firstChildElement(QStringLiteral("Shoot"));
+	c.shootStart = QDateTime::fromString(domText(shoot, "StartDate"), Qt::ISODate);
+	c.shootEnd = QDateTime::fromString(domText(shoot, "EndDate"), Qt::ISODate);
+	QDomElement thumbnail = meta.firstChildElement(QStringLiteral("Thumbnail"));
+	c.thumbnailOffset = domText(thumbnail, "FrameOffset").toInt();
+	c.thumbnailFormat = domText(thumbnail, "ThumbnailFormat");
+	c.thumbnailWidth = domText(thumbnail, "Width").toInt();
+	c.thumbnailHeight = domText(thumbnail, "Height").toInt();
+	return c;
+}
+
+static bool shootStartLessThan(const MXF::ClipInfo &a, const MXF::ClipInfo &b)
+{
+	return a.metaData().shootStart() < b.metaData().shootStart();
+}
+
+Benchmark::Benchmark() :
+    mThumbnailSamples(500)
+{
+}
+
+void Benchmark::setCuesheet(const QString &program)
+{
+	mCuesheet = program;
+}
+
+void Benchmark::setThumbnailSamples(int samples)
+{
+	mThumbnailSamples = samples;
+}
+
+QString Benchmark::errorString() const
+{
+	return mError;
+}
+
+QList<Benchmark::Result> Benchmark::results() const
+{
+	return mResults;
+}
+
+void Benchmark::add(const QString &label, const QString &phase, int items, qint64 nsecs, qint64 allocations)
+{
+	Result r;
+	r.tree = label;
+	r.phase = phase;
+	r.items = items;
+	r.nsecs = nsecs;
+	r.allocations = allocations;
+	mResults.append(r);
+}
+
+bool Benchmark::run(const QString &path, const QString &label)
+{
+	Measurement discover;
+	QList<MXF::Card> cards = MXF::findCards(path);
+	discover.stop();
+	int files = 0;
+	foreach(const MXF::Card &card, cards)
+		files += card.clips.size();
+	if (!files)
+	{
+		mError = QStringLiteral("%1: no clips found").arg(path);
+		return false;
+	}
+	add(label, "discover", cards.size(), discover.nsecs(), discover.allocations());
+
+	QList<QByteArray> xml;
+	QStringList icons;
+	xml.reserve(files);
+	Measurement read;
+	foreach(const MXF::Card &card, cards)
+	{
+		foreach(const MXF::CardFile &file, card.clips)
+		{
+			QFile f(card.contents() + "CLIP/" + file.name);
+			if (f.open(QIODevice::ReadOnly))
+				xml.append(f.readAll());
+		}
+	}
+	read.stop();
+	add(label, "read xml", xml.size(), read.nsecs(), read.allocations());
+
+	QList<MXF::ClipInfo> clips;
+	clips.reserve(xml.size());
+	Measurement parse;
+	foreach(const QByteArray &data, xml)
+		clips.append(MXF::ClipInfo(data));
+	parse.stop();
+	add(label, "parse", clips.size(), parse.nsecs(), parse.allocations());
+
+	// the DOM path ClipInfo took before, for comparison
+	Measurement dom;
+	int domClips = 0;
+	foreach(const QByteArray &data, xml)
+	{
+		if (!domClip(data).clipName.isEmpty())
+			domClips++;
+	}
+	dom.stop();
+	add(label, "parse (QDomDocument)", domClips, dom.nsecs(), dom.allocations());
+
+	Measurement group;
+	QList<MXF::ClipInfo> sorted = clips;
+	std::stable_sort(sorted.begin(), sorted.end(), shootStartLessThan);
+	QVector<MXF::ShotGraph::Links> links;
+	links.reserve(sorted.size());
+	foreach(const MXF::ClipInfo &clip, sorted)
+		links.append(MXF::ShotGraph::links(clip));
+	MXF::ShotGraph graph(links);
+	group.stop();
+	add(label, "sort + group", sorted.size(), group.nsecs(), group.allocations());
+
+	// only the comparisons, to show they do not allocate
+	Measurement sort;
+	std::stable_sort(sorted.begin(), sorted.end(), shootStartLessThan);
+	sort.stop();
+	add(label, "re-sort", sorted.size(), sort.nsecs(), sort.allocations());
+
+	foreach(const MXF::Card &card, cards)
+	{
+		foreach(const MXF::CardFile &icon, card.icons)
+		{
+			if (icons.size() >= mThumbnailSamples)
+				break;
+			icons.append(card.contents() + "ICON/" + icon.name);
+		}
+	}
+	if (icons.size())
+	{
+		Measurement thumbs;
+		foreach(const QString &icon, icons)
+		{
+			QImage image(icon);
+			QByteArray png;
+			QBuffer buffer(&png);
+			image.save(&buffer, "PNG");
+		}
+		thumbs.stop();
+		add(label, "thumbnail bmp -> png", icons.size(), thumbs.nsecs(), thumbs.allocations());
+	}
+
+	// the 16 bit kernel behind --waveform, on noise in memory; the items
+	// are MiB, so the time per item gives the throughput of one core
+	const int peakMiB = 32;
+	const int peakPasses = 4;
+	const qint64 bucket = 4800;    // 100 ms at 48 kHz
+	QVector<qint16> pcm(peakMiB * 1024 * 1024 / 2);
+	quint32 noise = 1;
+	for (int i = 0; i < pcm.size(); ++i)
+	{
+		noise = noise * 1664525u + 1013904223u;
+		pcm[i] = qint16(noise >> 16);
+	}
+	QVector<MXF::AudioPeak> peaks(int((pcm.size() + bucket - 1) / bucket));
+	Measurement peak;
+	for (int pass = 0; pass < peakPasses; ++pass)
+		MXF::pcmPeaks(reinterpret_cast<const uchar *>(pcm.constData()), 2, pcm.size(), bucket, peaks.data());
+	peak.stop();
+	add(label, QStringLiteral("audio peaks (MiB, %1)").arg(MXF::pcmPeaksKernel()),
+	    peakMiB * peakPasses, peak.nsecs(), peak.allocations());
+
+	if (!mCuesheet.isEmpty())
+	{
+		// an empty cache folder first, then the same again with the cache filled
+		QTemporaryDir work;
+		QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+		env.insert("XDG_CACHE_HOME", work.path() + "/cache");
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			QProcess cuesheet;
+			cuesheet.setProcessEnvironment(env);
+			cuesheet.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+			cuesheet.setStandardOutputFile(QProcess::nullDevice());
+			QElapsedTimer timer;
+			timer.start();
+			cuesheet.start(mCuesheet, QStringList() << "-o" << work.path() + "/out" << path);
+			if (!cuesheet.waitForFinished(-1) || cuesheet.exitCode() != 0)
+			{
+				mError = QStringLiteral("%1: %2").arg(mCuesheet, cuesheet.errorString());
+				return false;
+			}
+			add(label, pass ? "cuesheet (warm cache)" : "cuesheet (cold cache)",
+			    clips.size(), timer.nsecsElapsed(), -1);
+		}
+	}
+	return true;
+}
+
+void Benchmark::printReport(QTextStream &out) const
+{
+	out << QString("%1  %2  %3  %4  %5  %6\n")
+	       .arg("tree", -12).arg("phase", -24).arg("items", 8).arg("total ms", 10)
+	       .arg("us/item", 9).arg("allocs/item", 11);
+	foreach(const Result &r, mResults)
+	{
+		double perItem = r.items ? r.nsecs / 1000.0 / r.items : 0;
+		QString allocations = r.allocations < 0 ? QString("-")
+		                                        : QString::number(r.items ? double(r.allocations) / r.items : 0, 'f', 2);
+		out << QString("%1  %2  %3  %4  %5  %6\n")
+		       .arg(r.tree, -12).arg(r.phase, -24).arg(r.items, 8)
+		       .arg(r.nsecs / 1e6, 10, 'f', 1).arg(perItem, 9, 'f', 2).arg(allocations, 11);
+	}
+	out.flush();
+}
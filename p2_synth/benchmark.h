@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+#include <QString>
+#include <QList>
+
+class QTextStream;
+
+/**
+ * Times the metadata pipeline of the tools on a card tree: discovery,
+ * reading and parsing the clip xml (with a QDomDocument pass as the
+ * baseline), sorting and shot grouping, thumbnail encoding, the audio peak
+ * kernel and, if a p2_cuesheet binary is given, a cold and a warm cuesheet
+ * run. Heap
+ * allocations are counted for every phase.
+ */
+class Benchmark
+{
+public:
+	struct Result
+	{
+		QString tree;
+		QString phase;
+		int items;
+		qint64 nsecs;
+		qint64 allocations;
+	};
+
+	Benchmark();
+	/** p2_cuesheet binary for the rendering phases, skipped if empty */
+	void setCuesheet(const QString &program);
+	/** icons decoded and encoded in the thumbnail phase */
+	void setThumbnailSamples(int samples);
+
+	/** runs all phases on the cards in path, label names the rows */
+	bool run(const QString &path, const QString &label);
+	QString errorString() const;
+	QList<Result> results() const;
+	void printReport(QTextStream &out) const;
+
+private:
+	void add(const QString &label, const QString &phase, int items, qint64 nsecs, qint64 allocations);
+
+	QString mCuesheet;
+	int mThumbnailSamples;
+	QList<Result> mResults;
+	QString mError;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,292 @@
+#include "cardgenerator.h"
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QImage>
+#include <QBuffer>
+#include <QColor>
+#include <QStringList>
+
+CardGenerator::Options::Options() :
+    cards(4),
+    clips(1000),
+    spanned(0.2),
+    maxSpan(3),
+    orphans(0),
+    broken(0),
+    audioChannels(4),
+    icons(true),
+    essenceSize(0),
+    seed(1)
+{
+}
+
+CardGenerator::CardGenerator(const Options &options) :
+    mOptions(options),
+    mState(0),
+    mClipsWritten(0)
+{
+}
+
+QString CardGenerator::errorString() const
+{
+	return mError;
+}
+
+int CardGenerator::clipsWritten() const
+{
+	return mClipsWritten;
+}
+
+int CardGenerator::shotsWritten() const
+{
+	return mShotIds.size();
+}
+
+quint32 CardGenerator::random()
+{
+	// xorshift64*, plenty for test data and the same everywhere
+	mState ^= mState >> 12;
+	mState ^= mState << 25;
+	mState ^= mState >> 27;
+	return quint32((mState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+QString CardGenerator::umid()
+{
+	// SMPTE UMID label as the cameras write it, random material number
+	QString id = QStringLiteral("060A2B340101010501010D4313000000");
+	for (int i = 0; i < 4; ++i)
+		id += QString::number(random(), 16).rightJustified(8, '0').toUpper();
+	return id;
+}
+
+bool CardGenerator::writeFile(const QString &fileName, const QByteArray &data, qint64 size)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+	        || file.write(data) != data.size()
+	        || (size > data.size() && !file.resize(size)))
+	{
+		mError = QStringLiteral("%1: %2").arg(fileName, file.errorString());
+		return false;
+	}
+	return true;
+}
+
+static QByteArray isoTime(qint64 msecs)
+{
+	return QDateTime::fromMSecsSinceEpoch(msecs, Qt::OffsetFromUTC, 3600).toString(Qt::ISODate).toLatin1();
+}
+
+QByteArray CardGenerator::clipXml(const Clip &clip, const QString &shotId) const
+{
+	QDateTime start = QDateTime::fromMSecsSinceEpoch(clip.shootStart, Qt::OffsetFromUTC, 3600);
+	QTime time = start.time();
+	QByteArray timecode = QString().sprintf("%02d:%02d:%02d:%02d", time.hour(), time.minute(),
+	                                        time.second(), time.msec() / 40).toLatin1();
+	qint64 end = clip.shootStart + qint64(clip.duration) * 40;
+
+	QByteArray x;
+	x.reserve(4096);
+	x += "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n"
+	     "<P2Main xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+	     "  <ClipContent>\n"
+	     "    <ClipName>" + clip.name.toLatin1() + "</ClipName>\n"
+	     "    <GlobalClipID>" + clip.id.toLatin1() + "</GlobalClipID>\n"
+	     "    <Duration>" + QByteArray::number(clip.duration) + "</Duration>\n"
+	     "    <EditUnit>1/25</EditUnit>\n";
+	if (clip.top >= 0)
+	{
+		x += "    <Relation>\n"
+		     "      <OffsetInShot>" + QByteArray::number(clip.offsetInShot) + "</OffsetInShot>\n"
+		     "      <GlobalShotID>" + shotId.toLatin1() + "</GlobalShotID>\n"
+		     "      <Connection>\n";
+		const char *names[] = { "Top", "Previous", "Next" };
+		int links[] = { clip.top, clip.previous, clip.next };
+		for (int i = 0; i < 3; ++i)
+		{
+			if (links[i] < 0)
+				continue;
+			const Clip &other = mClips[links[i]];
+			QByteArray id = other.id.toLatin1();
+			if (i == 2 && clip.brokenNext)
+				id = id.left(32) + QByteArray(32, 'F');
+			x += QByteArray("        <") + names[i] + ">\n"
+			     "          <ClipName>" + other.name.toLatin1() + "</ClipName>\n"
+			     "          <GlobalClipID>" + id + "</GlobalClipID>\n"
+			     "          <P2SerialNo.>" + mCardNames[other.card].toLatin1() + "</P2SerialNo.>\n"
+			     "        </" + names[i] + ">\n";
+		}
+		x += "      </Connection>\n"
+		     "    </Relation>\n";
+	}
+	x += "    <EssenceList>\n"
+	     "      <Video ValidAudioFlag=\"true\">\n"
+	     "        <VideoFormat>MXF</VideoFormat>\n"
+	     "        <Codec>DV50_422</Codec>\n"
+	     "        <FrameRate>50i</FrameRate>\n"
+	     "        <StartTimecode>" + timecode + "</StartTimecode>\n"
+	     "        <StartBinaryGroup>00000000</StartBinaryGroup>\n"
+	     "        <AspectRatio>16:9</AspectRatio>\n"
+	     "        <VideoIndex>\n"
+	     "          <StartByteOffset>32768</StartByteOffset>\n"
+	     "          <DataSize>" + QByteArray::number(qint64(clip.duration) * 288000) + "</DataSize>\n"
+	     "        </VideoIndex>\n"
+	     "      </Video>\n";
+	for (int i = 0; i < mOptions.audioChannels; ++i)
+		x += "      <Audio>\n"
+		     "        <AudioFormat>MXF</AudioFormat>\n"
+		     "        <SamplingRate>48000</SamplingRate>\n"
+		     "        <BitsPerSample>16</BitsPerSample>\n"
+		     "        <AudioIndex>\n"
+		     "          <StartByteOffset>32768</StartByteOffset>\n"
+		     "          <DataSize>" + QByteArray::number(qint64(clip.duration) * 3840) + "</DataSize>\n"
+		     "        </AudioIndex>\n"
+		     "      </Audio>\n";
+	x += "    </EssenceList>\n"
+	     "    <ClipMetadata>\n"
+	     "      <UserClipName>" + clip.id.toLatin1() + "</UserClipName>\n"
+	     "      <DataSource>SHOOTING</DataSource>\n"
+	     "      <Access>\n"
+	     "        <CreationDate>" + isoTime(clip.shootStart) + "</CreationDate>\n"
+	     "        <LastUpdateDate>" + isoTime(end) + "</LastUpdateDate>\n"
+	     "      </Access>\n"
+	     "      <Device>\n"
+	     "        <Manufacturer>Panasonic</Manufacturer>\n"
+	     "        <SerialNo.>" + QString().sprintf("F4TKA%04d", clip.shot % 3).toLatin1() + "</SerialNo.>\n"
+	     "        <ModelName>AJ-SPX800E</ModelName>\n"
+	     "      </Device>\n"
+	     "      <Shoot>\n"
+	     "        <StartDate>" + isoTime(clip.shootStart) + "</StartDate>\n"
+	     "        <EndDate>" + isoTime(end) + "</EndDate>\n"
+	     "      </Shoot>\n"
+	     "      <Thumbnail>\n"
+	     "        <FrameOffset>0</FrameOffset>\n"
+	     "        <ThumbnailFormat>BMP</ThumbnailFormat>\n"
+	     "        <Width>80</Width>\n"
+	     "        <Height>60</Height>\n"
+	     "      </Thumbnail>\n"
+	     "    </ClipMetadata>\n"
+	     "  </ClipContent>\n"
+	     "</P2Main>\n";
+	return x;
+}
+
+bool CardGenerator::generate(const QString &root)
+{
+	mState = 0x9E3779B97F4A7C15ULL ^ mOptions.seed;
+	mClips.clear();
+	mShotIds.clear();
+	mCardNames.clear();
+	mClipsWritten = 0;
+	const int cards = qMax(1, mOptions.cards);
+	for (int c = 0; c < cards; ++c)
+		mCardNames.append(QString().sprintf("SYN%05d", c + 1));
+
+	// lay out the shots first, the xml needs the ids of both neighbours
+	QVector<int> perCard(cards, 0);
+	QVector<int> spannedShots;
+	qint64 time = QDateTime(QDate(2016, 12, 28), QTime(9, 0), Qt::OffsetFromUTC, 3600).toMSecsSinceEpoch();
+	int card = 0;
+	while (mClips.size() < mOptions.clips)
+	{
+		int span = 1;
+		if (cards > 1 && mOptions.maxSpan > 1 && random() < mOptions.spanned * 4294967296.0)
+			span = 2 + int(random() % quint32(mOptions.maxSpan - 1));
+		span = qMin(span, mOptions.clips - mClips.size());
+		int first = mClips.size();
+		int offset = 0;
+		if (span > 1)
+			spannedShots.append(first);
+		mShotIds.append(span > 1 ? umid() : QString());
+		for (int k = 0; k < span; ++k)
+		{
+			Clip clip;
+			clip.card = (card + k) % cards;
+			// P2 names: 4 hex digits counting up and a 2 character card tag
+			clip.name = QString::number(perCard[clip.card]++, 16).rightJustified(4, '0').toUpper()
+			        + QString::number(clip.card % 1296, 36).rightJustified(2, '0').toUpper();
+			clip.id = umid();
+			clip.duration = 250 + int(random() % 4250);
+			clip.shootStart = time;
+			clip.offsetInShot = offset;
+			clip.shot = mShotIds.size() - 1;
+			clip.previous = k ? mClips.size() - 1 : -1;
+			clip.next = -1;
+			clip.top = span > 1 ? first : -1;
+			clip.skip = false;
+			clip.brokenNext = false;
+			if (k)
+				mClips[mClips.size() - 1].next = mClips.size();
+			time += qint64(clip.duration) * 40;
+			offset += clip.duration;
+			mClips.append(clip);
+		}
+		time += 30000 + random() % 600000;
+		card = (card + 1) % cards;
+	}
+
+	// damage a few spanned shots, picked evenly over the archive
+	int damaged = qMin(spannedShots.size(), mOptions.orphans + mOptions.broken);
+	for (int i = 0; i < damaged; ++i)
+	{
+		Clip &first = mClips[spannedShots[int(qint64(i) * spannedShots.size() / damaged)]];
+		if (i < mOptions.orphans)
+			first.skip = true;
+		else
+			first.brokenNext = true;
+	}
+
+	if (mOptions.icons && mIcons.isEmpty())
+	{
+		// a handful of different icons, encoding 100k of them would dominate
+		for (int v = 0; v < 16; ++v)
+		{
+			QImage icon(80, 60, QImage::Format_RGB888);
+			for (int y = 0; y < icon.height(); ++y)
+				for (int x = 0; x < icon.width(); ++x)
+					icon.setPixel(x, y, QColor::fromHsv((v * 22 + x) % 360, 128 + y, 96 + (x ^ y) % 128).rgb());
+			QByteArray data;
+			QBuffer buffer(&data);
+			buffer.open(QIODevice::WriteOnly);
+			icon.save(&buffer, "BMP");
+			mIcons.append(data);
+		}
+	}
+
+	for (int c = 0; c < cards; ++c)
+	{
+		QString contents = root + "/" + mCardNames[c] + "/CONTENTS/";
+		QStringList folders = QStringList() << "CLIP" << "ICON" << "VIDEO" << "AUDIO";
+		foreach(const QString &folder, folders)
+		{
+			if (!QDir().mkpath(contents + folder))
+			{
+				mError = QStringLiteral("%1: cannot create folder").arg(contents + folder);
+				return false;
+			}
+		}
+	}
+	foreach(const Clip &clip, mClips)
+	{
+		if (clip.skip)
+			continue;
+		QString contents = root + "/" + mCardNames[clip.card] + "/CONTENTS/";
+		if (!writeFile(contents + "CLIP/" + clip.name + ".XML", clipXml(clip, mShotIds[clip.shot])))
+			return false;
+		if (mOptions.icons && !writeFile(contents + "ICON/" + clip.name + ".BMP", mIcons[clip.shot % mIcons.size()]))
+			return false;
+		if (mOptions.essenceSize >= 0)
+		{
+			if (!writeFile(contents + "VIDEO/" + clip.name + ".MXF", QByteArray(), mOptions.essenceSize))
+				return false;
+			for (int i = 0; i < mOptions.audioChannels; ++i)
+				if (!writeFile(contents + "AUDIO/" + clip.name + QString().sprintf("%02x.MXF", i),
+				               QByteArray(), mOptions.essenceSize))
+					return false;
+		}
+		mClipsWritten++;
+	}
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef CARDGENERATOR_H
+#define CARDGENERATOR_H
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+/**
+ * Writes synthetic P2 card trees (CONTENTS/CLIP, ICON, VIDEO, AUDIO) for
+ * benchmarks and for trying the tools on archives of realistic size.
+ * Shots are dealt to the cards in turn; spanned shots continue on the
+ * following cards like they do when a camera switches slots. Orphans
+ * (shots whose first clip is left out) and broken Next links can be mixed
+ * in. The output only depends on the options, including the seed.
+ */
+class CardGenerator
+{
+public:
+	struct Options
+	{
+		Options();
+		int cards;
+		int clips;              ///< total over all cards
+		double spanned;         ///< share of shots that span several cards
+		int maxSpan;            ///< most clips in a spanned shot
+		int orphans;            ///< spanned shots without their first clip
+		int broken;             ///< spanned shots whose first Next points nowhere
+		int audioChannels;
+		bool icons;
+		qint64 essenceSize;     ///< size of the (sparse) VIDEO/AUDIO files
+		quint32 seed;
+	};
+
+	explicit CardGenerator(const Options &options = Options());
+
+	/** writes the cards into root, which is created if needed */
+	bool generate(const QString &root);
+	QString errorString() const;
+
+	int clipsWritten() const;
+	int shotsWritten() const;
+
+private:
+	struct Clip
+	{
+		QString name;
+		QString id;
+		int card;
+		int duration;
+		qint64 shootStart;      ///< msecs since epoch
+		int offsetInShot;
+		int shot;
+		int previous;           ///< index into mClips, -1 for none
+		int next;
+		int top;
+		bool skip;              ///< orphaned: not written
+		bool brokenNext;
+	};
+
+	quint32 random();
+	QString umid();
+	QByteArray clipXml(const Clip &clip, const QString &shotId) const;
+	bool writeFile(const QString &fileName, const QByteArray &data, qint64 size = -1);
+
+	Options mOptions;
+	quint64 mState;
+	QVector<Clip> mClips;
+	QVector<QString> mShotIds;
+	QVector<QByteArray> mIcons;
+	QVector<QString> mCardNames;
+	QString mError;
+	int mClipsWritten;
+};
+
+#endif // CARDGENERATOR_H
@@ -0,0 +1,189 @@
+#include "dvpattern.h"
+#include "dvthumbnail.h"
+#include <QTextStream>
+#include <QImage>
+#include <QVector>
+
+/// DC picture width, 720 / 8
+static const int dcWidth = 90;
+
+static int patternY(int x, int)
+{
+	return 16 + 2 * x;
+}
+
+static int patternCb(int, int y)
+{
+	return 64 + 4 * (y / 2);
+}
+
+static int patternCr(int x, int)
+{
+	return 96 + 2 * (x / 4);
+}
+
+/** writes the DC of an 8x8 block, the mean of its samples */
+static void putDc(char *dif, int block, int value)
+{
+	static const int start[6] = { 4, 18, 32, 46, 60, 70 };
+	// 9 bit signed, twice the mean less 128, the lowest bit left 0
+	dif[start[block]] = char(value - 128);
+	dif[start[block] + 1] = 0;
+}
+
+QByteArray dvPatternFrame(qint64 frameSize, bool iec)
+{
+	static const int off[] = { 2, 6, 8, 0, 4 };
+	static const int shuf3[] = { 18, 9, 27, 0, 36 };
+	static const int lStartShuffled[] = { 9, 4, 13, 0, 18 };
+	static const int serpent1[] = {
+	    0, 1, 2, 2, 1, 0, 0, 1, 2, 2, 1, 0, 0, 1, 2, 2, 1, 0,
+	    0, 1, 2, 2, 1, 0, 0, 1, 2
+	};
+	static const int serpent2[] = {
+	    0, 1, 2, 3, 4, 5, 5, 4, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5,
+	    5, 4, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5
+	};
+
+	bool is625 = (frameSize == 144000) || (frameSize == 288000);
+	bool dv50 = (frameSize == 240000) || (frameSize == 288000);
+	if (!is625 && !dv50 && (frameSize != 120000))
+		return QByteArray();
+	iec = iec && (frameSize == 144000);
+	const int channels = dv50 ? 2 : 1;
+	const int sequences = is625 ? 12 : 10;
+
+	QByteArray frame(int(frameSize), 0);
+	for (int c = 0; c < channels; ++c)
+	{
+		for (int s = 0; s < sequences; ++s)
+		{
+			char *sequence = frame.data() + (c * sequences + s) * 150 * 80;
+			// header: section type 0, DSF for 625/50, APT 0 for IEC, 1 for DVCPRO
+			sequence[0] = 0x1f;
+			sequence[3] = char(is625 ? 0x80 : 0);
+			sequence[4] = char(iec ? 0 : 1);
+			for (int slot = 0; slot < 27; ++slot)
+			{
+				for (int m = 0; m < 5; ++m)
+				{
+					// after the 6 header blocks an audio block leads every 3 segments
+					char *dif = sequence + (6 + slot / 3 + 1 + slot * 5 + m) * 80;
+					dif[0] = char(0x8f);
+					int row = (s + off[m]) % sequences;
+					if (dv50)
+					{
+						// 16x8 macro blocks, the luma of the left and right half
+						int x = (shuf3[m] + slot / 3) * 2;
+						int y = serpent1[slot] + ((row << 1) + c) * 3;
+						putDc(dif, 0, patternY(x, y));
+						putDc(dif, 1, patternY(x, y));
+						putDc(dif, 2, patternY(x + 1, y));
+						putDc(dif, 3, patternY(x + 1, y));
+						putDc(dif, 4, patternCr(x, y));
+						putDc(dif, 5, patternCb(x, y));
+						continue;
+					}
+					int x, y;
+					bool square = iec;
+					if (iec)
+					{
+						x = (shuf3[m] + slot / 3) * 2;
+						y = (serpent1[slot] + row * 3) * 2;
+					}
+					else
+					{
+						int k = slot + ((m == 1 || m == 2) ? 3 : 0);
+						int column = lStartShuffled[m] + k / 6;
+						y = serpent2[k] + row * 6;
+						if (column > 21)
+						{
+							y = y * 2 - row * 6;
+							square = true;
+						}
+						x = column * 4;
+					}
+					if (square)
+					{
+						putDc(dif, 0, patternY(x, y));
+						putDc(dif, 1, patternY(x + 1, y));
+						putDc(dif, 2, patternY(x, y + 1));
+						putDc(dif, 3, patternY(x + 1, y + 1));
+					}
+					else
+					{
+						for (int b = 0; b < 4; ++b)
+							putDc(dif, b, patternY(x + b, y));
+					}
+					putDc(dif, 4, patternCr(x, y));
+					putDc(dif, 5, patternCb(x, y));
+				}
+			}
+		}
+	}
+	return frame;
+}
+
+/** BT.601 studio range to RGB, in floating point */
+static QRgb expectedPixel(int x, int y)
+{
+	double luma = 1.164 * (patternY(x, y) - 16);
+	double cb = patternCb(x, y) - 128;
+	double cr = patternCr(x, y) - 128;
+	return qRgb(qBound(0, qRound(luma + 1.596 * cr), 255),
+	            qBound(0, qRound(luma - 0.391 * cb - 0.813 * cr), 255),
+	            qBound(0, qRound(luma + 2.018 * cb), 255));
+}
+
+bool checkDvDecoder(QTextStream &out)
+{
+	struct Case
+	{
+		qint64 size;
+		bool iec;
+		const char *name;
+	};
+	static const Case cases[] = {
+	    { 120000, false, "DV25 525/60 4:1:1" },
+	    { 144000, false, "DVCPRO 625/50 4:1:1" },
+	    { 144000, true, "DV 625/50 4:2:0" },
+	    { 240000, false, "DVCPRO50 525/60 4:2:2" },
+	    { 288000, false, "DVCPRO50 625/50 4:2:2" }
+	};
+	bool ok = true;
+	for (const Case &c : cases)
+	{
+		QByteArray frame = dvPatternFrame(c.size, c.iec);
+		const uchar *data = reinterpret_cast<const uchar *>(frame.constData());
+		QSize size = MXF::dvDcSize(data, frame.size());
+		int wrong = 0;
+		if ((size.width() != dcWidth) || !size.height())
+			wrong = -1;
+		else
+		{
+			QImage picture(size, QImage::Format_RGB32);
+			MXF::decodeDvDc(data, frame.size(), picture.bits(), picture.bytesPerLine());
+			for (int y = 0; y < size.height(); ++y)
+			{
+				for (int x = 0; x < size.width(); ++x)
+				{
+					QRgb got = picture.pixel(x, y);
+					QRgb want = expectedPixel(x, y);
+					if ((qAbs(qRed(got) - qRed(want)) > 2) || (qAbs(qGreen(got) - qGreen(want)) > 2)
+					        || (qAbs(qBlue(got) - qBlue(want)) > 2))
+						wrong++;
+				}
+			}
+		}
+		out << c.name << ": ";
+		if (wrong < 0)
+			out << "not recognised\n";
+		else if (wrong)
+			out << wrong << " of " << size.width() * size.height() << " pixels wrong\n";
+		else
+			out << "ok\n";
+		ok = ok && !wrong;
+	}
+	out << "colour kernel: " << MXF::dvColorKernel() << "\n";
+	return ok;
+}
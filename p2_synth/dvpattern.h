@@ -0,0 +1,24 @@
+#ifndef DVPATTERN_H
+#define DVPATTERN_H
+#include <QByteArray>
+
+class QTextStream;
+
+/**
+ * DV frames whose DC picture is known: luma ramps up from left to right,
+ * Cb from top to bottom and Cr in steps of 4 pixels. Only the DIF headers
+ * and the DC coefficients are written, which is all MXF::decodeDvDc()
+ * reads. The macro block positions follow IEC 61834-2 / SMPTE 314M as
+ * spelled out in ffmpeg's dv_calc_mb_coordinates(), independent of the
+ * decoder's tables.
+ */
+
+/** a frame of 120000, 144000, 240000 or 288000 bytes; iec picks IEC 61834
+ * 4:2:0 over DVCPRO 4:1:1 for 144000. Empty for other sizes */
+QByteArray dvPatternFrame(qint64 frameSize, bool iec);
+
+/** decodes a pattern frame of every layout, writes a line per layout to
+ * out and returns false if any of them came out wrong */
+bool checkDvDecoder(QTextStream &out);
+
+#endif // DVPATTERN_H
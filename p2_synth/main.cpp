@@ -0,0 +1,143 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+#include "cardgenerator.h"
+#include "benchmark.h"
+#include "dvpattern.h"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("p2_synth");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Synthetic P2 cards and benchmarks of the metadata pipeline\n\n"
+	                                 "  generate <folder>  write a tree of synthetic cards\n"
+	                                 "  bench [path]       time discovery, parsing, grouping and thumbnails on path,\n"
+	                                 "                     or on generated trees of each --sizes clip count\n"
+	                                 "  check-dv           decode DV frames of known content in every layout");
+	parser.addHelpOption();
+	parser.addPositionalArgument("command", "generate, bench or check-dv");
+	parser.addPositionalArgument("path", "output folder for generate, cards for bench", "[path]");
+
+	QCommandLineOption cardsOption("cards", "generate: number of cards (default: 4)", "n", "4");
+	parser.addOption(cardsOption);
+	QCommandLineOption clipsOption("clips", "generate: number of clips over all cards (default: 1000)", "n", "1000");
+	parser.addOption(clipsOption);
+	QCommandLineOption spannedOption("spanned", "share of shots spanning cards (default: 0.2)", "ratio", "0.2");
+	parser.addOption(spannedOption);
+	QCommandLineOption maxSpanOption("max-span", "most clips in a spanned shot (default: 3)", "n", "3");
+	parser.addOption(maxSpanOption);
+	QCommandLineOption orphansOption("orphans", "spanned shots whose first clip is left out (default: 0)", "n", "0");
+	parser.addOption(orphansOption);
+	QCommandLineOption brokenOption("broken", "spanned shots with a Next link to a missing clip (default: 0)", "n", "0");
+	parser.addOption(brokenOption);
+	QCommandLineOption audioOption("audio-channels", "audio files per clip (default: 4)", "n", "4");
+	parser.addOption(audioOption);
+	QCommandLineOption noIconsOption("no-icons", "do not write ICON files");
+	parser.addOption(noIconsOption);
+	QCommandLineOption essenceSizeOption("essence-size", "size of each sparse VIDEO/AUDIO file (default: 0)", "bytes", "0");
+	parser.addOption(essenceSizeOption);
+	QCommandLineOption noEssenceOption("no-essence", "do not write VIDEO and AUDIO files");
+	parser.addOption(noEssenceOption);
+	QCommandLineOption seedOption("seed", "random seed (default: 1)", "n", "1");
+	parser.addOption(seedOption);
+
+	QCommandLineOption sizesOption("sizes", "bench: clip counts of the generated trees (default: 1000,10000,100000)",
+	                               "list", "1000,10000,100000");
+	parser.addOption(sizesOption);
+	QCommandLineOption workOption("work-dir", "bench: where the trees are generated (default: a temporary folder)", "folder");
+	parser.addOption(workOption);
+	QCommandLineOption cuesheetOption("cuesheet", "bench: p2_cuesheet binary, adds a cold and a warm cuesheet run", "program");
+	parser.addOption(cuesheetOption);
+	QCommandLineOption thumbnailsOption("thumbnails", "bench: icons encoded in the thumbnail phase (default: 500)", "n", "500");
+	parser.addOption(thumbnailsOption);
+	parser.process(app);
+
+	QStringList args = parser.positionalArguments();
+	if (args.isEmpty())
+		parser.showHelp(2);
+	QString command = args.takeFirst();
+
+	if (command == "check-dv")
+	{
+		QFile stdOut;
+		stdOut.open(stdout, QIODevice::WriteOnly);
+		QTextStream out(&stdOut);
+		return checkDvDecoder(out) ? 0 : 1;
+	}
+
+	CardGenerator::Options options;
+	options.cards = parser.value(cardsOption).toInt();
+	options.clips = parser.value(clipsOption).toInt();
+	options.spanned = parser.value(spannedOption).toDouble();
+	options.maxSpan = parser.value(maxSpanOption).toInt();
+	options.orphans = parser.value(orphansOption).toInt();
+	options.broken = parser.value(brokenOption).toInt();
+	options.audioChannels = parser.value(audioOption).toInt();
+	options.icons = !parser.isSet(noIconsOption);
+	options.essenceSize = parser.isSet(noEssenceOption) ? -1 : parser.value(essenceSizeOption).toLongLong();
+	options.seed = parser.value(seedOption).toUInt();
+
+	if (command == "generate")
+	{
+		if (args.isEmpty())
+			parser.showHelp(2);
+		CardGenerator generator(options);
+		if (!generator.generate(args.first()))
+		{
+			qCritical().noquote() << generator.errorString();
+			return 1;
+		}
+		qInfo() << generator.clipsWritten() << "clips in" << generator.shotsWritten() << "shots written to"
+		        << QDir(args.first()).absolutePath();
+		return 0;
+	}
+	if (command != "bench")
+		parser.showHelp(2);
+
+	Benchmark bench;
+	bench.setCuesheet(parser.value(cuesheetOption));
+	bench.setThumbnailSamples(parser.value(thumbnailsOption).toInt());
+	if (args.size())
+	{
+		if (!bench.run(args.first(), QDir(args.first()).dirName()))
+		{
+			qCritical().noquote() << bench.errorString();
+			return 1;
+		}
+	}
+	else
+	{
+		QTemporaryDir temp;
+		QString work = parser.isSet(workOption) ? parser.value(workOption) : temp.path();
+		foreach(const QString &size, parser.value(sizesOption).split(',', QString::SkipEmptyParts))
+		{
+			// about as many clips per card as a 64 GB card holds
+			options.clips = size.toInt();
+			options.cards = qMax(4, options.clips / 250);
+			QString tree = work + "/" + size;
+			CardGenerator generator(options);
+			if (!QDir(tree).exists() && !generator.generate(tree))
+			{
+				qCritical().noquote() << generator.errorString();
+				return 1;
+			}
+			if (!bench.run(tree, size + " clips"))
+			{
+				qCritical().noquote() << bench.errorString();
+				return 1;
+			}
+		}
+	}
+	QFile stdOut;
+	stdOut.open(stdout, QIODevice::WriteOnly);
+	QTextStream out(&stdOut);
+	bench.printReport(out);
+	return 0;
+}
@@ -0,0 +1,23 @@
+QT += core gui xml
+
+CONFIG += c++11
+
+TARGET = p2_synth
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    cardgenerator.cpp \
+    benchmark.cpp \
+    dvpattern.cpp
+
+HEADERS += \
+    cardgenerator.h \
+    benchmark.h \
+    dvpattern.h
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../common/common.pri)